@@ -0,0 +1,175 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define CHUNK_MIN	4096
+#define CHUNK_MAX	(1024 * 1024)
+#define ALIGNMENT	16
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	size_t used;
+	/* data follows, aligned to ALIGNMENT */
+};
+
+#define CHUNK_HEADER	((sizeof(struct arena_chunk) + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1))
+
+struct arena *
+arena_new(void)
+{
+	struct arena *arena;
+	arena = calloc(1, sizeof(struct arena));
+	if (arena == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	arena->next_size = CHUNK_MIN;
+
+	return arena;
+}
+
+void
+arena_free(struct arena *arena)
+{
+	if (arena == NULL) {
+		return;
+	}
+	struct arena_chunk *chunk = arena->chunks;
+	while (chunk != NULL) {
+		struct arena_chunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	free(arena);
+}
+
+/*
+ * Chunks double in size up to CHUNK_MAX, so a small report takes a few
+ * pages and a large one a few chunks. A request that does not fit gets
+ * a chunk of its own, which goes after the current one to keep using
+ * the rest of it.
+ */
+static struct arena_chunk *
+add_chunk(struct arena *arena, size_t size)
+{
+	size_t chunk_size = arena->next_size;
+	if (size > chunk_size - CHUNK_HEADER) {
+		chunk_size = CHUNK_HEADER + size;
+	} else if (arena->next_size < CHUNK_MAX) {
+		arena->next_size *= 2;
+	}
+
+	/* calloc(3) hands out zeroed pages, no memset() per allocation */
+	struct arena_chunk *chunk = calloc(1, chunk_size);
+	if (chunk == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	chunk->size = chunk_size;
+	chunk->used = CHUNK_HEADER;
+	if (arena->chunks != NULL && chunk_size > arena->next_size) {
+		chunk->next = arena->chunks->next;
+		arena->chunks->next = chunk;
+	} else {
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	return chunk;
+}
+
+static void *
+bump(struct arena *arena, size_t size, size_t align)
+{
+	struct arena_chunk *chunk = arena->chunks;
+	size_t used = 0;
+	if (chunk != NULL) {
+		used = (chunk->used + align - 1) & ~(align - 1);
+	}
+	if (chunk == NULL || used > chunk->size || chunk->size - used < size) {
+		chunk = add_chunk(arena, size);
+		if (chunk == NULL) {
+			return NULL;
+		}
+		used = chunk->used;
+	}
+	chunk->used = used + size;
+
+	return (char *)chunk + used;
+}
+
+/* returned memory is zeroed */
+void *
+arena_alloc(struct arena *arena, size_t size)
+{
+	if (arena == NULL) {
+		return calloc(1, size);
+	}
+
+	return bump(arena, size, ALIGNMENT);
+}
+
+/* strings are not aligned to save memory on short names */
+char *
+arena_strndup(struct arena *arena, const char *s, size_t len)
+{
+	if (s == NULL) {
+		return NULL;
+	}
+	char *p;
+	if (arena == NULL) {
+		p = malloc(len + 1);
+	} else {
+		p = bump(arena, len + 1, 1);
+	}
+	if (p == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	memcpy(p, s, len);
+	p[len] = '\0';
+
+	return p;
+}
+
+char *
+arena_strdup(struct arena *arena, const char *s)
+{
+	if (s == NULL) {
+		return NULL;
+	}
+
+	return arena_strndup(arena, s, strlen(s));
+}
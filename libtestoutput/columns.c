@@ -0,0 +1,228 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "columns.h"
+#include "intern.h"
+
+static int
+reserve(struct test_columns *cols, size_t cap)
+{
+	if (cap <= cols->cap) {
+		return 0;
+	}
+
+	uint8_t *status = realloc(cols->status, cap * sizeof(*status));
+	if (status == NULL) {
+		goto fail;
+	}
+	cols->status = status;
+	double *duration = realloc(cols->duration, cap * sizeof(*duration));
+	if (duration == NULL) {
+		goto fail;
+	}
+	cols->duration = duration;
+	uint32_t *name_id = realloc(cols->name_id, cap * sizeof(*name_id));
+	if (name_id == NULL) {
+		goto fail;
+	}
+	cols->name_id = name_id;
+	uint32_t *suite_id = realloc(cols->suite_id, cap * sizeof(*suite_id));
+	if (suite_id == NULL) {
+		goto fail;
+	}
+	cols->suite_id = suite_id;
+	uint32_t *report = realloc(cols->report, cap * sizeof(*report));
+	if (report == NULL) {
+		goto fail;
+	}
+	cols->report = report;
+	cols->cap = cap;
+
+	return 0;
+
+fail:
+	perror("malloc failed");
+	return -1;
+}
+
+struct test_columns *
+columns_new(size_t hint)
+{
+	struct test_columns *cols;
+	cols = calloc(1, sizeof(struct test_columns));
+	if (cols == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	if (hint != 0 && reserve(cols, hint) != 0) {
+		columns_free(cols);
+		return NULL;
+	}
+
+	return cols;
+}
+
+void
+columns_free(struct test_columns *cols)
+{
+	if (cols == NULL) {
+		return;
+	}
+	free(cols->status);
+	free(cols->duration);
+	free(cols->name_id);
+	free(cols->suite_id);
+	free(cols->report);
+	free(cols);
+}
+
+static size_t
+count_tests(struct suiteq *suites)
+{
+	size_t n = 0;
+	tailq_suite *suite_item = NULL;
+	TAILQ_FOREACH(suite_item, suites, entries) {
+		tailq_test *test_item = NULL;
+		TAILQ_FOREACH(test_item, suite_item->tests, entries) {
+			n++;
+		}
+	}
+
+	return n;
+}
+
+/* append tests of a report with suites loaded */
+int
+columns_add_report(struct test_columns *cols, tailq_report *report,
+		   uint32_t index)
+{
+	if (report->suites == NULL) {
+		return 0;
+	}
+
+	size_t n = count_tests(report->suites);
+	if (cols->n + n > cols->cap) {
+		size_t cap = cols->cap ? cols->cap : 64;
+		while (cap < cols->n + n) {
+			cap *= 2;
+		}
+		if (reserve(cols, cap) != 0) {
+			return -1;
+		}
+	}
+
+	size_t i = cols->n;
+	tailq_suite *suite_item = NULL;
+	TAILQ_FOREACH(suite_item, report->suites, entries) {
+		uint32_t suite_id = intern_id(suite_item->name);
+		tailq_test *test_item = NULL;
+		TAILQ_FOREACH(test_item, suite_item->tests, entries) {
+			cols->status[i] = test_item->status;
+			cols->duration[i] = test_item->duration;
+			cols->name_id[i] = intern_id(test_item->name);
+			cols->suite_id[i] = suite_id;
+			cols->report[i] = index;
+			i++;
+		}
+	}
+	cols->n = i;
+
+	return 0;
+}
+
+/*
+ * Columns of a history are copied from cached columns of its reports,
+ * rows of reports without suites loaded are skipped.
+ */
+struct test_columns *
+columns_from_reports(struct reportq *reports)
+{
+	size_t n = 0;
+	tailq_report *report_item = NULL;
+	TAILQ_FOREACH(report_item, reports, entries) {
+		struct test_columns *part = report_columns(report_item);
+		if (part != NULL) {
+			n += part->n;
+		}
+	}
+
+	struct test_columns *cols = columns_new(n);
+	if (cols == NULL) {
+		return NULL;
+	}
+	uint32_t index = 0;
+	TAILQ_FOREACH(report_item, reports, entries) {
+		struct test_columns *part = report_item->columns;
+		size_t i;
+		for (i = 0; part != NULL && i < part->n; i++) {
+			cols->report[cols->n + i] = index;
+		}
+		if (part != NULL) {
+			memcpy(cols->status + cols->n, part->status,
+			       part->n * sizeof(*cols->status));
+			memcpy(cols->duration + cols->n, part->duration,
+			       part->n * sizeof(*cols->duration));
+			memcpy(cols->name_id + cols->n, part->name_id,
+			       part->n * sizeof(*cols->name_id));
+			memcpy(cols->suite_id + cols->n, part->suite_id,
+			       part->n * sizeof(*cols->suite_id));
+			cols->n += part->n;
+		}
+		index++;
+	}
+
+	return cols;
+}
+
+/*
+ * Columns of a report are built once from its suites and kept until the
+ * suites are freed, see free_report_suites().
+ */
+struct test_columns *
+report_columns(tailq_report *report)
+{
+	if (report->columns != NULL || report->suites == NULL) {
+		return report->columns;
+	}
+
+	struct test_columns *cols = columns_new(0);
+	if (cols == NULL) {
+		return NULL;
+	}
+	if (columns_add_report(cols, report, 0) != 0) {
+		columns_free(cols);
+		return NULL;
+	}
+	report->columns = cols;
+
+	return cols;
+}
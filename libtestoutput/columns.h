@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "parse_common.h"
+
+/*
+ * Columnar view of test results: one row per test, every field in its own
+ * contiguous array. Metrics scan these arrays instead of walking suites
+ * and tests. Names are ids of interned strings, see intern.h.
+ * Columns of a single report are built on demand by report_columns(),
+ * columns of a history of reports by columns_from_reports(). Ids change
+ * with intern_compact(), so columns are dropped before it.
+ */
+
+struct test_columns {
+	size_t n;		/* number of rows */
+	size_t cap;		/* allocated rows */
+	uint8_t *status;	/* enum test_status */
+	double *duration;	/* seconds, 0 when unknown */
+	uint32_t *name_id;	/* intern id of a test name */
+	uint32_t *suite_id;	/* intern id of a suite name */
+	uint32_t *report;	/* index of a report in a history */
+};
+
+struct test_columns *columns_new(size_t hint);
+void columns_free(struct test_columns *cols);
+int columns_add_report(struct test_columns *cols, tailq_report *report,
+		       uint32_t index);
+struct test_columns *columns_from_reports(struct reportq *reports);
+struct test_columns *report_columns(tailq_report *report);
+
+#endif				/* COLUMNS_H */
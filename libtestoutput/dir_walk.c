@@ -0,0 +1,147 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "dir_walk.h"
+
+/*
+ * Files are reported in the order of readdir(3) and subdirectories are
+ * visited as soon as they are found, so nothing but a single path buffer
+ * and an open directory per level is kept during a walk. Hidden entries
+ * are skipped, symbolic links to directories are not followed.
+ */
+
+struct walk {
+	struct walk_opts *opts;
+	walk_cb cb;
+	void *arg;
+	char path[PATH_MAX];
+};
+
+static int
+walk_level(struct walk *w, int fd, size_t len, int depth)
+{
+	DIR *d = fdopendir(fd);
+	if (d == NULL) {
+		perror("fdopendir");
+		close(fd);
+		return 0;
+	}
+
+	int rc = 0;
+	if (w->opts->dir_cb != NULL) {
+		rc = w->opts->dir_cb(w->path, w->arg);
+	}
+	struct dirent *dir;
+	while (rc == 0 && (dir = readdir(d)) != NULL) {
+		const char *name = dir->d_name;
+		if (name[0] == '.') {
+			continue;
+		}
+		size_t name_len = strlen(name);
+		if (len + name_len + 2 > sizeof(w->path)) {
+			fprintf(stderr, "path is too long %s/%s\n", w->path, name);
+			continue;
+		}
+
+		int is_dir = dir->d_type == DT_DIR;
+		int is_reg = dir->d_type == DT_REG;
+		if (dir->d_type == DT_UNKNOWN || dir->d_type == DT_LNK) {
+			struct stat sb;
+			int flags = dir->d_type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW;
+			if (fstatat(dirfd(d), name, &sb, flags) == -1) {
+				continue;
+			}
+			is_dir = dir->d_type != DT_LNK && S_ISDIR(sb.st_mode);
+			is_reg = S_ISREG(sb.st_mode);
+		}
+
+		w->path[len] = '/';
+		memcpy(w->path + len + 1, name, name_len + 1);
+		if (is_dir) {
+			if (w->opts->max_depth >= 0 && depth >= w->opts->max_depth) {
+				continue;
+			}
+			int sub = openat(dirfd(d), name, O_RDONLY | O_DIRECTORY);
+			if (sub == -1) {
+				perror(w->path);
+				continue;
+			}
+			rc = walk_level(w, sub, len + 1 + name_len, depth + 1);
+		} else if (is_reg) {
+			if (w->opts->pattern != NULL &&
+			    fnmatch(w->opts->pattern, name, 0) != 0) {
+				continue;
+			}
+			rc = w->cb(w->path, w->arg);
+		}
+	}
+	w->path[len] = '\0';
+	closedir(d);
+
+	return rc;
+}
+
+int
+walk_dir(const char *path, struct walk_opts *opts, walk_cb cb, void *arg)
+{
+	struct walk w;
+	struct walk_opts defaults = { 0, NULL, NULL };
+
+	size_t len = strlen(path);
+	while (len > 1 && path[len - 1] == '/') {
+		len--;
+	}
+	if (len >= sizeof(w.path)) {
+		fprintf(stderr, "path is too long %s\n", path);
+		return -1;
+	}
+	memcpy(w.path, path, len);
+	w.path[len] = '\0';
+	w.opts = opts ? opts : &defaults;
+	w.cb = cb;
+	w.arg = arg;
+
+	int fd = open(w.path, O_RDONLY | O_DIRECTORY);
+	if (fd == -1) {
+		printf("failed to open dir %s\n", path);
+		return -1;
+	}
+
+	return walk_level(&w, fd, len, 0);
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashmap.h"
+
+#define HASHMAP_MIN_SIZE	16
+
+/* a removed entry keeps its key, so probing goes on past it */
+#define IS_FREE(e)		((e)->key == NULL)
+#define IS_TOMBSTONE(e)		((e)->key != NULL && (e)->value == NULL)
+
+/* 32-bit FNV-1a */
+uint32_t
+hashmap_hash(const void *key, size_t len)
+{
+	const unsigned char *p = key;
+	uint32_t h = 2166136261u;
+	size_t i;
+	for (i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+struct hashmap *
+hashmap_new(size_t hint)
+{
+	struct hashmap *map;
+	map = calloc(1, sizeof(struct hashmap));
+	if (map == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	map->size = HASHMAP_MIN_SIZE;
+	while (map->size < hint * 2) {
+		map->size *= 2;
+	}
+	map->entries = calloc(map->size, sizeof(struct hashmap_entry));
+	if (map->entries == NULL) {
+		perror("malloc failed");
+		free(map);
+		return NULL;
+	}
+
+	return map;
+}
+
+void
+hashmap_free(struct hashmap *map)
+{
+	if (map == NULL) {
+		return;
+	}
+	free(map->entries);
+	free(map);
+}
+
+static struct hashmap_entry *
+lookup(struct hashmap *map, const void *key, size_t len, uint32_t hash)
+{
+	size_t mask = map->size - 1;
+	size_t i = hash & mask;
+	struct hashmap_entry *e;
+	for (;;) {
+		e = &map->entries[i];
+		if (IS_FREE(e)) {
+			return NULL;
+		}
+		if (e->value != NULL && e->hash == hash && e->len == len &&
+		    memcmp(e->key, key, len) == 0) {
+			return e;
+		}
+		i = (i + 1) & mask;
+	}
+}
+
+static int
+grow(struct hashmap *map)
+{
+	struct hashmap_entry *old = map->entries;
+	size_t old_size = map->size;
+	size_t size = map->count * 2 >= map->size / 2 ? map->size * 2 : map->size;
+
+	map->entries = calloc(size, sizeof(struct hashmap_entry));
+	if (map->entries == NULL) {
+		perror("malloc failed");
+		map->entries = old;
+		return -1;
+	}
+	map->size = size;
+	map->used = map->count;
+
+	size_t i;
+	for (i = 0; i < old_size; i++) {
+		struct hashmap_entry *e = &old[i];
+		if (IS_FREE(e) || IS_TOMBSTONE(e)) {
+			continue;
+		}
+		size_t j = e->hash & (size - 1);
+		while (!IS_FREE(&map->entries[j])) {
+			j = (j + 1) & (size - 1);
+		}
+		map->entries[j] = *e;
+	}
+	free(old);
+
+	return 0;
+}
+
+void *
+hashmap_get(struct hashmap *map, const void *key, size_t len)
+{
+	struct hashmap_entry *e;
+	e = lookup(map, key, len, hashmap_hash(key, len));
+
+	return e ? e->value : NULL;
+}
+
+int
+hashmap_put(struct hashmap *map, const void *key, size_t len, void *value)
+{
+	uint32_t hash = hashmap_hash(key, len);
+	struct hashmap_entry *e;
+	if ((e = lookup(map, key, len, hash)) != NULL) {
+		e->key = key;
+		e->value = value;
+		return 0;
+	}
+	if ((map->used + 1) * 4 > map->size * 3 && grow(map) != 0) {
+		return -1;
+	}
+
+	size_t mask = map->size - 1;
+	size_t i = hash & mask;
+	while (!IS_FREE(&map->entries[i]) && !IS_TOMBSTONE(&map->entries[i])) {
+		i = (i + 1) & mask;
+	}
+	e = &map->entries[i];
+	if (IS_FREE(e)) {
+		map->used++;
+	}
+	e->key = key;
+	e->len = len;
+	e->hash = hash;
+	e->value = value;
+	map->count++;
+
+	return 0;
+}
+
+void *
+hashmap_remove(struct hashmap *map, const void *key, size_t len)
+{
+	struct hashmap_entry *e;
+	e = lookup(map, key, len, hashmap_hash(key, len));
+	if (e == NULL) {
+		return NULL;
+	}
+	void *value = e->value;
+	e->value = NULL;
+	map->count--;
+
+	return value;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Open addressing hash table with linear probing. Keys are arbitrary byte
+ * strings and are not copied, so a key must live as long as its entry,
+ * usually it points into the value itself.
+ * A value must not be NULL.
+ */
+
+struct hashmap_entry {
+	const void *key;
+	size_t len;
+	uint32_t hash;
+	void *value;
+};
+
+struct hashmap {
+	struct hashmap_entry *entries;
+	size_t size;		/* number of slots, power of two */
+	size_t count;		/* number of live entries */
+	size_t used;		/* live entries and tombstones */
+};
+
+uint32_t hashmap_hash(const void *key, size_t len);
+struct hashmap *hashmap_new(size_t hint);
+void hashmap_free(struct hashmap *map);
+void *hashmap_get(struct hashmap *map, const void *key, size_t len);
+int hashmap_put(struct hashmap *map, const void *key, size_t len, void *value);
+void *hashmap_remove(struct hashmap *map, const void *key, size_t len);
+
+#define hashmap_foreach(map, e) \
+	for ((e) = (map)->entries; (e) < (map)->entries + (map)->size; (e)++) \
+		if ((e)->key != NULL && (e)->value != NULL)
+
+#endif				/* HASHMAP_H */
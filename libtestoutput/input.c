@@ -0,0 +1,411 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE		/* fopencookie() */
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <sys/mman.h>
+
+#include "input.h"
+
+#define READ_CHUNK	65536
+#define INFLATE_CHUNK	65536	/* compressed bytes passed to a decoder at once */
+
+/* set once before reports are read, see input_set_mmap() */
+static int use_mmap = 1;
+
+void
+input_set_mmap(int enable)
+{
+	use_mmap = enable;
+}
+
+static int
+read_all(struct input *in, int fd)
+{
+	char *buf = NULL;
+	size_t size = 0, len = 0;
+
+	for (;;) {
+		if (len == size) {
+			size = size ? size * 2 : READ_CHUNK;
+			char *p = realloc(buf, size);
+			if (p == NULL) {
+				perror("malloc failed");
+				free(buf);
+				return -1;
+			}
+			buf = p;
+		}
+		ssize_t n = read(fd, buf + len, size - len);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n == -1) {
+			perror("read");
+			free(buf);
+			return -1;
+		}
+		if (n == 0) {
+			break;
+		}
+		len += n;
+	}
+	in->base = buf;
+	in->len = len;
+	in->mapped = 0;
+	in->compression = input_compression(buf, len);
+
+	return 0;
+}
+
+int
+input_open_fd(struct input *in, int fd, struct stat *sb)
+{
+	memset(in, 0, sizeof(struct input));
+	if (fstat(fd, sb) == -1) {
+		perror("fstat");
+		return -1;
+	}
+	if (!S_ISREG(sb->st_mode) || !use_mmap) {
+		return read_all(in, fd);
+	}
+	if (sb->st_size == 0) {
+		in->base = "";
+		in->len = 0;
+		in->mapped = 1;
+		return 0;
+	}
+
+	void *p = mmap(NULL, sb->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		/* a filesystem without mmap support */
+		return read_all(in, fd);
+	}
+	madvise(p, sb->st_size, MADV_SEQUENTIAL);
+	in->base = p;
+	in->len = sb->st_size;
+	in->mapped = 1;
+	in->compression = input_compression(p, sb->st_size);
+
+	return 0;
+}
+
+int
+input_open(struct input *in, const char *path, struct stat *sb)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		printf("failed to open file %s\n", path);
+		return -1;
+	}
+	int rc = input_open_fd(in, fd, sb);
+	close(fd);
+
+	return rc;
+}
+
+void
+input_close(struct input *in)
+{
+	if (in->base == NULL) {
+		return;
+	}
+	if (!in->mapped) {
+		free((void *)in->base);
+	} else if (in->len != 0) {
+		munmap((void *)in->base, in->len);
+	}
+	in->base = NULL;
+	in->len = 0;
+}
+
+enum input_compression
+input_compression(const char *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	if (len >= 2 && p[0] == 0x1f && p[1] == 0x8b) {
+		return COMPRESSION_GZIP;
+	}
+	if (len >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd) {
+		return COMPRESSION_ZSTD;
+	}
+
+	return COMPRESSION_NONE;
+}
+
+/*
+ * State of decompression of a single input. Compressed data are passed
+ * to a decoder by INFLATE_CHUNK bytes and decompressed data are written
+ * straight to a buffer of a reader.
+ */
+struct decoder {
+	const struct input *in;
+	size_t pos;		/* compressed bytes passed to a decoder */
+	int done;
+	z_stream zs;
+#ifdef HAVE_ZSTD
+	ZSTD_DStream *zds;
+#endif
+};
+
+static int
+decoder_init(struct decoder *d, const struct input *in)
+{
+	memset(d, 0, sizeof(struct decoder));
+	d->in = in;
+	switch (in->compression) {
+	case COMPRESSION_GZIP:
+		/* 32 enables detection of gzip and zlib headers */
+		if (inflateInit2(&d->zs, MAX_WBITS + 32) != Z_OK) {
+			fprintf(stderr, "inflateInit2 failed\n");
+			return -1;
+		}
+		return 0;
+	case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+		d->zds = ZSTD_createDStream();
+		if (d->zds == NULL) {
+			perror("malloc failed");
+			return -1;
+		}
+		ZSTD_initDStream(d->zds);
+		return 0;
+#else
+		fprintf(stderr, "built without zstd support\n");
+		return -1;
+#endif
+	case COMPRESSION_NONE:
+		break;
+	}
+
+	return 0;
+}
+
+static void
+decoder_free(struct decoder *d)
+{
+	switch (d->in->compression) {
+	case COMPRESSION_GZIP:
+		inflateEnd(&d->zs);
+		break;
+	case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+		ZSTD_freeDStream(d->zds);
+#endif
+		break;
+	case COMPRESSION_NONE:
+		break;
+	}
+}
+
+static ssize_t
+gzip_read(struct decoder *d, char *buf, size_t size)
+{
+	z_stream *zs = &d->zs;
+	zs->next_out = (Bytef *)buf;
+	zs->avail_out = size > UINT_MAX ? UINT_MAX : size;
+	while (zs->avail_out > 0 && !d->done) {
+		if (zs->avail_in == 0) {
+			size_t n = d->in->len - d->pos;
+			if (n == 0) {
+				/* truncated stream, return what was decompressed */
+				d->done = 1;
+				break;
+			}
+			n = n > INFLATE_CHUNK ? INFLATE_CHUNK : n;
+			zs->next_in = (Bytef *)d->in->base + d->pos;
+			zs->avail_in = n;
+			d->pos += n;
+		}
+		int rc = inflate(zs, Z_NO_FLUSH);
+		if (rc == Z_STREAM_END) {
+			/* gzip allows a file of several concatenated members */
+			if (zs->avail_in == 0 && d->pos == d->in->len) {
+				d->done = 1;
+			} else if (inflateReset(zs) != Z_OK) {
+				return -1;
+			}
+		} else if (rc != Z_OK) {
+			fprintf(stderr, "gzip: %s\n", zs->msg ? zs->msg : "corrupted data");
+			errno = EIO;
+			return -1;
+		}
+	}
+
+	return (char *)zs->next_out - buf;
+}
+
+#ifdef HAVE_ZSTD
+static ssize_t
+zstd_read(struct decoder *d, char *buf, size_t size)
+{
+	ZSTD_outBuffer out = { buf, size, 0 };
+	while (out.pos < out.size && !d->done) {
+		size_t n = d->in->len - d->pos;
+		n = n > INFLATE_CHUNK ? INFLATE_CHUNK : n;
+		ZSTD_inBuffer zin = { d->in->base + d->pos, n, 0 };
+		size_t rc = ZSTD_decompressStream(d->zds, &out, &zin);
+		if (ZSTD_isError(rc)) {
+			fprintf(stderr, "zstd: %s\n", ZSTD_getErrorName(rc));
+			errno = EIO;
+			return -1;
+		}
+		d->pos += zin.pos;
+		/* a decoder flushes all it can until a buffer is full */
+		if (d->pos == d->in->len && out.pos < out.size) {
+			d->done = 1;
+		}
+	}
+
+	return out.pos;
+}
+#endif
+
+static ssize_t
+decoder_read(struct decoder *d, char *buf, size_t size)
+{
+	switch (d->in->compression) {
+	case COMPRESSION_GZIP:
+		return gzip_read(d, buf, size);
+	case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+		return zstd_read(d, buf, size);
+#else
+		break;
+#endif
+	case COMPRESSION_NONE:
+		break;
+	}
+
+	errno = EINVAL;
+	return -1;
+}
+
+/*
+ * Decompress the beginning of an input, it is used to detect a format
+ * of a compressed report.
+ */
+ssize_t
+input_peek(struct input *in, char *buf, size_t size)
+{
+	if (in->compression == COMPRESSION_NONE) {
+		size = in->len < size ? in->len : size;
+		memcpy(buf, in->base, size);
+		return size;
+	}
+
+	struct decoder d;
+	if (decoder_init(&d, in) == -1) {
+		return -1;
+	}
+	size_t len = 0;
+	while (len < size) {
+		ssize_t n = decoder_read(&d, buf + len, size - len);
+		if (n <= 0) {
+			break;
+		}
+		len += n;
+	}
+	decoder_free(&d);
+
+	return len;
+}
+
+static ssize_t
+cookie_read(void *cookie, char *buf, size_t size)
+{
+	return decoder_read(cookie, buf, size);
+}
+
+static int
+cookie_close(void *cookie)
+{
+	decoder_free(cookie);
+	free(cookie);
+
+	return 0;
+}
+
+#ifndef __linux__
+static int
+funopen_read(void *cookie, char *buf, int size)
+{
+	return cookie_read(cookie, buf, size);
+}
+#endif
+
+/*
+ * A stream over the same memory for parsers that read with stdio. Reads
+ * from a stream over a compressed input return decompressed data. An
+ * empty input has no stream.
+ */
+FILE *
+input_fopen(struct input *in)
+{
+	if (in->len == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (in->compression == COMPRESSION_NONE) {
+		return fmemopen((void *)in->base, in->len, "r");
+	}
+
+	struct decoder *d = calloc(1, sizeof(struct decoder));
+	if (d == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	if (decoder_init(d, in) == -1) {
+		free(d);
+		return NULL;
+	}
+#ifdef __linux__
+	cookie_io_functions_t io = { cookie_read, NULL, NULL, cookie_close };
+	FILE *file = fopencookie(d, "r", io);
+#else
+	FILE *file = funopen(d, funopen_read, NULL, NULL, cookie_close);
+#endif
+	if (file == NULL) {
+		cookie_close(d);
+	}
+
+	return file;
+}
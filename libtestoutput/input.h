@@ -0,0 +1,74 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/*
+ * Contents of a report file. A regular file is mapped to memory once and
+ * both format detection and a parser work on the same mapping. Other
+ * files (pipes, character devices) are read into a heap buffer.
+ *
+ * A mapped file that is truncated by another process while it is parsed
+ * raises SIGBUS on access to the lost pages. Mapping is disabled with
+ * input_set_mmap() by a caller that reads files which may be rewritten
+ * at any moment, and all files are read into a heap buffer then.
+ *
+ * A file compressed with gzip or zstd is recognized by its magic number
+ * and decompressed on the fly, by chunks, so a decompressed report is
+ * never kept in memory as a whole.
+ */
+
+enum input_compression {
+	COMPRESSION_NONE,
+	COMPRESSION_GZIP,
+	COMPRESSION_ZSTD
+};
+
+struct input {
+	const char *base;
+	size_t len;
+	int mapped;
+	enum input_compression compression;
+};
+
+void input_set_mmap(int enable);
+int input_open(struct input *in, const char *path, struct stat *sb);
+int input_open_fd(struct input *in, int fd, struct stat *sb);
+void input_close(struct input *in);
+FILE *input_fopen(struct input *in);
+ssize_t input_peek(struct input *in, char *buf, size_t size);
+enum input_compression input_compression(const char *data, size_t len);
+
+#endif				/* INPUT_H */
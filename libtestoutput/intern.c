@@ -0,0 +1,212 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "hashmap.h"
+#include "intern.h"
+
+struct interned {
+	uint32_t id;
+	char str[];
+};
+
+/*
+ * Parser threads intern every name they read, so strings are spread over
+ * shards by a hash and each shard has its own lock, table and arena.
+ * Ids are given from a single counter and stay unique across shards.
+ */
+#define SHARD_BITS	6
+#define N_SHARDS	(1 << SHARD_BITS)
+
+struct shard {
+	pthread_mutex_t lock;
+	struct hashmap *table;	/* str -> struct interned */
+	struct arena *strings;
+};
+
+static struct shard shards[N_SHARDS];
+static pthread_once_t shards_once = PTHREAD_ONCE_INIT;
+static uint32_t last_id;	/* updated atomically */
+
+#define INTERNED(s)	((const struct interned *)((s) - offsetof(struct interned, str)))
+
+static void
+init_shards(void)
+{
+	int i;
+	for (i = 0; i < N_SHARDS; i++) {
+		pthread_mutex_init(&shards[i].lock, NULL);
+	}
+}
+
+/* low bits of a hash choose a slot in a table, so high bits are used */
+static struct shard *
+get_shard(const char *s, size_t len)
+{
+	pthread_once(&shards_once, init_shards);
+
+	return &shards[hashmap_hash(s, len) >> (32 - SHARD_BITS)];
+}
+
+/* called with the lock of a shard held */
+static struct interned *
+lookup(struct shard *shard, const char *s, size_t len)
+{
+	if (shard->table == NULL) {
+		return NULL;
+	}
+
+	return hashmap_get(shard->table, s, len);
+}
+
+const char *
+intern_len(const char *s, size_t len)
+{
+	if (s == NULL) {
+		return NULL;
+	}
+
+	struct shard *shard = get_shard(s, len);
+	pthread_mutex_lock(&shard->lock);
+	struct interned *item = lookup(shard, s, len);
+	if (item != NULL) {
+		pthread_mutex_unlock(&shard->lock);
+		return item->str;
+	}
+
+	if (shard->table == NULL) {
+		shard->table = hashmap_new(0);
+		shard->strings = arena_new();
+		if (shard->table == NULL || shard->strings == NULL) {
+			hashmap_free(shard->table);
+			arena_free(shard->strings);
+			shard->table = NULL;
+			shard->strings = NULL;
+			pthread_mutex_unlock(&shard->lock);
+			return NULL;
+		}
+	}
+	item = arena_alloc(shard->strings, sizeof(struct interned) + len + 1);
+	if (item == NULL) {
+		pthread_mutex_unlock(&shard->lock);
+		return NULL;
+	}
+	memcpy(item->str, s, len);
+	item->str[len] = '\0';
+	if (hashmap_put(shard->table, item->str, len, item) != 0) {
+		/* arena memory of the item is lost until exit */
+		pthread_mutex_unlock(&shard->lock);
+		return NULL;
+	}
+	/* other threads see the item only under the lock of the shard */
+	item->id = __atomic_add_fetch(&last_id, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&shard->lock);
+
+	return item->str;
+}
+
+const char *
+intern(const char *s)
+{
+	if (s == NULL) {
+		return NULL;
+	}
+
+	return intern_len(s, strlen(s));
+}
+
+/* interned copy of a string or NULL when it has never been interned */
+const char *
+intern_find(const char *s)
+{
+	if (s == NULL) {
+		return NULL;
+	}
+
+	size_t len = strlen(s);
+	struct shard *shard = get_shard(s, len);
+	pthread_mutex_lock(&shard->lock);
+	struct interned *item = lookup(shard, s, len);
+	pthread_mutex_unlock(&shard->lock);
+
+	return item ? item->str : NULL;
+}
+
+/* s must be returned by intern() */
+uint32_t
+intern_id(const char *s)
+{
+	if (s == NULL) {
+		return 0;
+	}
+
+	return INTERNED(s)->id;
+}
+
+/*
+ * Starts a new generation of interned strings. A callback moves strings
+ * that are still used to it with intern() and replaces its pointers with
+ * the returned ones, all other strings are freed and ids are given anew.
+ * No other thread may use interned strings meanwhile.
+ */
+void
+intern_compact(void (*keep)(void *arg), void *arg)
+{
+	struct shard old[N_SHARDS];
+	int i;
+
+	pthread_once(&shards_once, init_shards);
+	for (i = 0; i < N_SHARDS; i++) {
+		pthread_mutex_lock(&shards[i].lock);
+		old[i].table = shards[i].table;
+		old[i].strings = shards[i].strings;
+		shards[i].table = NULL;
+		shards[i].strings = NULL;
+		pthread_mutex_unlock(&shards[i].lock);
+	}
+	__atomic_store_n(&last_id, 0, __ATOMIC_RELAXED);
+
+	if (keep != NULL) {
+		keep(arg);
+	}
+	for (i = 0; i < N_SHARDS; i++) {
+		hashmap_free(old[i].table);
+		arena_free(old[i].strings);
+	}
+}
+
+size_t
+intern_count(void)
+{
+	return __atomic_load_n(&last_id, __ATOMIC_RELAXED);
+}
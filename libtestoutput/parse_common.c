@@ -26,25 +26,31 @@
  *
  */
 
-#include <dirent.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+#include "arena.h"
+#include "columns.h"
+#include "dir_walk.h"
+#include "input.h"
 #include "parse_common.h"
 #include "parse_junit.h"
 #include "parse_subunit_v1.h"
 #include "parse_subunit_v2.h"
+#include "report_cache.h"
 #include "sha1.h"
+#include "worker_pool.h"
 
-extern struct suiteq *parse_testanything(FILE *f);
+extern struct suiteq *parse_testanything_arena(FILE *f, struct arena *arena);
+extern struct suiteq *parse_testanything_buffer(const char *data, size_t len,
+						struct arena *arena);
 
 void
 free_reports(struct reportq * reports)
 {
 	tailq_report *report_item = NULL;
 	while ((report_item = TAILQ_FIRST(reports))) {
-		if (report_item->suites != NULL) {
-			free_suites(report_item->suites);
-		}
 		TAILQ_REMOVE(reports, report_item, entries);
 		free_report(report_item);
 	}
@@ -53,14 +59,28 @@ free_reports(struct reportq * reports)
 void 
 free_report(tailq_report *report)
 {
-	if (report->suites != NULL) {
-		free_suites(report->suites);
-	}
+	free_report_suites(report);
 	free(report->path);
 	free(report->id);
 	free(report);
 }
 
+/* keep a summary of a report only */
+void
+free_report_suites(tailq_report *report)
+{
+	columns_free(report->columns);
+	report->columns = NULL;
+	if (report->arena != NULL) {
+		arena_free(report->arena);
+		report->arena = NULL;
+	} else if (report->suites != NULL) {
+		free_suites(report->suites);
+		free(report->suites);
+	}
+	report->suites = NULL;
+}
+
 void 
 free_suites(struct suiteq * suites)
 {
@@ -74,17 +94,13 @@ free_suites(struct suiteq * suites)
 void 
 free_suite(tailq_suite * suite)
 {
-	if (suite->name) {
-	   free((char*)suite->name);
-        }
-	if (suite->hostname) {
-	   free((char*)suite->hostname);
-        }
+	/* name and hostname are interned */
 	if (suite->timestamp) {
 	   free((char*)suite->timestamp);
         }
-	if (!TAILQ_EMPTY(suite->tests)) {
+	if (suite->tests) {
 		free_tests(suite->tests);
+		free(suite->tests);
 	}
 
 	free(suite);
@@ -103,15 +119,16 @@ free_tests(struct testq * tests)
 void 
 free_test(tailq_test * test)
 {
-	if (test->name) {
-	   free((char*)test->name);
-        }
+	/* name is interned */
 	if (test->time) {
 	   free((char*)test->time);
         }
 	if (test->comment) {
 	   free((char*)test->comment);
         }
+	if (test->diagnostics) {
+	   free((char*)test->diagnostics);
+        }
 	if (test->error) {
 	   free((char*)test->error);
         }
@@ -134,11 +151,20 @@ get_filename_ext(const char *filename)
 	return dot + 1;
 }
 
-enum test_format 
-detect_format(char *path)
+static enum test_format
+format_by_ext(const char *path)
 {
+	const char *name = strrchr(path, '/');
+	char stem[NAME_MAX + 1];
 	char *file_ext;
-	file_ext = get_filename_ext(basename(path));
+	snprintf(stem, sizeof(stem), "%s", name ? name + 1 : path);
+	file_ext = get_filename_ext(stem);
+	/* junit.xml.gz has the same format as junit.xml */
+	if (file_ext != NULL && (strcasecmp("gz", file_ext) == 0 ||
+				 strcasecmp("zst", file_ext) == 0)) {
+		file_ext[-1] = '\0';
+		file_ext = get_filename_ext(stem);
+	}
 	if (file_ext == NULL) {
 	   return FORMAT_UNKNOWN;
 	}
@@ -148,94 +174,655 @@ detect_format(char *path)
 	} else if (strcasecmp("tap", file_ext) == 0) {
 		return FORMAT_TAP13;
 	} else if (strcasecmp("subunit", file_ext) == 0) {
-		if (is_subunit_v2(path) == 0) {
-		   return FORMAT_SUBUNIT_V2;
-		} else {
-		   return FORMAT_SUBUNIT_V1;
-		}
+		return FORMAT_SUBUNIT_V1;
 	} else {
 		return FORMAT_UNKNOWN;
 	}
 }
 
+static int
+starts_with(const char *p, const char *end, const char *s)
+{
+	size_t n = strlen(s);
+
+	return (size_t)(end - p) >= n && memcmp(p, s, n) == 0;
+}
+
+static int
+contains(const char *p, const char *end, const char *s)
+{
+	for (; p < end; p++) {
+		if (*p == *s && starts_with(p, end, s)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+is_word_end(const char *p, const char *end)
+{
+	return p == end || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n';
+}
+
+static int
+is_subunit_v1_line(const char *p, const char *end)
+{
+	static const char *directives[] = {
+		"test", "testing", "success", "successful", "failure", "error",
+		"skip", "xfail", "uxsuccess", "progress", "tags", "time", NULL
+	};
+	const char **d;
+	for (d = directives; *d != NULL; d++) {
+		size_t n = strlen(*d);
+		if ((size_t)(end - p) <= n || strncasecmp(p, *d, n) != 0) {
+			continue;
+		}
+		if (p[n] == ':' && is_word_end(p + n + 1, end)) {
+			return 1;
+		}
+		/* a colon is optional for some directives */
+		if (p[n] == ' ' && starts_with(p + n + 1, end, "test ")) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Guess a format by the first SNIFF_SIZE bytes of a report. Lines that
+ * are not recognized are skipped, because both TAP and SubUnit v1 allow
+ * arbitrary output between results.
+ */
+enum test_format
+sniff_format(const char *data, size_t len, enum detect_confidence *confidence)
+{
+	const char *p = data;
+	const char *end = data + (len > SNIFF_SIZE ? SNIFF_SIZE : len);
+
+	*confidence = CONFIDENCE_NONE;
+	if (len == 0) {
+		return FORMAT_UNKNOWN;
+	}
+	if ((uint8_t)p[0] == SUBUNIT_SIGNATURE) {
+		if (len > 1 && ((uint8_t)p[1] >> 4) == SUBUNIT_VERSION) {
+			*confidence = CONFIDENCE_HIGH;
+		} else {
+			*confidence = CONFIDENCE_LOW;
+		}
+		return FORMAT_SUBUNIT_V2;
+	}
+	if (starts_with(p, end, "\xEF\xBB\xBF")) {
+		/* UTF-8 byte order mark */
+		p += 3;
+	}
+
+	while (p < end) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+			p++;
+		}
+		if (p >= end) {
+			break;
+		}
+		const char *eol = memchr(p, '\n', (size_t)(end - p));
+		if (eol == NULL) {
+			eol = end;
+		}
+		if (*p == '<') {
+			if (contains(p, end, "<testsuite")) {
+				*confidence = CONFIDENCE_HIGH;
+			} else {
+				*confidence = CONFIDENCE_LOW;
+			}
+			return FORMAT_JUNIT;
+		}
+		if (starts_with(p, eol, "TAP version") ||
+		    (starts_with(p, eol, "1..") && p + 3 < eol &&
+		     p[3] >= '0' && p[3] <= '9')) {
+			*confidence = CONFIDENCE_HIGH;
+			return FORMAT_TAP13;
+		}
+		if ((starts_with(p, eol, "ok") && is_word_end(p + 2, eol)) ||
+		    (starts_with(p, eol, "not ok") && is_word_end(p + 6, eol))) {
+			*confidence = CONFIDENCE_MEDIUM;
+			return FORMAT_TAP13;
+		}
+		if (is_subunit_v1_line(p, eol)) {
+			*confidence = CONFIDENCE_MEDIUM;
+			return FORMAT_SUBUNIT_V1;
+		}
+		p = eol + 1;
+	}
+
+	return FORMAT_UNKNOWN;
+}
+
+/* a compressed report is detected by its decompressed beginning */
+static enum test_format
+detect_format_input(const char *path, struct input *in)
+{
+	char prefix[SNIFF_SIZE];
+	ssize_t n = input_peek(in, prefix, sizeof(prefix));
+	if (n < 0) {
+		n = 0;
+	}
+
+	return detect_format_buffer(path, prefix, n);
+}
+
+enum test_format
+detect_format(const char *path)
+{
+	struct input in;
+	struct stat sb;
+	int fd = open(path, O_RDONLY);
+	if (fd == -1 || input_open_fd(&in, fd, &sb) == -1) {
+		if (fd != -1) {
+			close(fd);
+		}
+		return detect_format_buffer(path, "", 0);
+	}
+	close(fd);
+	enum test_format format = detect_format_input(path, &in);
+	input_close(&in);
+
+	return format;
+}
+
+/*
+ * Report contents win over a file extension when they are recognized
+ * with confidence, otherwise an extension breaks a tie.
+ */
+enum test_format
+detect_format_buffer(const char *path, const char *data, size_t len)
+{
+	enum detect_confidence confidence;
+	enum test_format format = sniff_format(data, len, &confidence);
+	if (confidence == CONFIDENCE_HIGH) {
+		return format;
+	}
+
+	switch (format_by_ext(path)) {
+	case FORMAT_JUNIT:
+		return FORMAT_JUNIT;
+	case FORMAT_TAP13:
+		return FORMAT_TAP13;
+	case FORMAT_SUBUNIT_V1:
+	case FORMAT_SUBUNIT_V2:
+		if (is_subunit_v2_buffer(data, len) == 0) {
+			return FORMAT_SUBUNIT_V2;
+		}
+		return FORMAT_SUBUNIT_V1;
+	case FORMAT_UNKNOWN:
+		break;
+	}
+
+	return format;
+}
+
+/* str must have room for 2 * n + 1 characters */
 unsigned char *digest_to_str(unsigned char *str, unsigned char digest[], unsigned int n) {
 	int r;
 	if (n == 0) return 0;
-	if (n == 1) r = sprintf((char*)str, "%x", digest[0]);
-	else        r = sprintf((char*)str, "%x", digest[0]);
+	r = sprintf((char*)str, "%02x", digest[0]);
 	digest_to_str(str + r, digest + 1, n - 1);
 
 	return str;
 }
 
+static int
+hex_value(char c)
+{
+	unsigned int d = (unsigned char)c - '0';
+	if (d < 10) {
+		return d;
+	}
+	d = ((unsigned char)c | 0x20) - 'a';	/* lower case */
+	if (d < 6) {
+		return d + 10;
+	}
+
+	return -1;
+}
+
+/* a report id back to a digest, -1 when it is not a valid id */
+int
+str_to_digest(const char *str, unsigned char digest[])
+{
+	if (str == NULL || strlen(str) != 2 * REPORT_DIGEST_LEN) {
+		return -1;
+	}
+	int i;
+	for (i = 0; i < REPORT_DIGEST_LEN; i++) {
+		int hi = hex_value(str[2 * i]);
+		int lo = hex_value(str[2 * i + 1]);
+		if (hi < 0 || lo < 0) {
+			return -1;
+		}
+		digest[i] = hi << 4 | lo;
+	}
+
+	return 0;
+}
+
+void
+report_digest(const char *path, unsigned char digest[])
+{
+	SHA1_CTX ctx;
+	SHA1Init(&ctx);
+	SHA1Update(&ctx, (const unsigned char *)path, strlen(path));
+	SHA1Final(digest, &ctx);
+}
+
 tailq_report *
-process_file(char *path)
+process_file(const char *path)
 {
-	FILE *file;
-	file = fopen(path, "r");
-	if (file == NULL) {
-		printf("failed to open file %s\n", path);
+	struct input in;
+	struct stat sb;
+	if (input_open(&in, path, &sb) == -1) {
 		return NULL;
 	}
 	tailq_report *report = NULL;
 	report = calloc(1, sizeof(tailq_report));
 	if (report == NULL) {
 		perror("malloc failed");
-		fclose(file);
+		input_close(&in);
 		return NULL;
 	}
-	enum test_format format;
-	format = detect_format(path);
+	enum test_format format = FORMAT_UNKNOWN;
+	if (in.compression != COMPRESSION_NONE) {
+		format = detect_format_input(path, &in);
+	} else if (in.len != 0) {
+		format = detect_format_buffer(path, in.base, in.len);
+	}
+	if (format != FORMAT_UNKNOWN && (report->arena = arena_new()) == NULL) {
+		free(report);
+		input_close(&in);
+		return NULL;
+	}
+	struct arena *arena = report->arena;
+	FILE *file = NULL;
 	switch (format) {
 	case FORMAT_JUNIT:
 		report->format = FORMAT_JUNIT;
-		report->suites = parse_junit(file);
+		if (in.compression == COMPRESSION_NONE) {
+			report->suites = parse_junit_buffer(in.base, in.len, arena);
+			break;
+		}
+		if ((file = input_fopen(&in)) == NULL) {
+			break;
+		}
+		report->suites = parse_junit_r(file, arena);
 		break;
 	case FORMAT_TAP13:
 		report->format = FORMAT_TAP13;
-		report->suites = parse_testanything(file);
+		if (in.compression == COMPRESSION_NONE) {
+			report->suites = parse_testanything_buffer(in.base, in.len, arena);
+			break;
+		}
+		if ((file = input_fopen(&in)) == NULL) {
+			break;
+		}
+		report->suites = parse_testanything_arena(file, arena);
 		break;
 	case FORMAT_SUBUNIT_V1:
 		report->format = FORMAT_SUBUNIT_V1;
-		report->suites = parse_subunit_v1(file);
+		if (in.compression == COMPRESSION_NONE) {
+			report->suites = parse_subunit_v1_buffer(in.base, in.len, arena);
+			break;
+		}
+		if ((file = input_fopen(&in)) == NULL) {
+			break;
+		}
+		report->suites = parse_subunit_v1_arena(file, arena);
 		break;
 	case FORMAT_SUBUNIT_V2:
 		report->format = FORMAT_SUBUNIT_V2;
-		report->suites = parse_subunit_v2(file);
+		if (in.compression == COMPRESSION_NONE) {
+			report->suites = parse_subunit_v2_buffer(in.base, in.len, arena);
+			break;
+		}
+		if ((file = input_fopen(&in)) == NULL) {
+			break;
+		}
+		report->suites = parse_subunit_v2_arena(file, arena);
 		break;
 	case FORMAT_UNKNOWN:
 		report->format = FORMAT_UNKNOWN;
+		input_close(&in);
 		return report;
 	}
-	fclose(file);
+	if (file != NULL) {
+		fclose(file);
+	}
+	input_close(&in);
 
 	report->path = (unsigned char*)strdup(path);
 
-	int length = 20;
-	unsigned char digest[length];
-	SHA1_CTX ctx;
-	SHA1Init(&ctx);
-	SHA1Update(&ctx, report->path, strlen(path));
-	SHA1Final(digest, &ctx);
-
-	report->id = calloc(length, sizeof(unsigned char*));
-	digest_to_str(report->id, digest, length);
-
-	struct stat sb;
-	if (stat(path, &sb) == -1) {
-		perror("cannot open specified path");
+	report_digest(path, report->digest);
+	report->id = calloc(2 * REPORT_DIGEST_LEN + 1, sizeof(unsigned char));
+	if (report->id == NULL) {
+		perror("malloc failed");
+		free_report(report);
 		return NULL;
 	}
+	digest_to_str(report->id, report->digest, REPORT_DIGEST_LEN);
+
 	report->time = sb.st_mtime;
+	summarize_report(report);
 
 	return report;
 }
 
+/*
+ * Load suites of a report that was loaded as a summary. A cache is used
+ * when it has an up to date entry, otherwise a report file is parsed
+ * again.
+ */
+int
+load_suites(tailq_report *report, const char *cache)
+{
+	if (report->suites != NULL) {
+		return 0;
+	}
+
+	tailq_report *full = NULL;
+	struct stat sb;
+	if (cache != NULL && stat((char *)report->path, &sb) == 0) {
+		struct report_cache *c = cache_open(cache);
+		if (c != NULL) {
+			full = cache_lookup(c, (char *)report->path, &sb);
+			cache_close(c);
+		}
+	}
+	if (full == NULL) {
+		full = process_file((const char *)report->path);
+	}
+	if (full == NULL || full->suites == NULL) {
+		if (full != NULL) {
+			free_report(full);
+		}
+		return -1;
+	}
+	report->suites = full->suites;
+	report->arena = full->arena;
+	report->summary = full->summary;
+	full->suites = NULL;
+	full->arena = NULL;
+	free_report(full);
+
+	return 0;
+}
+
+/*
+ * Subunit attaches named files to a test, e.g. a traceback or a reason
+ * of a skip. Returns a field of a test a file is kept in.
+ */
+const char **
+test_attachment(tailq_test *test, const char *name, size_t len)
+{
+	if (len == 9 && memcmp(name, "traceback", 9) == 0) {
+		return &test->error;
+	} else if (len == 6 && memcmp(name, "reason", 6) == 0) {
+		return &test->comment;
+	} else if (len == 6 && memcmp(name, "stderr", 6) == 0) {
+		return &test->system_err;
+	}
+
+	return &test->system_out;
+}
+
+/* a text may come in parts, a part is appended to a text */
+int
+test_append_text(struct arena *arena, const char **text, const char *data,
+		 size_t len)
+{
+	size_t old_len = *text ? strlen(*text) : 0;
+	char *s = arena_alloc(arena, old_len + len + 1);
+	if (s == NULL) {
+		perror("malloc failed");
+		return -1;
+	}
+	if (old_len != 0) {
+		memcpy(s, *text, old_len);
+	}
+	memcpy(s + old_len, data, len);
+	s[old_len + len] = '\0';
+	if (arena == NULL) {
+		free((char *)*text);
+	}
+	*text = s;
+
+	return 0;
+}
+
+/*
+ * Numbers in reports are written in the C locale, so they are parsed
+ * here rather than with atof(3) and strptime(3), which depend on a
+ * locale and are noticeably slower on large reports.
+ */
+
+static const double powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define MAX_EXACT_MANTISSA	((uint64_t)1 << 53)
+
+/*
+ * Decimal number like "0.012", "3" or "1.5e-3". A pointer past the number
+ * is stored to end like strtod(3) does, s itself when there is none.
+ */
+double
+parse_number(const char *s, const char **end)
+{
+	const char *start = s;
+	while (*s == ' ' || *s == '\t') {
+		s++;
+	}
+	int negative = 0;
+	if (*s == '-' || *s == '+') {
+		negative = *s == '-';
+		s++;
+	}
+
+	uint64_t mantissa = 0;
+	int digits = 0, scale = 0, exact = 1;
+	for (; *s >= '0' && *s <= '9'; s++, digits++) {
+		if (mantissa < MAX_EXACT_MANTISSA / 10) {
+			mantissa = mantissa * 10 + (*s - '0');
+		} else {
+			scale++;
+			exact = 0;
+		}
+	}
+	if (*s == '.') {
+		for (s++; *s >= '0' && *s <= '9'; s++, digits++) {
+			if (mantissa < MAX_EXACT_MANTISSA / 10) {
+				mantissa = mantissa * 10 + (*s - '0');
+				scale--;
+			} else {
+				exact = 0;
+			}
+		}
+	}
+	if (digits == 0) {
+		if (end != NULL) {
+			*end = start;
+		}
+		return 0;
+	}
+	/* an exponent without digits is not a part of a number */
+	const char *e = s;
+	if (*e == 'e' || *e == 'E') {
+		e++;
+		if (*e == '-' || *e == '+') {
+			e++;
+		}
+	}
+	if (e != s && *e >= '0' && *e <= '9') {
+		int exp = 0, exp_negative = s[1] == '-';
+		for (s = e; *s >= '0' && *s <= '9'; s++) {
+			if (exp < 10000) {
+				exp = exp * 10 + (*s - '0');
+			}
+		}
+		scale += exp_negative ? -exp : exp;
+	}
+
+	/*
+	 * A mantissa and a power of ten that are both exact doubles give a
+	 * correctly rounded result with a single operation, the same as
+	 * strtod(3) returns. Other numbers get a close approximation.
+	 */
+	double value = (double)mantissa;
+	unsigned int n = scale < 0 ? -(unsigned int)scale : (unsigned int)scale;
+	if (exact && n <= 22) {
+		value = scale < 0 ? value / powers_of_ten[n] :
+		    value * powers_of_ten[n];
+	} else {
+		for (; n > 0; n--) {
+			value = scale < 0 ? value / 10 : value * 10;
+		}
+	}
+
+	if (end != NULL) {
+		*end = s;
+	}
+
+	return negative ? -value : value;
+}
+
+/* number of seconds, 0 when malformed */
+double
+parse_seconds(const char *s)
+{
+	if (s == NULL) {
+		return 0;
+	}
+
+	return parse_number(s, NULL);
+}
+
+static int
+parse_digits(const char **s, int n)
+{
+	int value = 0;
+	for (; n > 0; n--, (*s)++) {
+		if (**s < '0' || **s > '9') {
+			return -1;
+		}
+		value = value * 10 + (**s - '0');
+	}
+
+	return value;
+}
+
+/* days since 1970-01-01 of a date in the proleptic Gregorian calendar */
+static long
+days_from_civil(long y, int m, int d)
+{
+	y -= m <= 2;
+	long era = (y >= 0 ? y : y - 399) / 400;
+	long yoe = y - era * 400;
+	long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+/*
+ * Seconds since the Epoch of a timestamp like "2009-12-19T17:58:59",
+ * "2016-07-05 12:17:02.290433Z" or "2014-11-12T19:12:14+03:00".
+ * A timestamp without a time zone is in UTC. 0 when malformed.
+ */
+double parse_iso8601(const char *s)
+{
+	if (s == NULL) {
+		return 0;
+	}
+
+	int year = parse_digits(&s, 4);
+	if (year < 0 || *s++ != '-') {
+		return 0;
+	}
+	int month = parse_digits(&s, 2);
+	if (month < 1 || month > 12 || *s++ != '-') {
+		return 0;
+	}
+	int day = parse_digits(&s, 2);
+	if (day < 1 || day > 31) {
+		return 0;
+	}
+	double seconds = days_from_civil(year, month, day) * 86400.0;
+	if (*s != 'T' && *s != 't' && *s != ' ') {
+		return *s == '\0' ? seconds : 0;
+	}
+	s++;
+
+	int hour = parse_digits(&s, 2);
+	if (hour < 0 || hour > 24 || *s++ != ':') {
+		return 0;
+	}
+	int min = parse_digits(&s, 2);
+	if (min < 0 || min > 59) {
+		return 0;
+	}
+	int sec = 0;
+	if (*s == ':') {
+		s++;
+		sec = parse_digits(&s, 2);
+		if (sec < 0 || sec > 60) {
+			return 0;
+		}
+	}
+	seconds += hour * 3600 + min * 60 + sec;
+	if (*s == '.' || *s == ',') {
+		long fraction = 0;
+		int digits = 0;
+		for (s++; *s >= '0' && *s <= '9'; s++) {
+			if (digits < 9) {
+				fraction = fraction * 10 + (*s - '0');
+				digits++;
+			}
+		}
+		seconds += fraction / powers_of_ten[digits];
+	}
+
+	if (*s == '+' || *s == '-') {
+		int sign = *s++ == '-' ? -1 : 1;
+		int tz_hour = parse_digits(&s, 2);
+		if (tz_hour < 0) {
+			return 0;
+		}
+		if (*s == ':') {
+			s++;
+		}
+		int tz_min = 0;
+		if (*s >= '0' && *s <= '9') {
+			tz_min = parse_digits(&s, 2);
+			if (tz_min < 0) {
+				return 0;
+			}
+		}
+		seconds -= sign * (tz_hour * 3600 + tz_min * 60);
+	}
+
+	return seconds;
+}
+
 struct tailq_report *is_report_exists(struct reportq *reports, const char* report_id) {
 
+	unsigned char digest[REPORT_DIGEST_LEN];
+	if (str_to_digest(report_id, digest) != 0) {
+		return NULL;
+	}
+
 	tailq_report *report_item = NULL;
 	TAILQ_FOREACH(report_item, reports, entries) {
-	    if (strcmp(report_id, (char*)report_item->id) == 0) {
+	    if (memcmp(digest, report_item->digest, REPORT_DIGEST_LEN) == 0) {
 		break;
 	    }
 	}
@@ -243,6 +830,42 @@ struct tailq_report *is_report_exists(struct reportq *reports, const char* repor
 	return report_item;
 }
 
+/*
+ * A report by its id without walking a directory: a cache keeps digests
+ * of all reports it has seen, so only the file of the report is read.
+ * NULL when a report is not in a cache, a caller falls back to
+ * is_report_exists() then.
+ */
+tailq_report *
+find_report(const char *cache, const char *report_id)
+{
+	unsigned char digest[REPORT_DIGEST_LEN];
+	if (cache == NULL || str_to_digest(report_id, digest) != 0) {
+		return NULL;
+	}
+	struct report_cache *c = cache_open(cache);
+	if (c == NULL) {
+		return NULL;
+	}
+
+	tailq_report *report = NULL;
+	struct stat sb;
+	const char *path = cache_find_digest(c, digest);
+	if (path != NULL && stat(path, &sb) == 0) {
+		report = cache_lookup(c, path, &sb);
+		if (report == NULL) {
+			report = process_file(path);
+		}
+	}
+	cache_close(c);
+	if (report != NULL && report->format == FORMAT_UNKNOWN) {
+		free_report(report);
+		report = NULL;
+	}
+
+	return report;
+}
+
 /*
 static int cmp_date(const void *p1, const void *p2) {
    return strcmp(* (char * const *) p1, * (char * const *) p2);
@@ -253,22 +876,51 @@ struct reportq *sort_reports(struct reportq *reports) {
 }
 */
 
-int num_by_status_class(struct tailq_report *report, enum test_status_class c) {
+void summarize_report(struct tailq_report *report) {
 
-   int number = 0;
+   struct report_summary *s = &report->summary;
+   memset(s, 0, sizeof(*s));
    if (report->suites != NULL) {
       tailq_suite *suite_item = NULL;
       TAILQ_FOREACH(suite_item, report->suites, entries) {
          if (!TAILQ_EMPTY(suite_item->tests)) {
             tailq_test *test_item = NULL;
             TAILQ_FOREACH(test_item, suite_item->tests, entries) {
-               if (class_by_status(test_item->status) == c) number++;
+               s->n_total++;
+               s->total_time += test_item->duration;
+               switch (class_by_status(test_item->status)) {
+               case STATUS_CLASS_PASS:
+                  s->n_pass++;
+                  break;
+               case STATUS_CLASS_FAIL:
+                  s->n_fail++;
+                  if (test_item->duration > s->slowest_time) {
+                     s->slowest_time = test_item->duration;
+                     s->slowest = test_item->name;
+                  }
+                  break;
+               case STATUS_CLASS_SKIP:
+                  s->n_skip++;
+                  break;
+               }
             }
          }
       }
    }
+}
+
+int num_by_status_class(struct tailq_report *report, enum test_status_class c) {
+
+   switch (c) {
+   case STATUS_CLASS_PASS:
+      return report->summary.n_pass;
+   case STATUS_CLASS_FAIL:
+      return report->summary.n_fail;
+   case STATUS_CLASS_SKIP:
+      return report->summary.n_skip;
+   }
 
-   return number;
+   return 0;
 }
 
 enum test_status_class class_by_status(enum test_status status) {
@@ -314,75 +966,108 @@ enum test_status_class class_by_status(enum test_status status) {
 struct reportq*
 process_dir(const char *path) {
 
-	DIR *d;
-	int fd;
+	return process_dir_opts(path, NULL);
+}
 
-	fd = open(path, O_RDONLY);
-	if ((d = fdopendir(fd)) == NULL) {
-		printf("failed to open dir %s\n", path);
-		close(fd);
-		return NULL;
-	}
+static int
+submit_file(const char *path, void *arg)
+{
+	pool_submit(arg, path);
 
-	struct reportq *reports;
-	reports = calloc(1, sizeof(struct reportq));
-	if (reports == NULL) {
-	   return NULL;
-	}
-	TAILQ_INIT(reports);
+	return 0;
+}
 
-	struct dirent *dir;
-	char *path_file = (char *) NULL;
-	tailq_report *report_item;
-	while ((dir = readdir(d)) != NULL) {
-		char *basename;
-		basename = dir->d_name;
-		if ((strcmp("..", basename) == 0) || (strcmp(".", basename) == 0)) {
-		   continue;
-		}
-		/* TODO: recursive search in directories */
-		int path_len = strlen(path) + strlen(basename) + 2;
-		path_file = calloc(path_len, sizeof(char));
-		if (path_file == NULL) {
-			return NULL;
-		}
-		snprintf(path_file, path_len, "%s/%s", path, basename);
+struct reportq*
+process_dir_opts(const char *path, struct process_opts *opts) {
 
-		struct stat path_st;
-		if (stat(path, &path_st) == -1) {
-		   perror("cannot open specified path");
-		   return NULL;
-		}
-		if (S_ISREG(path_st.st_mode)) {
-		   continue;
+	struct report_cache *cache = NULL;
+	if (opts && opts->cache) {
+		cache = cache_open(opts->cache);
+	}
+
+	struct reportq *reports = process_dir_cache(path, opts, cache);
+	if (cache != NULL) {
+		if (reports != NULL) {
+			cache_save(cache);
 		}
-		report_item = process_file(path_file);
-		if (report_item->format != FORMAT_UNKNOWN) {
-		   TAILQ_INSERT_TAIL(reports, report_item, entries);
-        }
-		free(path_file);
+		cache_close(cache);
 	}
-	close(fd);
-	closedir(d);
 
 	return reports;
 }
 
+/*
+ * The same as process_dir_opts() but with a cache owned by a caller,
+ * reports found in a directory are marked as used in the cache.
+ */
 struct reportq*
-process_db(const char *path)
-{
-	/* not implemented */
-	return NULL;
+process_dir_cache(const char *path, struct process_opts *opts,
+		  struct report_cache *cache) {
+
+	struct worker_pool *pool;
+	pool = pool_create(opts ? opts->jobs : 1, cache, opts ? opts->summary : 0);
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	struct walk_opts walk_opts = { 0, NULL, NULL };
+	if (opts) {
+		walk_opts.max_depth = opts->depth;
+		walk_opts.pattern = opts->pattern;
+	}
+	int rc = walk_dir(path, &walk_opts, submit_file, pool);
+
+	struct reportq *reports = pool_finish(pool);
+	if (rc == -1) {
+		free_reports(reports);
+		free(reports);
+		return NULL;
+	}
+
+	return reports;
 }
 
+/* see https://www.sqlite.org/fileformat.html */
 int
-check_sqlite(char *path)
+check_sqlite(const char *path)
 {
-	/* not implemented */
-	/* see https://www.sqlite.org/fileformat.html */
-	return 1;
+	static const char magic[] = "SQLite format 3";
+	char header[sizeof(magic)];
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		return -1;
+	}
+	ssize_t n = read(fd, header, sizeof(header));
+	close(fd);
+	if (n != (ssize_t)sizeof(header)) {
+		return 1;
+	}
+
+	return memcmp(header, magic, sizeof(magic)) == 0 ? 0 : 1;
 }
 
+static int
+has_test_prefix(tailq_report *report, const char *prefix, size_t len)
+{
+	tailq_suite *suite_item = NULL;
+	TAILQ_FOREACH(suite_item, report->suites, entries) {
+		tailq_test *test_item = NULL;
+		TAILQ_FOREACH(test_item, suite_item->tests, entries) {
+			if (test_item->name != NULL &&
+			    strncmp(test_item->name, prefix, len) == 0) {
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Reports with a test name starting with qsearch are moved to a returned
+ * list, the same rule as a search in a database, see process_db_filter().
+ */
 struct reportq *filter_reports(struct reportq *reports, const char *qsearch) {
 
 	if (qsearch == NULL || reports == NULL) {
@@ -392,32 +1077,22 @@ struct reportq *filter_reports(struct reportq *reports, const char *qsearch) {
 	struct reportq *filtered;
 	filtered = calloc(1, sizeof(struct reportq));
 	if (filtered == NULL) {
+		perror("malloc failed");
 		return NULL;
 	}
 	TAILQ_INIT(filtered);
 
-	tailq_report *report_item = NULL;
-	TAILQ_FOREACH(report_item, reports, entries) {
-		if (report_item->suites != NULL) {
-			tailq_suite *suite_item = NULL;
-			int matched = 0;
-			TAILQ_FOREACH(suite_item, report_item->suites, entries) {
-				if (matched == 1) {
-					break;
-				}
-				if (!TAILQ_EMPTY(suite_item->tests)) {
-					tailq_test *test_item = NULL;
-					TAILQ_FOREACH(test_item, suite_item->tests, entries) {
-						if (strstr(test_item->name, qsearch) != NULL) {
-							TAILQ_INSERT_TAIL(filtered, report_item, entries);
-							matched = 1;
-							break;
-						}
-					}
-				}
-			}
+	size_t len = strlen(qsearch);
+	tailq_report *report_item = TAILQ_FIRST(reports);
+	while (report_item != NULL) {
+		tailq_report *next = TAILQ_NEXT(report_item, entries);
+		if (report_item->suites != NULL &&
+		    has_test_prefix(report_item, qsearch, len)) {
+			TAILQ_REMOVE(reports, report_item, entries);
+			TAILQ_INSERT_TAIL(filtered, report_item, entries);
 		}
+		report_item = next;
 	}
 
-	return reports;
+	return filtered;
 }
@@ -49,6 +49,16 @@ enum test_format {
 	FORMAT_SUBUNIT_V2
 };
 
+enum detect_confidence {
+	CONFIDENCE_NONE,
+	CONFIDENCE_LOW,
+	CONFIDENCE_MEDIUM,
+	CONFIDENCE_HIGH
+};
+
+/* number of bytes looked at to detect a format */
+#define SNIFF_SIZE	512
+
 enum test_status {
 	STATUS_OK,			/* TestAnythingProtocol	*/
 	STATUS_NOTOK,		/* TestAnythingProtocol	*/
@@ -76,13 +86,27 @@ enum test_status_class {
 	STATUS_CLASS_SKIP
 };
 
+/*
+ * Text of a test that is left in a report file instead of memory, see
+ * junit_set_opts(). A span of zero length has no text.
+ */
+struct text_span {
+    off_t offset;		/* of the raw text in a report file */
+    size_t len;
+};
+
 struct tailq_test {
     const char *name;
-    const char *time;
+    const char *time;		/* duration as written in a report */
+    double duration;		/* seconds, 0 when unknown */
     const char *comment;
-    const char *error;
+    const char *diagnostics;	/* YAML block of a TAP test, see tap_yaml.h */
+    const char *error;		/* text of an error or a failure */
     const char *system_out;
     const char *system_err;
+    struct text_span error_span;
+    struct text_span system_out_span;
+    struct text_span system_err_span;
     enum test_status status;
     TAILQ_ENTRY(tailq_test) entries;
 };
@@ -93,6 +117,7 @@ struct tailq_suite {
     const char *name;
     const char *hostname;
     const char *timestamp;
+    time_t started;		/* timestamp since the Epoch, 0 when unknown */
     int n_failures;
     int n_errors;
     double time;
@@ -102,40 +127,97 @@ struct tailq_suite {
 
 TAILQ_HEAD(suiteq, tailq_suite);
 
+/* computed once when a report is parsed and known without suites */
+struct report_summary {
+    int n_pass;
+    int n_fail;
+    int n_skip;
+    int n_total;
+    double total_time;		/* sum of durations of tests, seconds */
+    const char *slowest;	/* interned name of the slowest failed test */
+    double slowest_time;
+};
+
+struct arena;
+struct test_columns;
+
+/* SHA-1 of a path of a report, shown as a hex string in report ids */
+#define REPORT_DIGEST_LEN	20
+
 struct tailq_report {
     enum test_format format;
-    struct suiteq *suites;
+    struct suiteq *suites;	/* NULL when only a summary is loaded */
+    struct arena *arena;	/* owns suites, tests and their strings */
+    struct test_columns *columns;	/* tests as arrays, see columns.h */
+    struct report_summary summary;
     time_t time;
-    unsigned char *id;
+    unsigned char *id;		/* digest as a hex string */
+    unsigned char digest[REPORT_DIGEST_LEN];
     unsigned char *path;
     TAILQ_ENTRY(tailq_report) entries;
 };
 
 TAILQ_HEAD(reportq, tailq_report);
 
+struct process_opts {
+    int jobs;		/* number of parser threads, 0 - one per online CPU */
+    const char *cache;	/* path to a cache of parsed reports or NULL */
+    int depth;		/* depth of subdirectories, -1 - no limit */
+    const char *pattern;	/* fnmatch(3) pattern for report names or NULL */
+    int summary;	/* keep summaries of reports only, see load_suites() */
+};
+
 typedef struct tailq_test tailq_test;
 typedef struct tailq_suite tailq_suite;
 typedef struct tailq_report tailq_report;
 
+/*
+ * Parsers of live streams pass every finished test to a callback instead
+ * of keeping it, see stream.h. A test and its strings are valid only
+ * during a call.
+ */
+typedef void (*test_result_cb)(const tailq_test *test, void *arg);
+
+struct report_cache;
+
 /* cleanup */
 void free_reports(struct reportq *reports);
 void free_suites(struct suiteq *suites);
 void free_tests(struct testq *tests);
 
 void free_report(tailq_report * report);
+void free_report_suites(tailq_report * report);
 void free_suite(tailq_suite * suite);
 void free_test(tailq_test * test);
 
 
 char *get_filename_ext(const char *filename);
-enum test_format detect_format(char *path);
-int check_sqlite(char *path);
+enum test_format detect_format(const char *path);
+enum test_format detect_format_buffer(const char *path, const char *data,
+				      size_t len);
+enum test_format sniff_format(const char *data, size_t len,
+			      enum detect_confidence *confidence);
+int check_sqlite(const char *path);
 struct reportq *process_db(const char *path);
 struct reportq *process_dir(const char *path);
-tailq_report *process_file(char *path);
+struct reportq *process_dir_opts(const char *path, struct process_opts *opts);
+struct reportq *process_dir_cache(const char *path, struct process_opts *opts,
+				  struct report_cache *cache);
+tailq_report *process_file(const char *path);
+int load_suites(tailq_report *report, const char *cache);
+void summarize_report(tailq_report *report);
 tailq_test *make_test(char *name, char *time, char *comment);
+const char **test_attachment(tailq_test *test, const char *name, size_t len);
+int test_append_text(struct arena *arena, const char **text, const char *data,
+		     size_t len);
+double parse_number(const char *s, const char **end);
+double parse_seconds(const char *s);
+double parse_iso8601(const char *s);
 unsigned char *digest_to_str(unsigned char *str, unsigned char digest[], unsigned int n);
+int str_to_digest(const char *str, unsigned char digest[]);
+void report_digest(const char *path, unsigned char digest[]);
 struct tailq_report *is_report_exists(struct reportq *reports, const char* report_id);
+tailq_report *find_report(const char *cache, const char *report_id);
 
 /*
 static int cmp_date(const void *p1, const void *p2);
@@ -28,9 +28,16 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <fcntl.h>
 #include <ctype.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "arena.h"
+#include "intern.h"
 #include "parse_junit.h"
 
 #ifdef XML_LARGE_SIZE
@@ -50,163 +57,1329 @@
 #endif
 
 #define BUFFSIZE        8192
+#define CHUNKSIZE       (1024 * 1024)
+#define TEXT_CHUNK      256
+#define STACK_CHUNK     16
 
 /* https://github.com/kristapsdz/divecmd/blob/master/parser.c */
 
-char buf[BUFFSIZE];
+/*
+ * Text of an element. At most a limit of bytes is kept: the buffer grows
+ * twice at a time and is reused for every text of a report, so memory
+ * taken by a text is bounded however large it is in a report.
+ */
+struct text_buf {
+	char *data;
+	size_t len;		/* bytes kept */
+	size_t cap;
+	size_t total;		/* bytes of a text in a report */
+	XML_Index start;	/* offset of a text in a document */
+};
+
+/*
+ * State of a single parse, passed to expat handlers as user data. Nothing
+ * is shared between parses, so reports are parsed on many threads at
+ * once.
+ */
+struct junit_parser {
+	XML_Parser parser;	/* NULL when a report is scanned */
+	struct arena *arena;	/* owner of a parsed report, NULL - the heap */
+	struct suiteq *suites;
+	tailq_suite *suite_item;	/* the innermost open suite */
+	/* suites that are open around suite_item, the outermost first */
+	tailq_suite **outer;
+	size_t n_outer;
+	size_t outer_size;
+	/*
+	 * An open testcase or the last one of a suite: errors that follow
+	 * a testcase, e.g. in reports of TAP::Harness, belong to it.
+	 */
+	tailq_test *test_item;
+	int test_open;			/* test_item is not yet in a suite */
+	struct junit_opts opts;
+	int spans;		/* offsets in a document are offsets in a file */
+	/* a text being read and where it goes, NULL - text is skipped */
+	const char **text;
+	struct text_span *span;
+	struct text_buf buf;
+	int failed;		/* out of memory, parsing is stopped */
+};
+
+/* elements of a report the parser looks at */
+enum junit_elem {
+	ELEM_OTHER,
+	ELEM_TESTSUITE,
+	ELEM_TESTCASE,
+	ELEM_ERROR,
+	ELEM_FAILURE,
+	ELEM_SKIPPED,
+	ELEM_SYSTEM_OUT,
+	ELEM_SYSTEM_ERR
+};
+
+enum junit_attr {
+	ATTR_NAME,
+	ATTR_HOSTNAME,
+	ATTR_ERRORS,
+	ATTR_FAILURES,
+	ATTR_TIME,
+	ATTR_TIMESTAMP,
+	ATTR_COMMENT,
+	ATTR_MAX		/* any other attribute */
+};
 
-tailq_test *test_item;
-tailq_suite *suite_item;
-struct suiteq *suites;
+/* a value of an attribute, not terminated, NULL when it is missing */
+struct attr_value {
+	const char *s;
+	size_t len;
+};
 
-int system_out_flag = 0;
-int system_err_flag = 0;
-int error_flag = 0;
+/* set once before reports are parsed, every parse takes a copy */
+static struct junit_opts junit_opts = { JUNIT_TEXT_LIMIT, 0, 0 };
 
-const XML_Char *
-name_to_value(const XML_Char ** attr, const char attr_name[])
+void
+junit_set_opts(const struct junit_opts *opts)
 {
-	XML_Char *attr_value = NULL;
-	int i;
-	for (i = 0; attr[i]; i += 2) {
-		if (strcmp(attr[i], attr_name) == 0) {
-			attr_value = calloc(strlen(attr[i + 1]) + 1, sizeof(XML_Char));
-			if (attr_value == NULL) {
-				perror("malloc failed");
-				return (char *) NULL;
-			}
-			strcpy(attr_value, attr[i + 1]);
-			break;
+	junit_opts = *opts;
+}
+
+void
+junit_get_opts(struct junit_opts *opts)
+{
+	*opts = junit_opts;
+}
+
+static enum junit_elem
+elem_id(const char *name, size_t len)
+{
+	switch (len) {
+	case 5:
+		if (memcmp(name, "error", 5) == 0)
+			return ELEM_ERROR;
+		break;
+	case 7:
+		if (memcmp(name, "failure", 7) == 0)
+			return ELEM_FAILURE;
+		if (memcmp(name, "skipped", 7) == 0)
+			return ELEM_SKIPPED;
+		break;
+	case 8:
+		if (memcmp(name, "testcase", 8) == 0)
+			return ELEM_TESTCASE;
+		break;
+	case 9:
+		if (memcmp(name, "testsuite", 9) == 0)
+			return ELEM_TESTSUITE;
+		break;
+	case 10:
+		if (memcmp(name, "system-out", 10) == 0)
+			return ELEM_SYSTEM_OUT;
+		if (memcmp(name, "system-err", 10) == 0)
+			return ELEM_SYSTEM_ERR;
+		break;
+	}
+
+	return ELEM_OTHER;
+}
+
+static enum junit_attr
+attr_id(const char *name, size_t len)
+{
+	switch (len) {
+	case 4:
+		if (memcmp(name, "name", 4) == 0)
+			return ATTR_NAME;
+		if (memcmp(name, "time", 4) == 0)
+			return ATTR_TIME;
+		break;
+	case 6:
+		if (memcmp(name, "errors", 6) == 0)
+			return ATTR_ERRORS;
+		break;
+	case 7:
+		if (memcmp(name, "comment", 7) == 0)
+			return ATTR_COMMENT;
+		break;
+	case 8:
+		if (memcmp(name, "failures", 8) == 0)
+			return ATTR_FAILURES;
+		if (memcmp(name, "hostname", 8) == 0)
+			return ATTR_HOSTNAME;
+		break;
+	case 9:
+		if (memcmp(name, "timestamp", 9) == 0)
+			return ATTR_TIMESTAMP;
+		break;
+	}
+
+	return ATTR_MAX;
+}
+
+static const char *
+attr_intern(const struct attr_value *attr)
+{
+	return intern_len(attr->s, attr->len);
+}
+
+static const char *
+attr_dup(struct junit_parser *ctx, const struct attr_value *attr)
+{
+	return arena_strndup(ctx->arena, attr->s, attr->len);
+}
+
+/* numeric attributes are converted on the stack, without an allocation */
+static double
+attr_number(const struct attr_value *attr)
+{
+	char buf[64];
+	char *s = buf;
+
+	if (attr->s == NULL) {
+		return 0;
+	}
+	if (attr->len >= sizeof(buf) && (s = malloc(attr->len + 1)) == NULL) {
+		return 0;
+	}
+	memcpy(s, attr->s, attr->len);
+	s[attr->len] = '\0';
+	double value = parse_seconds(s);
+	if (s != buf) {
+		free(s);
+	}
+
+	return value;
+}
+
+static void
+out_of_memory(struct junit_parser *ctx)
+{
+	perror("malloc failed");
+	ctx->failed = 1;
+	if (ctx->parser != NULL) {
+		XML_StopParser(ctx->parser, XML_FALSE);
+	}
+}
+
+/* room for need bytes, a buffer grows twice at a time but not above max */
+static int
+text_reserve(struct text_buf *b, size_t need, size_t max)
+{
+	if (need <= b->cap) {
+		return 0;
+	}
+	size_t cap = b->cap ? b->cap : TEXT_CHUNK;
+	while (cap < need) {
+		cap *= 2;
+	}
+	if (max != 0 && cap > max) {
+		cap = max;
+	}
+	char *data = realloc(b->data, cap);
+	if (data == NULL) {
+		return -1;
+	}
+	b->data = data;
+	b->cap = cap;
+
+	return 0;
+}
+
+/* a length of a text cut to len bytes without splitting a UTF-8 character */
+static size_t
+utf8_cut(const char *s, size_t len)
+{
+	size_t i = len;
+	while (i > 0 && ((unsigned char)s[i - 1] & 0xC0) == 0x80) {
+		i--;
+	}
+	if (i == 0) {
+		return len;
+	}
+	unsigned char lead = s[i - 1];
+	size_t n = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+
+	return i - 1 + n > len ? i - 1 : len;
+}
+
+static void
+text_begin(struct junit_parser *ctx, const char **text,
+	   struct text_span *span, XML_Index start)
+{
+	ctx->text = text;
+	ctx->span = span;
+	ctx->buf.len = 0;
+	ctx->buf.total = 0;
+	ctx->buf.start = start;
+}
+
+static void
+text_append(struct junit_parser *ctx, const char *txt, size_t len)
+{
+	struct text_buf *b = &ctx->buf;
+	size_t limit = ctx->opts.text_limit;
+
+	b->total += len;
+	if (limit != 0 && len > limit - b->len) {
+		len = limit - b->len;
+	}
+	if (len == 0) {
+		return;
+	}
+	if (text_reserve(b, b->len + len, limit) != 0) {
+		out_of_memory(ctx);
+		return;
+	}
+	memcpy(b->data + b->len, txt, len);
+	b->len += len;
+}
+
+/*
+ * A text longer than a limit is cut and marked, or only its span is kept
+ * when it can be read from a report file later.
+ */
+static void
+text_end(struct junit_parser *ctx, XML_Index end)
+{
+	struct text_buf *b = &ctx->buf;
+	if (ctx->text == NULL) {
+		return;
+	}
+	int truncated = b->total > b->len;
+	if (truncated && ctx->spans) {
+		ctx->span->offset = b->start;
+		ctx->span->len = end - b->start;
+	} else if (b->total != 0) {
+		char marker[64] = "";
+		size_t len = b->len;
+		if (truncated) {
+			len = utf8_cut(b->data, len);
+			snprintf(marker, sizeof(marker), "\n[%zu bytes truncated]",
+				 b->total - len);
+		}
+		size_t marker_len = strlen(marker);
+		char *s = arena_alloc(ctx->arena, len + marker_len + 1);
+		if (s == NULL) {
+			out_of_memory(ctx);
+			return;
+		}
+		memcpy(s, b->data, len);
+		memcpy(s + len, marker, marker_len + 1);
+		if (ctx->arena == NULL) {
+			free((char *)*ctx->text);
 		}
+		*ctx->text = s;
 	}
-	return attr_value;
+	ctx->text = NULL;
+	ctx->span = NULL;
 }
 
-static void XMLCALL
-start_handler(void *data, const XML_Char * elem, const XML_Char ** attr)
+/* a suite is nested in suite_item, which stays open around it */
+static int
+push_suite(struct junit_parser *ctx)
 {
-	(void) data;
-	if (strcmp(elem, "testsuite") == 0) {
-		suite_item = calloc(1, sizeof(tailq_suite));
+	if (ctx->n_outer == ctx->outer_size) {
+		size_t size = ctx->outer_size ? ctx->outer_size * 2 : 8;
+		tailq_suite **outer = realloc(ctx->outer, size * sizeof(*outer));
+		if (outer == NULL) {
+			return -1;
+		}
+		ctx->outer = outer;
+		ctx->outer_size = size;
+	}
+	ctx->outer[ctx->n_outer++] = ctx->suite_item;
+
+	return 0;
+}
+
+/* text of an element starts at text_start, right after its start tag */
+static void
+start_element(struct junit_parser *ctx, enum junit_elem elem,
+	      const struct attr_value attrs[], XML_Index text_start)
+{
+	tailq_suite *suite_item;
+	tailq_test *test_item = ctx->test_item;
+
+	if (elem == ELEM_TESTSUITE) {
+		if (ctx->suite_item != NULL && push_suite(ctx) != 0) {
+			out_of_memory(ctx);
+			return;
+		}
+		suite_item = arena_alloc(ctx->arena, sizeof(tailq_suite));
 		if (suite_item == NULL) {
-			perror("malloc failed");
-		}
-		suite_item->name = name_to_value(attr, "name");
-		suite_item->hostname = name_to_value(attr, "hostname");
-		suite_item->n_errors = atoi(name_to_value(attr, "errors"));
-		suite_item->n_failures = atoi(name_to_value(attr, "failures"));
-		suite_item->time = atof(name_to_value(attr, "time"));
-		suite_item->timestamp = name_to_value(attr, "timestamp");
-		suite_item->tests = calloc(1, sizeof(struct testq));
+			out_of_memory(ctx);
+			return;
+		}
+		/*
+		 * A suite goes to suites when it starts, so a suite with
+		 * suites nested in it comes before them and is not lost.
+		 */
+		TAILQ_INSERT_TAIL(ctx->suites, suite_item, entries);
+		ctx->suite_item = suite_item;
+		if (ctx->test_open) {
+			/* a suite inside a testcase, the testcase is dropped */
+			if (ctx->arena == NULL) {
+				free_test(test_item);
+			}
+			ctx->test_open = 0;
+		}
+		ctx->test_item = NULL;
+		suite_item->name = attr_intern(&attrs[ATTR_NAME]);
+		suite_item->hostname = attr_intern(&attrs[ATTR_HOSTNAME]);
+		suite_item->n_errors = attr_number(&attrs[ATTR_ERRORS]);
+		suite_item->n_failures = attr_number(&attrs[ATTR_FAILURES]);
+		suite_item->time = attr_number(&attrs[ATTR_TIME]);
+		suite_item->timestamp = attr_dup(ctx, &attrs[ATTR_TIMESTAMP]);
+		suite_item->started = parse_iso8601(suite_item->timestamp);
+		suite_item->tests = arena_alloc(ctx->arena, sizeof(struct testq));
 		if (suite_item->tests == NULL) {
-			perror("malloc failed");
+			out_of_memory(ctx);
+			return;
 		}
 		TAILQ_INIT(suite_item->tests);
-	} else if (strcmp(elem, "testcase") == 0) {
-		test_item = calloc(1, sizeof(tailq_test));
+	} else if (elem == ELEM_TESTCASE) {
+		test_item = arena_alloc(ctx->arena, sizeof(tailq_test));
 		if (test_item == NULL) {
-			perror("malloc failed");
-		};
-		test_item->name = name_to_value(attr, "name");
-		test_item->time = name_to_value(attr, "time");
+			out_of_memory(ctx);
+			return;
+		}
+		ctx->test_item = test_item;
+		ctx->test_open = 1;
+		test_item->name = attr_intern(&attrs[ATTR_NAME]);
+		test_item->time = attr_dup(ctx, &attrs[ATTR_TIME]);
+		test_item->duration = parse_seconds(test_item->time);
 		test_item->status = STATUS_PASS;
-	} else if (strcmp(elem, "error") == 0) {
-		error_flag = 1;
+	} else if (test_item == NULL) {
+		/* elements below belong to a testcase */
+		return;
+	} else if (elem == ELEM_ERROR) {
 		test_item->status = STATUS_ERROR;
-		test_item->comment = name_to_value(attr, "comment");
-	} else if (strcmp(elem, "failure") == 0) {
+		test_item->comment = attr_dup(ctx, &attrs[ATTR_COMMENT]);
+		text_begin(ctx, &test_item->error, &test_item->error_span,
+			   text_start);
+	} else if (elem == ELEM_FAILURE) {
 		test_item->status = STATUS_FAILURE;
-		test_item->comment = name_to_value(attr, "comment");
-	} else if (strcmp(elem, "skipped") == 0) {
+		test_item->comment = attr_dup(ctx, &attrs[ATTR_COMMENT]);
+		text_begin(ctx, &test_item->error, &test_item->error_span,
+			   text_start);
+	} else if (elem == ELEM_SKIPPED) {
 		test_item->status = STATUS_SKIPPED;
-		test_item->comment = name_to_value(attr, "comment");
-	} else if (strcmp(elem, "system-out") == 0) {
-		system_out_flag = 1;
-	} else if (strcmp(elem, "system-err") == 0) {
-		system_err_flag = 1;
+		test_item->comment = attr_dup(ctx, &attrs[ATTR_COMMENT]);
+	} else if (!ctx->test_open) {
+		/* output of a whole suite */
+		return;
+	} else if (elem == ELEM_SYSTEM_OUT) {
+		text_begin(ctx, &test_item->system_out,
+			   &test_item->system_out_span, text_start);
+	} else if (elem == ELEM_SYSTEM_ERR) {
+		text_begin(ctx, &test_item->system_err,
+			   &test_item->system_err_span, text_start);
 	}
 }
 
+/* text of an element ends at text_end, right before its end tag */
+static void
+end_element(struct junit_parser *ctx, enum junit_elem elem,
+	    XML_Index text_end_offset)
+{
+	if (elem == ELEM_TESTSUITE) {
+		/* TODO: check a number of failures and errors */
+		ctx->suite_item = NULL;
+		if (ctx->n_outer > 0) {
+			ctx->suite_item = ctx->outer[--ctx->n_outer];
+		}
+	} else if (elem == ELEM_TESTCASE) {
+		if (!ctx->test_open) {
+			return;
+		}
+		ctx->test_open = 0;
+		if (ctx->suite_item != NULL) {
+			TAILQ_INSERT_TAIL(ctx->suite_item->tests, ctx->test_item,
+					  entries);
+		} else {
+			/* a testcase outside of a testsuite */
+			if (ctx->arena == NULL) {
+				free_test(ctx->test_item);
+			}
+			ctx->test_item = NULL;
+		}
+	} else if (elem == ELEM_ERROR || elem == ELEM_FAILURE ||
+		   elem == ELEM_SYSTEM_OUT || elem == ELEM_SYSTEM_ERR) {
+		text_end(ctx, text_end_offset);
+	}
+}
+
+static void XMLCALL
+start_handler(void *data, const XML_Char * elem, const XML_Char ** attr)
+{
+	struct junit_parser *ctx = data;
+	struct attr_value attrs[ATTR_MAX];
+	int i;
+
+	memset(attrs, 0, sizeof(attrs));
+	for (i = 0; attr[i]; i += 2) {
+		enum junit_attr id = attr_id(attr[i], strlen(attr[i]));
+		if (id != ATTR_MAX) {
+			attrs[id].s = attr[i + 1];
+			attrs[id].len = strlen(attr[i + 1]);
+		}
+	}
+	start_element(ctx, elem_id(elem, strlen(elem)), attrs,
+		      XML_GetCurrentByteIndex(ctx->parser) +
+		      XML_GetCurrentByteCount(ctx->parser));
+}
+
 static void XMLCALL
 end_handler(void *data, const XML_Char * elem)
 {
-	(void) data;
-	(void) elem;
+	struct junit_parser *ctx = data;
 
-	if (strcmp(elem, "testsuite") == 0) {
-		/* TODO: check a number of failures and errors */
-		TAILQ_INSERT_TAIL(suites, suite_item, entries);
-	} else if (strcmp(elem, "testcase") == 0) {
-		TAILQ_INSERT_TAIL(suite_item->tests, test_item, entries);
-	} else if (strcmp(elem, "error") == 0) {
-		error_flag = 0;
-	} else if (strcmp(elem, "system-out") == 0) {
-		system_out_flag = 0;
-	} else if (strcmp(elem, "system-err") == 0) {
-		system_err_flag = 0;
+	end_element(ctx, elem_id(elem, strlen(elem)),
+		    XML_GetCurrentByteIndex(ctx->parser));
+}
+
+static void XMLCALL
+data_handler(void *data, const char *txt, int txtlen)
+{
+	struct junit_parser *ctx = data;
+
+	if (ctx->text != NULL) {
+		text_append(ctx, txt, txtlen);
 	}
 }
 
-void
-data_handler(void *data, const char *txt, int txtlen) {
-  (void)data;
-  
-  if (error_flag == 1) {
-     /* TODO */
-     test_item->error = (char*)NULL;
-  };
-  if (system_out_flag == 1) {
-     /* TODO */
-     test_item->system_out = (char*)NULL;
-  };
-  if (system_err_flag == 1) {
-     /* TODO */
-     test_item->system_err = (char*)NULL;
-  };
+/*
+ * The scanner below is a fast path for reports in memory. It knows only
+ * what JUnit reports are made of: elements, attributes, character and
+ * entity references, comments, processing instructions and CDATA
+ * sections. A DTD, an encoding other than UTF-8 or malformed markup make
+ * it give up, and a report is parsed with expat instead.
+ */
+enum scan_result {
+	SCAN_OK,
+	SCAN_FAILED,		/* out of memory */
+	SCAN_FALLBACK		/* a report needs expat */
+};
+
+struct open_elem {
+	const char *name;
+	size_t len;
+	enum junit_elem elem;
+};
+
+struct scanner {
+	struct junit_parser *ctx;
+	const char *base;	/* a document */
+	const char *end;
+	struct open_elem *stack;
+	size_t depth;
+	size_t cap;
+	struct text_buf values;	/* attribute values with references */
+};
+
+/*
+ * The first of bytes a, b and c in [p, end), or end. With SSE2 sixteen
+ * bytes are compared at a time, so long texts are skipped quickly.
+ */
+static const char *
+find3(const char *p, const char *end, char a, char b, char c)
+{
+#ifdef __SSE2__
+	const __m128i va = _mm_set1_epi8(a);
+	const __m128i vb = _mm_set1_epi8(b);
+	const __m128i vc = _mm_set1_epi8(c);
+	while (end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		__m128i eq = _mm_or_si128(_mm_cmpeq_epi8(v, va),
+			     _mm_or_si128(_mm_cmpeq_epi8(v, vb),
+					  _mm_cmpeq_epi8(v, vc)));
+		int mask = _mm_movemask_epi8(eq);
+		if (mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
+	}
+#endif
+	for (; p < end; p++) {
+		if (*p == a || *p == b || *p == c) {
+			return p;
+		}
+	}
+
+	return end;
 }
 
-struct suiteq *
-parse_junit(FILE * f)
+static int
+is_space(char c)
 {
-	XML_Parser p = XML_ParserCreate(NULL);
-	if (!p) {
-		fprintf(stderr, "Couldn't allocate memory for parser\n");
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* ASCII characters of names, bytes of UTF-8 sequences are not checked */
+static int
+is_name_char(char c)
+{
+	return (unsigned char)c >= 0x80 || (c >= 'a' && c <= 'z') ||
+	       (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+	       c == '-' || c == '_' || c == '.' || c == ':';
+}
+
+/* a name at p and a position after it, NULL when there is no name */
+static const char *
+skip_name(const char *p, const char *end)
+{
+	const char *name = p;
+	while (p < end && is_name_char(*p)) {
+		p++;
+	}
+	if (p == name || (*name >= '0' && *name <= '9') || *name == '-' ||
+	    *name == '.') {
 		return NULL;
 	}
-	suites = calloc(1, sizeof(struct suiteq));
-	if (suites == NULL) {
+
+	return p;
+}
+
+static const char *
+skip_spaces(const char *p, const char *end)
+{
+	while (p < end && is_space(*p)) {
+		p++;
+	}
+
+	return p;
+}
+
+static const char *
+find_str(const char *p, const char *end, const char *s)
+{
+	size_t len = strlen(s);
+	while ((p = memchr(p, s[0], end - p)) != NULL) {
+		if ((size_t)(end - p) < len) {
+			return NULL;
+		}
+		if (memcmp(p, s, len) == 0) {
+			return p;
+		}
+		p++;
+	}
+
+	return NULL;
+}
+
+static int
+has_prefix(const char *p, const char *end, const char *s)
+{
+	size_t len = strlen(s);
+
+	return (size_t)(end - p) >= len && memcmp(p, s, len) == 0;
+}
+
+/* a code point as UTF-8, a number of bytes */
+static int
+utf8_encode(unsigned long c, char out[4])
+{
+	if (c < 0x80) {
+		out[0] = c;
+		return 1;
+	} else if (c < 0x800) {
+		out[0] = 0xC0 | c >> 6;
+		out[1] = 0x80 | (c & 0x3F);
+		return 2;
+	} else if (c < 0x10000) {
+		out[0] = 0xE0 | c >> 12;
+		out[1] = 0x80 | (c >> 6 & 0x3F);
+		out[2] = 0x80 | (c & 0x3F);
+		return 3;
+	}
+	out[0] = 0xF0 | c >> 18;
+	out[1] = 0x80 | (c >> 12 & 0x3F);
+	out[2] = 0x80 | (c >> 6 & 0x3F);
+	out[3] = 0x80 | (c & 0x3F);
+
+	return 4;
+}
+
+/*
+ * A reference at p, right after '&', to out. Returns a number of bytes
+ * and moves p after ';', or -1 for an unknown or malformed reference.
+ */
+static int
+decode_reference(const char **p, const char *end, char out[4])
+{
+	const char *s = *p;
+	const char *semi = memchr(s, ';', end - s > 16 ? 16 : end - s);
+	if (semi == NULL) {
+		return -1;
+	}
+	*p = semi + 1;
+	size_t len = semi - s;
+	if (len == 0) {
+		return -1;
+	} else if (s[0] != '#') {
+		if (len == 2 && memcmp(s, "lt", 2) == 0) {
+			out[0] = '<';
+		} else if (len == 2 && memcmp(s, "gt", 2) == 0) {
+			out[0] = '>';
+		} else if (len == 3 && memcmp(s, "amp", 3) == 0) {
+			out[0] = '&';
+		} else if (len == 4 && memcmp(s, "apos", 4) == 0) {
+			out[0] = '\'';
+		} else if (len == 4 && memcmp(s, "quot", 4) == 0) {
+			out[0] = '"';
+		} else {
+			return -1;
+		}
+		return 1;
+	}
+
+	unsigned long c = 0;
+	int base = 10;
+	s++;
+	if (s < semi && *s == 'x') {
+		base = 16;
+		s++;
+	}
+	if (s == semi) {
+		return -1;
+	}
+	for (; s < semi; s++) {
+		unsigned int d = (unsigned char)*s - '0';
+		if (base == 16 && d >= 10) {
+			d = ((unsigned char)*s | 0x20) - 'a';
+			d = d < 6 ? d + 10 : 16;
+		}
+		if (d >= (unsigned int)base || c > 0x10FFFF) {
+			return -1;
+		}
+		c = c * base + d;
+	}
+	/* characters that are not allowed in XML */
+	if (c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF) ||
+	    c == 0xFFFE || c == 0xFFFF ||
+	    (c < 0x20 && c != '\t' && c != '\n' && c != '\r')) {
+		return -1;
+	}
+
+	return utf8_encode(c, out);
+}
+
+/* raw text, e.g. of a CDATA section, with line ends as in a text */
+static void
+scan_raw_text(struct junit_parser *ctx, const char *p, const char *end)
+{
+	while (p < end) {
+		const char *cr = memchr(p, '\r', end - p);
+		if (cr == NULL) {
+			text_append(ctx, p, end - p);
+			return;
+		}
+		text_append(ctx, p, cr - p);
+		text_append(ctx, "\n", 1);
+		p = cr + 1;
+		if (p < end && *p == '\n') {
+			p++;
+		}
+	}
+}
+
+/*
+ * A value of an attribute with references resolved and white space
+ * replaced by spaces, to out that is large enough. Returns a length or
+ * -1 on a malformed reference.
+ */
+static int
+decode_value(const char *p, const char *end, char *out)
+{
+	char *o = out;
+	while (p < end) {
+		if (*p == '&') {
+			p++;
+			int n = decode_reference(&p, end, o);
+			if (n < 0) {
+				return -1;
+			}
+			o += n;
+		} else if (*p == '\r') {
+			*o++ = ' ';
+			p++;
+			if (p < end && *p == '\n') {
+				p++;
+			}
+		} else if (*p == '\t' || *p == '\n') {
+			*o++ = ' ';
+			p++;
+		} else {
+			*o++ = *p++;
+		}
+	}
+
+	return o - out;
+}
+
+static int
+valid_references(const char *p, const char *end)
+{
+	char out[4];
+	while ((p = memchr(p, '&', end - p)) != NULL) {
+		p++;
+		if (decode_reference(&p, end, out) < 0) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int
+stack_push(struct scanner *s, const char *name, size_t len,
+	   enum junit_elem elem)
+{
+	if (s->depth == s->cap) {
+		size_t cap = s->cap ? s->cap * 2 : STACK_CHUNK;
+		struct open_elem *stack = realloc(s->stack, cap * sizeof(*stack));
+		if (stack == NULL) {
+			out_of_memory(s->ctx);
+			return -1;
+		}
+		s->stack = stack;
+		s->cap = cap;
+	}
+	s->stack[s->depth].name = name;
+	s->stack[s->depth].len = len;
+	s->stack[s->depth].elem = elem;
+	s->depth++;
+
+	return 0;
+}
+
+/* a start tag at p, right after '<'; a position after it or NULL */
+static const char *
+scan_start_tag(struct scanner *s, const char *p)
+{
+	const char *end = s->end;
+	const char *name = p;
+	if ((p = skip_name(p, end)) == NULL) {
+		return NULL;
+	}
+	size_t name_len = p - name;
+
+	struct attr_value attrs[ATTR_MAX];
+	int decode[ATTR_MAX];
+	size_t decoded_len = 0;
+	int self_closing = 0;
+	memset(attrs, 0, sizeof(attrs));
+	memset(decode, 0, sizeof(decode));
+	for (;;) {
+		const char *attr_start = p;
+		p = skip_spaces(p, end);
+		if (p == end) {
+			return NULL;
+		} else if (*p == '>') {
+			p++;
+			break;
+		} else if (*p == '/') {
+			if (p + 1 == end || p[1] != '>') {
+				return NULL;
+			}
+			self_closing = 1;
+			p += 2;
+			break;
+		} else if (p == attr_start) {
+			/* attributes are separated by white space */
+			return NULL;
+		}
+		const char *attr_name = p;
+		if ((p = skip_name(p, end)) == NULL) {
+			return NULL;
+		}
+		size_t attr_len = p - attr_name;
+		p = skip_spaces(p, end);
+		if (p == end || *p != '=') {
+			return NULL;
+		}
+		p = skip_spaces(p + 1, end);
+		if (p == end || (*p != '"' && *p != '\'')) {
+			return NULL;
+		}
+		const char *value = p + 1;
+		const char *quote = memchr(value, *p, end - value);
+		if (quote == NULL) {
+			return NULL;
+		}
+		int references = 0;
+		for (p = value; p < quote; p++) {
+			if (*p == '<' || ((unsigned char)*p < 0x20 && !is_space(*p))) {
+				return NULL;
+			}
+			references |= *p == '&' || *p == '\t' || *p == '\n' ||
+				      *p == '\r';
+		}
+		p = quote + 1;
+		enum junit_attr id = attr_id(attr_name, attr_len);
+		if (id == ATTR_MAX) {
+			if (references && !valid_references(value, quote)) {
+				return NULL;
+			}
+			continue;
+		}
+		if (attrs[id].s != NULL) {
+			/* a duplicate attribute is an error */
+			return NULL;
+		}
+		attrs[id].s = value;
+		attrs[id].len = quote - value;
+		decode[id] = references;
+		decoded_len += references ? quote - value : 0;
+	}
+
+	/* values with references, they are never longer than in a document */
+	if (decoded_len != 0) {
+		if (text_reserve(&s->values, decoded_len, 0) != 0) {
+			out_of_memory(s->ctx);
+			return NULL;
+		}
+		char *out = s->values.data;
+		int i;
+		for (i = 0; i < ATTR_MAX; i++) {
+			if (!decode[i]) {
+				continue;
+			}
+			int len = decode_value(attrs[i].s, attrs[i].s + attrs[i].len,
+					       out);
+			if (len < 0) {
+				return NULL;
+			}
+			attrs[i].s = out;
+			attrs[i].len = len;
+			out += len;
+		}
+	}
+
+	enum junit_elem elem = elem_id(name, name_len);
+	if (!self_closing && stack_push(s, name, name_len, elem) != 0) {
+		return NULL;
+	}
+	start_element(s->ctx, elem, attrs, p - s->base);
+	if (self_closing) {
+		end_element(s->ctx, elem, p - s->base);
+	}
+
+	return p;
+}
+
+/* an end tag at p, right after "</"; a position after it or NULL */
+static const char *
+scan_end_tag(struct scanner *s, const char *p, const char *tag)
+{
+	const char *name = p;
+	if ((p = skip_name(p, s->end)) == NULL) {
+		return NULL;
+	}
+	size_t name_len = p - name;
+	p = skip_spaces(p, s->end);
+	if (p == s->end || *p != '>' || s->depth == 0) {
+		return NULL;
+	}
+	struct open_elem *open = &s->stack[s->depth - 1];
+	if (open->len != name_len || memcmp(open->name, name, name_len) != 0) {
+		return NULL;
+	}
+	s->depth--;
+	end_element(s->ctx, open->elem, tag - s->base);
+
+	return p + 1;
+}
+
+/* an XML declaration with an encoding other than UTF-8 needs expat */
+static int
+is_utf8_decl(const char *p, const char *end)
+{
+	const char *enc = find_str(p, end, "encoding");
+	if (enc == NULL) {
+		return 1;
+	}
+	p = skip_spaces(enc + strlen("encoding"), end);
+	if (p == end || *p != '=') {
+		return 0;
+	}
+	p = skip_spaces(p + 1, end);
+	if (p == end || (*p != '"' && *p != '\'')) {
+		return 0;
+	}
+	const char *value = p + 1;
+	const char *quote = memchr(value, *p, end - value);
+	if (quote == NULL) {
+		return 0;
+	}
+
+	return (quote - value == 5 && strncasecmp(value, "utf-8", 5) == 0) ||
+	       (quote - value == 8 && strncasecmp(value, "us-ascii", 8) == 0);
+}
+
+static enum scan_result
+scan_document(struct scanner *s)
+{
+	struct junit_parser *ctx = s->ctx;
+	const char *p = s->base, *end = s->end;
+	int root_seen = 0;
+
+	if (has_prefix(p, end, "\xEF\xBB\xBF")) {
+		p += 3;
+	} else if (end - p >= 2 && (p[0] == '\0' || p[1] == '\0' ||
+		   (unsigned char)p[0] >= 0xFE)) {
+		/* UTF-16 */
+		return SCAN_FALLBACK;
+	}
+
+	while (p < end) {
+		const char *next;
+		if (ctx->text != NULL) {
+			next = find3(p, end, '<', '&', '\r');
+			text_append(ctx, p, next - p);
+		} else {
+			next = find3(p, end, '<', '&', '<');
+			if (s->depth == 0 && skip_spaces(p, next) != next) {
+				/* text outside of a root element */
+				return SCAN_FALLBACK;
+			}
+		}
+		p = next;
+		if (p == end) {
+			break;
+		}
+		if (*p == '&') {
+			char out[4];
+			p++;
+			int n = decode_reference(&p, end, out);
+			if (n < 0) {
+				return SCAN_FALLBACK;
+			}
+			if (ctx->text != NULL) {
+				text_append(ctx, out, n);
+			}
+		} else if (*p == '\r') {
+			text_append(ctx, "\n", 1);
+			p++;
+			if (p < end && *p == '\n') {
+				p++;
+			}
+		} else if (has_prefix(p, end, "</")) {
+			p = scan_end_tag(s, p + 2, p);
+		} else if (has_prefix(p, end, "<?")) {
+			const char *pi_end = find_str(p, end, "?>");
+			if (pi_end == NULL ||
+			    (has_prefix(p, end, "<?xml") && is_space(p[5]) &&
+			     !is_utf8_decl(p, pi_end))) {
+				return SCAN_FALLBACK;
+			}
+			p = pi_end + 2;
+		} else if (has_prefix(p, end, "<!--")) {
+			const char *comment_end = find_str(p + 4, end, "-->");
+			p = comment_end != NULL ? comment_end + 3 : NULL;
+		} else if (has_prefix(p, end, "<![CDATA[")) {
+			const char *cdata_end = find_str(p + 9, end, "]]>");
+			if (cdata_end == NULL || s->depth == 0) {
+				return SCAN_FALLBACK;
+			}
+			if (ctx->text != NULL) {
+				scan_raw_text(ctx, p + 9, cdata_end);
+			}
+			p = cdata_end + 3;
+		} else if (has_prefix(p, end, "<!")) {
+			/* a document type declaration */
+			return SCAN_FALLBACK;
+		} else if (s->depth == 0 && root_seen) {
+			/* a second root element */
+			return SCAN_FALLBACK;
+		} else {
+			root_seen = 1;
+			p = scan_start_tag(s, p + 1);
+		}
+		if (ctx->failed) {
+			return SCAN_FAILED;
+		}
+		if (p == NULL) {
+			return SCAN_FALLBACK;
+		}
+	}
+	if (!root_seen || s->depth != 0) {
+		return SCAN_FALLBACK;
+	}
+
+	return SCAN_OK;
+}
+
+static enum scan_result
+scan_junit(struct junit_parser *ctx, const char *data, size_t len)
+{
+	struct scanner s;
+	memset(&s, 0, sizeof(s));
+	s.ctx = ctx;
+	s.base = data;
+	s.end = data + len;
+
+	enum scan_result rc = scan_document(&s);
+	free(s.stack);
+	free(s.values.data);
+
+	return rc;
+}
+
+static int
+parser_init(struct junit_parser *ctx, struct arena *arena, int spans)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->arena = arena;
+	ctx->opts = junit_opts;
+	ctx->spans = spans && ctx->opts.text_spans;
+	ctx->suites = arena_alloc(arena, sizeof(struct suiteq));
+	if (ctx->suites == NULL) {
 		perror("malloc failed");
+		return -1;
+	}
+	TAILQ_INIT(ctx->suites);
+
+	return 0;
+}
+
+static int
+parser_create(struct junit_parser *ctx)
+{
+	ctx->parser = XML_ParserCreate(NULL);
+	if (!ctx->parser) {
+		fprintf(stderr, "Couldn't allocate memory for parser\n");
+		if (ctx->arena == NULL) {
+			free(ctx->suites);
+		}
+		return -1;
 	}
-	TAILQ_INIT(suites);
+	XML_SetUserData(ctx->parser, ctx);
+	XML_SetElementHandler(ctx->parser, start_handler, end_handler);
+	XML_SetCharacterDataHandler(ctx->parser, data_handler);
 
-	XML_UseParserAsHandlerArg(p);
-	XML_SetElementHandler(p, start_handler, end_handler);
-	XML_SetCharacterDataHandler(p, data_handler);
+	return 0;
+}
+
+static int
+parser_feed(struct junit_parser *ctx, const char *data, int len, int done)
+{
+	if (XML_Parse(ctx->parser, data, len, done) != XML_STATUS_ERROR &&
+	    !ctx->failed) {
+		return 0;
+	}
+	if (!ctx->failed) {
+		fprintf(stderr,
+		    "Parse error at line %" XML_FMT_INT_MOD "u:\n%" XML_FMT_STR "\n",
+		    XML_GetCurrentLineNumber(ctx->parser),
+		    XML_ErrorString(XML_GetErrorCode(ctx->parser)));
+	}
+
+	return -1;
+}
 
+/* suites of a parsed report or NULL when parsing has failed */
+static struct suiteq *
+parser_finish(struct junit_parser *ctx, int failed)
+{
+	if (ctx->parser != NULL) {
+		XML_ParserFree(ctx->parser);
+	}
+	free(ctx->buf.data);
+	free(ctx->outer);
+	if (!failed) {
+		return ctx->suites;
+	}
+	/* items of an arena are released with the arena by a caller */
+	if (ctx->arena == NULL) {
+		if (ctx->test_open) {
+			free_test(ctx->test_item);
+		}
+		free_suites(ctx->suites);
+		free(ctx->suites);
+	}
+
+	return NULL;
+}
+
+struct suiteq *
+parse_junit(FILE * f)
+{
+	return parse_junit_r(f, NULL);
+}
+
+/*
+ * Reentrant parser of a JUnit report. Suites, tests and their strings are
+ * allocated from an arena, or from the heap when it is NULL. NULL is
+ * returned on a read or parse error.
+ */
+struct suiteq *
+parse_junit_r(FILE * f, struct arena *arena)
+{
+	struct junit_parser ctx;
+	char buf[BUFFSIZE];
+	/* a stream may be decompressed, its offsets are not offsets in a file */
+	if (parser_init(&ctx, arena, 0) != 0 || parser_create(&ctx) != 0) {
+		return NULL;
+	}
+
+	int failed = 0;
 	for (;;) {
 		int len, done;
 		len = fread(buf, 1, BUFFSIZE, f);
 		if (ferror(f)) {
 			fprintf(stderr, "Read error\n");
-			exit(-1);
+			failed = 1;
+			break;
 		}
 		done = feof(f);
 
-		if (XML_Parse(p, buf, len, done) == XML_STATUS_ERROR) {
-			fprintf(stderr,
-			    "Parse error at line %" XML_FMT_INT_MOD "u:\n%" XML_FMT_STR "\n",
-			    XML_GetCurrentLineNumber(p),
-			    XML_ErrorString(XML_GetErrorCode(p)));
-			free(test_item);
-			free(suite_item);
-			free_suites(suites);
-			exit(-1);
+		if (parser_feed(&ctx, buf, len, done) != 0) {
+			failed = 1;
+			break;
 		}
 		if (done) {
 			break;
 		}
 	}
-	XML_ParserFree(p);
 
-	return suites;
+	return parser_finish(&ctx, failed);
+}
+
+/*
+ * Parse a report that is already in memory, e.g. mapped. A report is
+ * scanned first and given to expat only when the scanner gives up; items
+ * left in an arena by the scanner are released with the arena. A document
+ * is passed to expat in chunks to keep the size of its internal buffer
+ * low. A buffer is a whole report file, so long texts may be left in it
+ * as spans.
+ */
+struct suiteq *
+parse_junit_buffer(const char *data, size_t len, struct arena *arena)
+{
+	struct junit_parser ctx;
+	if (parser_init(&ctx, arena, 1) != 0) {
+		return NULL;
+	}
+	if (!ctx.opts.use_expat) {
+		enum scan_result rc = scan_junit(&ctx, data, len);
+		if (rc != SCAN_FALLBACK) {
+			return parser_finish(&ctx, rc != SCAN_OK);
+		}
+		parser_finish(&ctx, 1);
+		if (parser_init(&ctx, arena, 1) != 0) {
+			return NULL;
+		}
+	}
+	if (parser_create(&ctx) != 0) {
+		return NULL;
+	}
+
+	int failed = 0;
+	do {
+		int n = len > CHUNKSIZE ? CHUNKSIZE : len;
+		len -= n;
+		if (parser_feed(&ctx, data, n, len == 0) != 0) {
+			failed = 1;
+			break;
+		}
+		data += n;
+	} while (len > 0);
+
+	return parser_finish(&ctx, failed);
+}
+
+static void XMLCALL
+span_data_handler(void *data, const char *txt, int txtlen)
+{
+	struct text_buf *b = data;
+
+	if (b->data == NULL && b->cap != 0) {
+		return;		/* out of memory */
+	}
+	if (text_reserve(b, b->len + txtlen + 1, 0) != 0) {
+		free(b->data);
+		b->data = NULL;
+		return;
+	}
+	memcpy(b->data + b->len, txt, txtlen);
+	b->len += txtlen;
+}
+
+/*
+ * Text of a test left in a report file. A raw text is parsed once again
+ * to resolve entities and CDATA sections. Returns a string to free or
+ * NULL on error.
+ */
+char *
+junit_read_span(const char *path, const struct text_span *span)
+{
+	static const char open_tag[] = "<text>", close_tag[] = "</text>";
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		perror("fopen");
+		return NULL;
+	}
+	if (fseeko(f, span->offset, SEEK_SET) != 0) {
+		perror("fseeko");
+		fclose(f);
+		return NULL;
+	}
+	XML_Parser parser = XML_ParserCreate(NULL);
+	if (parser == NULL) {
+		fprintf(stderr, "Couldn't allocate memory for parser\n");
+		fclose(f);
+		return NULL;
+	}
+	struct text_buf b;
+	memset(&b, 0, sizeof(b));
+	XML_SetUserData(parser, &b);
+	XML_SetCharacterDataHandler(parser, span_data_handler);
+
+	int failed = XML_Parse(parser, open_tag, strlen(open_tag), 0) ==
+		     XML_STATUS_ERROR;
+	char buf[BUFFSIZE];
+	size_t left = span->len;
+	while (!failed && left > 0) {
+		size_t n = fread(buf, 1, left < BUFFSIZE ? left : BUFFSIZE, f);
+		if (n == 0) {
+			fprintf(stderr, "Read error\n");
+			failed = 1;
+			break;
+		}
+		left -= n;
+		failed = XML_Parse(parser, buf, n, 0) == XML_STATUS_ERROR;
+	}
+	if (!failed) {
+		failed = XML_Parse(parser, close_tag, strlen(close_tag), 1) ==
+			 XML_STATUS_ERROR;
+	}
+	XML_ParserFree(parser);
+	fclose(f);
+	if (!failed && text_reserve(&b, b.len + 1, 0) != 0) {
+		failed = 1;
+	}
+	if (failed || b.data == NULL) {
+		free(b.data);
+		return NULL;
+	}
+	b.data[b.len] = '\0';
+
+	return b.data;
+}
+
+/*
+ * Text of a test or, when only its span is kept, the text read from a
+ * report file into *copy, which is to be freed. NULL when there is none.
+ */
+const char *
+junit_text(const char *path, const char *text, const struct text_span *span,
+	   char **copy)
+{
+	*copy = NULL;
+	if (text != NULL || span->len == 0 || path == NULL) {
+		return text;
+	}
+	*copy = junit_read_span(path, span);
+
+	return *copy;
 }
@@ -33,6 +33,24 @@
 
 #include "parse_common.h"
 
+/* default limit of a text of a test, bytes */
+#define JUNIT_TEXT_LIMIT	(64 * 1024)
+
+struct junit_opts {
+	size_t text_limit;	/* bytes kept of a text of a test, 0 - no limit */
+	int text_spans;		/* keep longer texts as spans of a report file */
+	int use_expat;		/* parse reports in memory with expat too */
+};
+
+void junit_set_opts(const struct junit_opts *opts);
+void junit_get_opts(struct junit_opts *opts);
+char *junit_read_span(const char *path, const struct text_span *span);
+const char *junit_text(const char *path, const char *text,
+		       const struct text_span *span, char **copy);
+
 struct suiteq *parse_junit(FILE *f);
+struct suiteq *parse_junit_r(FILE *f, struct arena *arena);
+struct suiteq *parse_junit_buffer(const char *data, size_t len,
+				  struct arena *arena);
 
 #endif				/* PARSE_JUNIT_H */
@@ -26,16 +26,66 @@
  *
  */
 
-#include <assert.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <fcntl.h>
-#include <time.h>
+#include <strings.h>
 
+#include "arena.h"
+#include "intern.h"
 #include "parse_subunit_v1.h"
 
+/*
+ * https://github.com/testing-cabal/subunit/blob/master/README.rst
+ *
+ * A stream is split into lines in place, a line is a directive and its
+ * argument, e.g. "success: test_add". An outcome may be followed by
+ * details in brackets: lines of text or parts of a multipart MIME
+ * document, every part is a Content-Type line, a name line and chunks
+ * of content, each prefixed with its size in hex.
+ */
+
+#define BUFFSIZE	(64 * 1024)
+
+enum details {
+	DETAILS_NONE,
+	DETAILS_BRACKETED,	/* lines up to "]" */
+	DETAILS_MULTIPART	/* parts up to "]" */
+};
+
+enum part_state {
+	PART_TYPE,
+	PART_NAME,
+	PART_CHUNK_SIZE,
+	PART_CHUNK
+};
+
+/* a text that is being collected, e.g. details of a test */
+struct text {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+struct subunit_v1_parser {
+	struct arena *arena;	/* owner of a parsed report, NULL - the heap */
+	tailq_suite *suite;
+	double clock_now;	/* the last "time:" directive */
+	double test_started;	/* a time when the current test started */
+	enum details details;
+	enum part_state part;
+	size_t chunk_left;	/* bytes of a chunk that are not read yet */
+	tailq_test *test;	/* a test details belong to */
+	const char **field;	/* a field of the test details go to */
+	struct text text;
+	int failed;		/* out of memory or a read error */
+	test_result_cb on_test;	/* a live stream, see stream.h */
+	void *arg;
+	struct text name;	/* a name of the reported test */
+};
+
 const char *
 directive_string(enum directive dir) {
 
@@ -60,211 +110,489 @@ directive_string(enum directive dir) {
 		return "DIR_TAGS";
 	case DIR_TIME:
 		return "DIR_TIME";
-	default:
-		return "DIR_UNKNOWN";
-	}
-}
-
-enum directive
-resolve_directive(char * string) {
-
-	assert(string != (char*)NULL);
-
-	if ((strcasecmp(string, "test") == 0) ||
-	    (strcasecmp(string, "testing") == 0) ||
-	    (strcasecmp(string, "test:") == 0) ||
-	    (strcasecmp(string, "testing:") == 0)) {
-		return DIR_TEST;
-	} else if ((strcasecmp(string, "success") == 0) ||
-		   (strcasecmp(string, "success:") == 0) ||
-		   (strcasecmp(string, "successful") == 0) ||
-		   (strcasecmp(string, "successful:") == 0)) {
-		return DIR_SUCCESS;
-	} else if (strcasecmp(string, "failure:") == 0) {
-		return DIR_FAILURE;
-	} else if (strcasecmp(string, "error:") == 0) {
-		return DIR_ERROR;
-	} else if ((strcasecmp(string, "skip") == 0) ||
-		   (strcasecmp(string, "skip:") == 0)) {
-		return DIR_SKIP;
-	} else if ((strcasecmp(string, "xfail") == 0) ||
-		   (strcasecmp(string, "xfail:") == 0)) {
-		return DIR_XFAIL;
-	} else if ((strcasecmp(string, "uxsuccess") == 0) ||
-		   (strcasecmp(string, "uxsuccess:") == 0)) {
-		return DIR_UXSUCCESS;
-	} else if (strcasecmp(string, "progress:") == 0) {
-		return DIR_PROGRESS;
-	} else if (strcasecmp(string, "tags:") == 0) {
-		return DIR_TAGS;
-	} else if (strcasecmp(string, "time:") == 0) {
-		return DIR_TIME;
-	} else {
-		/* unknown directive */
+	case DIR_UNKNOWN:
+		break;
 	}
 
-	return DIR_TEST;
+	return "DIR_UNKNOWN";
 }
 
-struct tm* parse_iso8601_time(char* date_str, char* time_str) {
-	assert(date_str != (char*)NULL);
-	assert(time_str != (char*)NULL);
+static const struct {
+	const char *word;
+	size_t len;
+	enum directive dir;
+} directives[] = {
+	{ "test", 4, DIR_TEST },
+	{ "testing", 7, DIR_TEST },
+	{ "success", 7, DIR_SUCCESS },
+	{ "successful", 10, DIR_SUCCESS },
+	{ "failure", 7, DIR_FAILURE },
+	{ "error", 5, DIR_ERROR },
+	{ "skip", 4, DIR_SKIP },
+	{ "xfail", 5, DIR_XFAIL },
+	{ "uxsuccess", 9, DIR_UXSUCCESS },
+	{ "progress", 8, DIR_PROGRESS },
+	{ "tags", 4, DIR_TAGS },
+	{ "time", 4, DIR_TIME }
+};
 
-	struct tm * t;
-	t = malloc(sizeof(struct tm));
-	if (t == NULL) {
-		perror("failed to malloc");
-		return NULL;
+/*
+ * Strings are compared only with directives of the same length and the
+ * same first letter. A colon after a directive is optional.
+ */
+enum directive
+resolve_directive(const char *s, size_t len)
+{
+	if (len > 0 && s[len - 1] == ':') {
+		len--;
 	}
-	if (sscanf(date_str, "%d-%d-%d", &t->tm_year, &t->tm_mon, &t->tm_mday) == 3) {
-		assert(t->tm_year > 2000);
-		assert((t->tm_mon <= 12) && (t->tm_mon >= 0));
-		assert((t->tm_mday <= 31) && (t->tm_mday >= 0));
+	if (len == 0) {
+		return DIR_UNKNOWN;
 	}
 
-	if (sscanf(time_str, "%d:%d:%dZ", &t->tm_hour, &t->tm_min, &t->tm_sec) == 3) {
-		assert((t->tm_hour <= 23) && (t->tm_hour >= 0));
-		assert((t->tm_min <= 60) && (t->tm_min >= 0));
-		assert((t->tm_sec <= 60) && (t->tm_sec >= 0));
+	int c = tolower((unsigned char)s[0]);
+	size_t i;
+	for (i = 0; i < sizeof(directives) / sizeof(directives[0]); i++) {
+		if (directives[i].len == len && directives[i].word[0] == c &&
+		    strncasecmp(s, directives[i].word, len) == 0) {
+			return directives[i].dir;
+		}
 	}
 
-	return t;
+	return DIR_UNKNOWN;
 }
 
-void read_tok() {
-	char* token = (char*)NULL;
-	while (token != NULL) { token = strtok(NULL, " \t"); };
-}
-
-tailq_test* read_test() {
-
-	tailq_test *test_item = NULL;
-	test_item = calloc(1, sizeof(tailq_test));
-	if (test_item == NULL) {
-		perror("failed to malloc");
-		return NULL;
-	}
-
-	char *token, *name;
-	token = strtok(NULL, " \t");
-	if (strcmp(token, "test") == 0) {
-	   token = strtok(NULL, " \t");
-	   assert(token != NULL);
+static int
+text_append(struct text *text, const char *data, size_t len)
+{
+	if (text->len + len > text->size) {
+		size_t size = text->size ? text->size : 256;
+		while (size < text->len + len) {
+			size *= 2;
+		}
+		char *p = realloc(text->data, size);
+		if (p == NULL) {
+			perror("malloc failed");
+			return -1;
+		}
+		text->data = p;
+		text->size = size;
 	}
-	name = (char*)calloc(strlen(token) + 1, sizeof(char));
-	strcpy(name, token);
-	test_item->name = name;
-
-	read_tok();
+	memcpy(text->data + text->len, data, len);
+	text->len += len;
 
-	return test_item;
+	return 0;
 }
 
-tailq_test* parse_line_subunit_v1(char* string) {
+/* collected text goes to a field of a test */
+static void
+store_text(struct subunit_v1_parser *ctx)
+{
+	if (ctx->text.len != 0 && ctx->field != NULL &&
+	    test_append_text(ctx->arena, ctx->field, ctx->text.data,
+			     ctx->text.len) != 0) {
+		ctx->failed = 1;
+	}
+	ctx->text.len = 0;
+}
 
-	assert(string != (char*)NULL);
+static int
+ends_with(const char *s, size_t len, const char *suffix, size_t n)
+{
+	return len >= n && memcmp(s + len - n, suffix, n) == 0;
+}
 
-	char *dir;
-	char buffer[1024];
-	strcpy(buffer, string);
-	dir = strtok(buffer, " \t");
+static void
+add_test(struct subunit_v1_parser *ctx, enum directive dir,
+	 const char *label, size_t len)
+{
+	enum details details = DETAILS_NONE;
+	if (ends_with(label, len, " [", 2)) {
+		details = DETAILS_BRACKETED;
+		len -= 2;
+	} else if (ends_with(label, len, " [ multipart", 12)) {
+		details = DETAILS_MULTIPART;
+		len -= 12;
+	}
 
-	tailq_test *test_item = NULL;
-	enum directive d;
-	switch (d = resolve_directive(dir)) {
-	case DIR_TEST:
-		/* testline is useless, but we should check conformance to spec */
-		read_tok();
-		break;
+	/* a test of a live stream is reported and forgotten */
+	tailq_test live_item;
+	tailq_test *test_item;
+	const char *name;
+	if (ctx->on_test != NULL) {
+		memset(&live_item, 0, sizeof(live_item));
+		test_item = &live_item;
+		ctx->name.len = 0;
+		if (text_append(&ctx->name, label, len) != 0 ||
+		    text_append(&ctx->name, "", 1) != 0) {
+			ctx->failed = 1;
+			return;
+		}
+		name = ctx->name.data;
+	} else {
+		test_item = arena_alloc(ctx->arena, sizeof(tailq_test));
+		name = intern_len(label, len);
+		if (test_item == NULL || name == NULL) {
+			perror("malloc failed");
+			if (ctx->arena == NULL) {
+				free(test_item);
+			}
+			ctx->failed = 1;
+			return;
+		}
+	}
+	test_item->name = name;
+	switch (dir) {
 	case DIR_SUCCESS:
-		test_item = read_test();
 		test_item->status = STATUS_SUCCESS;
 		break;
 	case DIR_FAILURE:
-		test_item = read_test();
 		test_item->status = STATUS_FAILURE;
 		break;
 	case DIR_ERROR:
-		test_item = read_test();
 		test_item->status = STATUS_FAILED;
 		break;
 	case DIR_SKIP:
-		test_item = read_test();
 		test_item->status = STATUS_SKIPPED;
 		break;
 	case DIR_XFAIL:
-		test_item = read_test();
 		test_item->status = STATUS_XFAILURE;
 		break;
 	case DIR_UXSUCCESS:
-		test_item = read_test();
 		test_item->status = STATUS_UXSUCCESS;
 		break;
+	case DIR_TEST:
 	case DIR_PROGRESS:
-		/* testline is useless, but we should check conformance to spec */
-		read_tok();
+	case DIR_TAGS:
+	case DIR_TIME:
+	case DIR_UNKNOWN:
+		break;
+	}
+
+	/* a test lasts from its "test:" till its outcome */
+	if (ctx->test_started > 0 && ctx->clock_now >= ctx->test_started) {
+		test_item->duration = ctx->clock_now - ctx->test_started;
+	}
+	ctx->test_started = 0;
+	ctx->details = details;
+	ctx->part = PART_TYPE;
+	if (ctx->on_test != NULL) {
+		/* details of a live test are skipped */
+		ctx->on_test(test_item, ctx->arg);
+		ctx->test = NULL;
+		ctx->field = NULL;
+		return;
+	}
+
+	TAILQ_INSERT_TAIL(ctx->suite->tests, test_item, entries);
+	ctx->test = test_item;
+	if (dir == DIR_FAILURE || dir == DIR_ERROR) {
+		ctx->field = &test_item->error;
+	} else {
+		ctx->field = &test_item->comment;
+	}
+}
+
+static void
+parse_directive(struct subunit_v1_parser *ctx, const char *line, size_t len)
+{
+	const char *end = line + len;
+	const char *p = line;
+	while (p < end && *p != ' ' && *p != '\t') {
+		p++;
+	}
+	enum directive dir = resolve_directive(line, p - line);
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+
+	switch (dir) {
+	case DIR_TEST:
+		ctx->test_started = ctx->clock_now;
 		break;
+	case DIR_SUCCESS:
+	case DIR_FAILURE:
+	case DIR_ERROR:
+	case DIR_SKIP:
+	case DIR_XFAIL:
+	case DIR_UXSUCCESS:
+		add_test(ctx, dir, p, end - p);
+		break;
+	case DIR_TIME: {
+		/* a stamp is copied, a line is not terminated */
+		char stamp[64];
+		size_t n = (size_t)(end - p) < sizeof(stamp) ? (size_t)(end - p) :
+			   sizeof(stamp) - 1;
+		memcpy(stamp, p, n);
+		stamp[n] = '\0';
+		ctx->clock_now = parse_iso8601(stamp);
+		break;
+	}
+	case DIR_PROGRESS:
 	case DIR_TAGS:
-		/* testline is useless, but we should check conformance to spec */
-		read_tok();
+	case DIR_UNKNOWN:
 		break;
-	case DIR_TIME:
-		/* testline is useless, but we should check conformance to spec */
-		/*
-		char *date = strtok(NULL, " \t");
-		assert(date != (char*)NULL);
-		char *time = strtok(NULL, " \t");
-		assert(time != (char*)NULL);
-		struct tm *t = parse_iso8601_time(date, time);
-		printf("Time: %s\n", asctime(t));
-		*/
-
-		read_tok();
+	}
+}
+
+/* a line of multipart details, a chunk of content is read elsewhere */
+static void
+parse_part_line(struct subunit_v1_parser *ctx, const char *line, size_t len)
+{
+	switch (ctx->part) {
+	case PART_TYPE:
+		/* "Content-Type: text/plain;charset=utf8" */
+		ctx->part = PART_NAME;
 		break;
-	default:
-		read_tok();
-		return NULL;
+	case PART_NAME:
+		ctx->field = ctx->test != NULL ?
+			     test_attachment(ctx->test, line, len) : NULL;
+		ctx->part = PART_CHUNK_SIZE;
+		break;
+	case PART_CHUNK_SIZE: {
+		size_t size = 0, i;
+		for (i = 0; i < len && isxdigit((unsigned char)line[i]); i++) {
+			size = size * 16 + (isdigit((unsigned char)line[i]) ?
+			    line[i] - '0' : tolower((unsigned char)line[i]) - 'a' + 10);
+		}
+		if (i == 0 || i != len) {
+			/* not a chunk, the rest are plain lines */
+			ctx->details = DETAILS_NONE;
+			break;
+		}
+		if (size == 0) {
+			store_text(ctx);
+			ctx->part = PART_TYPE;
+		} else {
+			ctx->chunk_left = size;
+			ctx->part = PART_CHUNK;
+		}
+		break;
+	}
+	case PART_CHUNK:
+		break;
+	}
+}
+
+static void
+parse_line(struct subunit_v1_parser *ctx, const char *line, size_t len)
+{
+	size_t n = len;
+	if (n > 0 && line[n - 1] == '\n') {
+		n--;
+	}
+	if (n > 0 && line[n - 1] == '\r') {
+		n--;
+	}
+	if (ctx->details != DETAILS_NONE && n == 1 && line[0] == ']') {
+		store_text(ctx);
+		ctx->details = DETAILS_NONE;
+		return;
 	}
 
-	return test_item;
+	switch (ctx->details) {
+	case DETAILS_BRACKETED:
+		if (ctx->field != NULL &&
+		    text_append(&ctx->text, line, len) != 0) {
+			ctx->failed = 1;
+		}
+		break;
+	case DETAILS_MULTIPART:
+		parse_part_line(ctx, line, n);
+		break;
+	case DETAILS_NONE:
+		parse_directive(ctx, line, n);
+		break;
+	}
 }
 
-struct suiteq* parse_subunit_v1(FILE *stream) {
+/*
+ * Lines of a buffer, returns a number of bytes used. An incomplete line
+ * at the end is left for the next call unless a stream is over.
+ */
+static size_t
+parse_lines(struct subunit_v1_parser *ctx, const char *data, size_t len,
+	    int eof)
+{
+	size_t pos = 0;
+	while (pos < len && !ctx->failed) {
+		if (ctx->details == DETAILS_MULTIPART &&
+		    ctx->part == PART_CHUNK) {
+			size_t n = len - pos < ctx->chunk_left ? len - pos :
+				   ctx->chunk_left;
+			if (ctx->field != NULL &&
+			    text_append(&ctx->text, data + pos, n) != 0) {
+				ctx->failed = 1;
+				break;
+			}
+			pos += n;
+			ctx->chunk_left -= n;
+			if (ctx->chunk_left == 0) {
+				ctx->part = PART_CHUNK_SIZE;
+			}
+			continue;
+		}
+
+		const char *nl = memchr(data + pos, '\n', len - pos);
+		if (nl == NULL && !eof) {
+			break;
+		}
+		size_t n = nl ? (size_t)(nl - data) + 1 - pos : len - pos;
+		parse_line(ctx, data + pos, n);
+		pos += n;
+	}
+
+	return pos;
+}
+
+static int
+parser_init(struct subunit_v1_parser *ctx, struct arena *arena)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->arena = arena;
 
 	tailq_suite *suite_item;
-	suite_item = calloc(1, sizeof(tailq_suite));
+	suite_item = arena_alloc(arena, sizeof(tailq_suite));
 	if (suite_item == NULL) {
 		perror("malloc failed");
-		return NULL;
+		return -1;
 	}
 	/* TODO: n_errors, n_failures */
-	suite_item->tests = calloc(1, sizeof(struct testq));
+	suite_item->tests = arena_alloc(arena, sizeof(struct testq));
 	if (suite_item->tests == NULL) {
 		perror("malloc failed");
-		free(suite_item);
-		return NULL;
-	};
+		if (arena == NULL) {
+			free(suite_item);
+		}
+		return -1;
+	}
 	TAILQ_INIT(suite_item->tests);
+	ctx->suite = suite_item;
 
-    	char line[1024];
-	tailq_test *test_item = NULL;
-    	while (fgets(line, sizeof(line), stream)) {
-		test_item = parse_line_subunit_v1(line);
-		if (test_item != NULL) {
-		   TAILQ_INSERT_TAIL(suite_item->tests, test_item, entries);
-		}
-		if (feof(stream)) {
-			break;
-		}
-    	}
+	return 0;
+}
+
+static struct suiteq *
+parser_finish(struct subunit_v1_parser *ctx)
+{
+	/* details of the last test are cut by the end of a stream */
+	store_text(ctx);
+	free(ctx->text.data);
 
 	struct suiteq *suites = NULL;
-	suites = calloc(1, sizeof(struct suiteq));
+	if (!ctx->failed) {
+		suites = arena_alloc(ctx->arena, sizeof(struct suiteq));
+		if (suites == NULL) {
+			perror("malloc failed");
+		}
+	}
 	if (suites == NULL) {
-		perror("malloc failed");
-	};
+		if (ctx->arena == NULL) {
+			free_suite(ctx->suite);
+		}
+		return NULL;
+	}
 	TAILQ_INIT(suites);
-	TAILQ_INSERT_TAIL(suites, suite_item, entries);
+	TAILQ_INSERT_TAIL(suites, ctx->suite, entries);
 
 	return suites;
 }
+
+struct suiteq* parse_subunit_v1(FILE *stream) {
+
+	return parse_subunit_v1_arena(stream, NULL);
+}
+
+/*
+ * A stream is read into a buffer that holds at least one line, a buffer
+ * grows when a line is longer than it.
+ */
+struct suiteq* parse_subunit_v1_arena(FILE *stream, struct arena *arena) {
+
+	struct subunit_v1_parser ctx;
+	if (parser_init(&ctx, arena) != 0) {
+		return NULL;
+	}
+
+	size_t size = BUFFSIZE, len = 0;
+	char *buf = malloc(size);
+	if (buf == NULL) {
+		perror("malloc failed");
+		ctx.failed = 1;
+	}
+	int eof = 0;
+	while (!ctx.failed && !eof) {
+		size_t n = fread(buf + len, 1, size - len, stream);
+		if (ferror(stream)) {
+			fprintf(stderr, "Read error\n");
+			ctx.failed = 1;
+			break;
+		}
+		len += n;
+		eof = n == 0 || feof(stream);
+		size_t used = parse_lines(&ctx, buf, len, eof);
+		memmove(buf, buf + used, len - used);
+		len -= used;
+		if (len == size) {
+			/* a line is longer than a buffer */
+			char *larger = realloc(buf, size * 2);
+			if (larger == NULL) {
+				perror("malloc failed");
+				ctx.failed = 1;
+				break;
+			}
+			buf = larger;
+			size *= 2;
+		}
+	}
+	free(buf);
+
+	return parser_finish(&ctx);
+}
+
+/* a stream that is already in memory, e.g. mapped */
+struct suiteq* parse_subunit_v1_buffer(const char *data, size_t len,
+				       struct arena *arena) {
+
+	struct subunit_v1_parser ctx;
+	if (parser_init(&ctx, arena) != 0) {
+		return NULL;
+	}
+	parse_lines(&ctx, data, len, 1);
+
+	return parser_finish(&ctx);
+}
+
+/*
+ * A live stream, e.g. a pipe. Every finished test is passed to a callback
+ * and forgotten, so memory does not grow with a number of tests.
+ */
+struct subunit_v1_parser *subunit_v1_stream_new(test_result_cb cb, void *arg) {
+
+	struct subunit_v1_parser *ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	ctx->on_test = cb;
+	ctx->arg = arg;
+
+	return ctx;
+}
+
+/* complete lines of data, returns a number of bytes used */
+size_t subunit_v1_stream_parse(struct subunit_v1_parser *ctx,
+			       const char *data, size_t len, int eof) {
+
+	return parse_lines(ctx, data, len, eof);
+}
+
+void subunit_v1_stream_free(struct subunit_v1_parser *ctx) {
+
+	if (ctx == NULL) {
+		return;
+	}
+	free(ctx->text.data);
+	free(ctx->name.data);
+	free(ctx);
+}
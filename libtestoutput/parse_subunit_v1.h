@@ -41,15 +41,21 @@ enum directive {
 	DIR_UXSUCCESS,
 	DIR_PROGRESS,
 	DIR_TAGS,
-	DIR_TIME
+	DIR_TIME,
+	DIR_UNKNOWN
 };
 
-tailq_test* parse_line_subunit_v1(char* string);
 struct suiteq* parse_subunit_v1(FILE* stream);
-struct tm* parse_iso8601_time(char* date_str, char* time_str);
-enum directive resolve_directive(char* string);
+struct suiteq* parse_subunit_v1_arena(FILE* stream, struct arena *arena);
+struct suiteq* parse_subunit_v1_buffer(const char *data, size_t len,
+				       struct arena *arena);
+
+struct subunit_v1_parser;
+struct subunit_v1_parser *subunit_v1_stream_new(test_result_cb cb, void *arg);
+size_t subunit_v1_stream_parse(struct subunit_v1_parser *ctx,
+			       const char *data, size_t len, int eof);
+void subunit_v1_stream_free(struct subunit_v1_parser *ctx);
+enum directive resolve_directive(const char *s, size_t len);
 const char* directive_string(enum directive dir);
-void read_tok();
-tailq_test* read_test();
 
 #endif				/* PARSE_SUBUNIT_V1_H */
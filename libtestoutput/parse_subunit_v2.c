@@ -26,21 +26,80 @@
  *
  */
 
-#include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
-#include <arpa/inet.h>
 #include <zlib.h>
 
+#include "arena.h"
+#include "hashmap.h"
+#include "intern.h"
 #include "parse_subunit_v2.h"
+#include "worker_pool.h"
 
 // https://github.com/testing-cabal/subunit/blob/master/python/subunit/v2.py#L412
 // https://github.com/testing-cabal/subunit
 
-#define HI(x)  ((x) >> 8)
-#define LO(x)  ((x) & 0xFF)
+#define BUFFSIZE	(64 * 1024)
+
+#define BE32(p)	((uint32_t)(p)[0] << 24 | (uint32_t)(p)[1] << 16 | \
+		 (uint32_t)(p)[2] << 8 | (uint32_t)(p)[3])
+
+/* statuses of packets, the rest map to STATUS_UNDEFINED and below */
+enum packet_status {
+	PACKET_UNDEFINED,
+	PACKET_ENUMERATION,
+	PACKET_INPROGRESS
+};
+
+/* what a packet changes in a test */
+struct test_event {
+	struct test_event *next;
+	double timestamp;
+	uint16_t flags;
+	uint32_t file_name_len;
+	uint32_t content_len;
+	const char *file_name;
+	const uint8_t *content;
+};
+
+/* a test and a time it was started at */
+struct test_state {
+	tailq_test *test;
+	double started;
+};
+
+/*
+ * State of a parse. A test is reported in several packets, e.g. when it
+ * is started, for every attachment and when it is finished, so tests
+ * are looked up by their ids.
+ */
+struct subunit_v2_parser {
+	struct arena *arena;	/* owner of a parsed report, NULL - the heap */
+	struct arena *scratch;	/* states of tests, freed after a parse */
+	struct hashmap *tests;	/* test_state by an interned test id */
+	tailq_suite *suite;
+	double first;		/* the earliest and the latest timestamps */
+	double last;
+	size_t n_corrupt;	/* runs of bytes that are not packets */
+	int skipping;		/* inside such a run */
+	int failed;		/* out of memory or a read error */
+	test_result_cb on_test;	/* a live stream, see stream.h */
+	void *arg;
+	char *name;		/* a name of the reported test */
+	size_t name_size;
+};
+
+/*
+ * A started test of a live stream. Finished tests are not kept, so the
+ * map holds only tests that are in progress.
+ */
+struct live_test {
+	double started;
+	char id[];
+};
 
 int is_subunit_v2(char* path)
 {
@@ -65,205 +124,885 @@ int is_subunit_v2(char* path)
 	}
 }
 
-uint32_t read_field(FILE * stream)
+int is_subunit_v2_buffer(const char *data, size_t len)
 {
+	if (len == 0) {
+		return -1;
+	}
+	if ((uint8_t)data[0] == SUBUNIT_SIGNATURE) {
+		return 0;
+	} else {
+		return 1;
+	}
+}
 
-	uint32_t field_value = 0;
-	uint8_t byte = 0, byte0 = 0;
-	uint16_t buf = 0;
-	uint8_t prefix = 0;
+/*
+ * A number of one to four bytes, big endian. The two high bits of the
+ * first byte are a number of bytes that follow it. -1 when a buffer ends
+ * before a number.
+ */
+static int
+read_number(const uint8_t **p, const uint8_t *end, uint32_t *value)
+{
+	if (*p >= end) {
+		return -1;
+	}
+	size_t n = **p >> 6;
+	if ((size_t)(end - *p) <= n) {
+		return -1;
+	}
+	uint32_t v = **p & 0x3F;
+	size_t i;
+	for (i = 1; i <= n; i++) {
+		v = v << 8 | (*p)[i];
+	}
+	*p += n + 1;
+	*value = v;
 
-	int n_bytes = 0;
+	return 0;
+}
 
-	n_bytes = fread(&byte, 1, 1, stream);
-	if (n_bytes == 0) {
+static int
+read_string(const uint8_t **p, const uint8_t *end, const char **s,
+	    uint32_t *len)
+{
+	if (read_number(p, end, len) != 0 || (size_t)(end - *p) < *len) {
+		return -1;
+	}
+	*s = (const char *)*p;
+	*p += *len;
+
+	return 0;
+}
+
+/* a number from a stream, 0 on a read error */
+uint32_t read_field(FILE * stream)
+{
+	uint8_t buf[4];
+	if (fread(buf, 1, 1, stream) != 1) {
 		return 0;
 	}
-	prefix = byte >> 6;
-	byte0 = byte & 0x3f;
-	if (prefix == 0x00) {
-		field_value = byte0;
-	} else if (prefix == 0x40) {
-		n_bytes = fread(&byte, 1, 1, stream);
-		if (n_bytes == 0) {
-			return 0;
-		}
-		field_value = (byte0 << 8) | byte;
-	} else if (prefix == 0x80) {
-		n_bytes = fread(&buf, 2, 1, stream);
-		if (n_bytes == 0) {
-			return 0;
-		}
-		field_value = (byte << 16) | buf;
-	} else {
-		n_bytes = fread(&buf, 1, 2, stream);
-		if (n_bytes == 0) {
-			return 0;
-		}
-		field_value = (byte0 << 24) | buf << 8;
+	size_t n = buf[0] >> 6;
+	if (n > 0 && fread(buf + 1, 1, n, stream) != n) {
+		return 0;
+	}
+	const uint8_t *p = buf;
+	uint32_t value = 0;
+	read_number(&p, buf + n + 1, &value);
 
-		n_bytes = fread(&byte, 1, 1, stream);
-		if (n_bytes == 0) {
-			return 0;
+	return value;
+}
+
+/*
+ * Decode a packet at the start of a buffer. Returns a length of the
+ * packet, 0 when a buffer ends before the packet does or -1 when it is
+ * not a valid packet, e.g. its CRC32 does not match.
+ */
+int
+subunit_v2_decode(const uint8_t *data, size_t len,
+		  struct subunit_packet *packet)
+{
+	if (len < 4) {
+		return 0;
+	}
+	if (data[0] != SUBUNIT_SIGNATURE) {
+		return -1;
+	}
+	uint16_t flags = data[1] << 8 | data[2];
+	if (flags >> 12 != SUBUNIT_VERSION) {
+		return -1;
+	}
+	const uint8_t *p = data + 3;
+	uint32_t length;
+	if (read_number(&p, data + len, &length) != 0) {
+		return 0;
+	}
+	if (length < PACKET_MIN_LENGTH || length > PACKET_MAX_LENGTH ||
+	    length < (size_t)(p - data) + 4) {
+		return -1;
+	}
+	if (len < length) {
+		return 0;
+	}
+	const uint8_t *end = data + length - 4;
+	if (crc32(0, data, length - 4) != BE32(end)) {
+		return -1;
+	}
+
+	memset(packet, 0, sizeof(*packet));
+	packet->flags = flags;
+	if (flags & FLAG_TIMESTAMP) {
+		uint32_t nsec;
+		if (end - p < 4) {
+			return -1;
+		}
+		uint32_t sec = BE32(p);
+		p += 4;
+		if (read_number(&p, end, &nsec) != 0) {
+			return -1;
+		}
+		packet->timestamp = sec + nsec / 1e9;
+	}
+	if ((flags & FLAG_TEST_ID) &&
+	    read_string(&p, end, &packet->test_id, &packet->test_id_len) != 0) {
+		return -1;
+	}
+	if (flags & FLAG_TAGS) {
+		if (read_number(&p, end, &packet->n_tags) != 0) {
+			return -1;
 		}
-		field_value = field_value | byte;
-	};
+		packet->tags = p;
+		uint32_t i;
+		for (i = 0; i < packet->n_tags; i++) {
+			const char *tag;
+			uint32_t tag_len;
+			if (read_string(&p, end, &tag, &tag_len) != 0) {
+				return -1;
+			}
+		}
+	}
+	if ((flags & FLAG_MIME_TYPE) &&
+	    read_string(&p, end, &packet->mime_type,
+			&packet->mime_type_len) != 0) {
+		return -1;
+	}
+	if (flags & FLAG_FILE_CONTENT) {
+		const char *content;
+		if (read_string(&p, end, &packet->file_name,
+				&packet->file_name_len) != 0 ||
+		    read_string(&p, end, &content, &packet->content_len) != 0) {
+			return -1;
+		}
+		packet->content = (const uint8_t *)content;
+	}
+	if ((flags & FLAG_ROUTE_CODE) &&
+	    read_string(&p, end, &packet->route_code,
+			&packet->route_code_len) != 0) {
+		return -1;
+	}
+	if (p != end) {
+		return -1;
+	}
 
-	return field_value;
+	return length;
 }
 
-struct suiteq *
-parse_subunit_v2(FILE * stream)
+static tailq_suite *
+new_suite(struct arena *arena)
 {
 	tailq_suite *suite_item;
-	suite_item = calloc(1, sizeof(tailq_suite));
+	suite_item = arena_alloc(arena, sizeof(tailq_suite));
 	if (suite_item == NULL) {
 		perror("malloc failed");
 		return NULL;
 	}
 
-	suite_item->tests = calloc(1, sizeof(struct testq));
+	suite_item->tests = arena_alloc(arena, sizeof(struct testq));
 	if (suite_item->tests == NULL) {
 		perror("malloc failed");
-		free_suite(suite_item);
+		if (arena == NULL) {
+			free_suite(suite_item);
+		}
 		return NULL;
 	}
-
 	TAILQ_INIT(suite_item->tests);
-	tailq_test *test_item = NULL;
 
-	test_item = read_subunit_v2_packet(stream);
-	if (test_item != NULL)
-		TAILQ_INSERT_TAIL(suite_item->tests, test_item, entries);
-
-	/*
-	while (!feof(stream)) {
-		test_item = read_packet(stream);
-		if (test_item != NULL)
-			TAILQ_INSERT_TAIL(suite_item->tests, test_item, entries);
-		else
-		{
-			free_tests(suite_item->tests);
-			free_suite(suite_item);
-			return NULL;
+	return suite_item;
+}
+
+static int
+parser_init(struct subunit_v2_parser *ctx, struct arena *arena)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->arena = arena;
+	ctx->scratch = arena_new();
+	ctx->tests = hashmap_new(0);
+	ctx->suite = new_suite(arena);
+	if (ctx->scratch == NULL || ctx->tests == NULL || ctx->suite == NULL) {
+		if (ctx->scratch == NULL || ctx->tests == NULL) {
+			perror("malloc failed");
+		}
+		arena_free(ctx->scratch);
+		hashmap_free(ctx->tests);
+		if (arena == NULL && ctx->suite != NULL) {
+			free_suite(ctx->suite);
+		}
+		return -1;
+	}
+
+	return 0;
+}
+
+/* a new test at the end of a suite */
+static struct test_state *
+add_test(struct subunit_v2_parser *ctx, const char *name)
+{
+	struct test_state *state = arena_alloc(ctx->scratch, sizeof(*state));
+	tailq_test *test_item = arena_alloc(ctx->arena, sizeof(tailq_test));
+	if (name == NULL || state == NULL || test_item == NULL) {
+		perror("malloc failed");
+		if (ctx->arena == NULL) {
+			free(test_item);
+		}
+		return NULL;
+	}
+	test_item->name = name;
+	test_item->status = STATUS_UNDEFINED;
+	TAILQ_INSERT_TAIL(ctx->suite->tests, test_item, entries);
+	state->test = test_item;
+	state->started = 0;
+
+	return state;
+}
+
+static struct test_state *
+find_test(struct subunit_v2_parser *ctx, const char *id, uint32_t len)
+{
+	struct test_state *state = hashmap_get(ctx->tests, id, len);
+	if (state != NULL) {
+		return state;
+	}
+
+	const char *name = intern_len(id, len);
+	state = add_test(ctx, name);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (hashmap_put(ctx->tests, name, len, state) != 0) {
+		perror("malloc failed");
+		return NULL;
+	}
+
+	return state;
+}
+
+/* the earliest and the latest timestamps of a stream */
+static void
+note_time(double *first, double *last, double now)
+{
+	if (now > 0) {
+		if (*first <= 0 || now < *first) {
+			*first = now;
+		}
+		if (now > *last) {
+			*last = now;
+		}
+	}
+}
+
+/* a packet does nothing to a test but adds it */
+static int
+is_noop(const struct subunit_packet *packet)
+{
+	return (packet->flags & FLAG_STATUS_MASK) == PACKET_UNDEFINED &&
+	       (!(packet->flags & FLAG_FILE_CONTENT) || packet->content_len == 0);
+}
+
+static void
+event_from_packet(struct test_event *event,
+		  const struct subunit_packet *packet)
+{
+	event->next = NULL;
+	event->timestamp = packet->timestamp;
+	event->flags = packet->flags;
+	event->file_name = packet->file_name;
+	event->file_name_len = packet->file_name_len;
+	event->content = packet->content;
+	event->content_len = packet->content_len;
+}
+
+static void
+apply_event(struct subunit_v2_parser *ctx, struct test_state *state,
+	    const struct test_event *event)
+{
+	double now = event->timestamp;
+	tailq_test *test_item = state->test;
+	int status = event->flags & FLAG_STATUS_MASK;
+	switch (status) {
+	case PACKET_UNDEFINED:
+		/* tags or attachments */
+		break;
+	case PACKET_ENUMERATION:
+		if (test_item->status == STATUS_UNDEFINED) {
+			test_item->status = STATUS_ENUMERATION;
+		}
+		break;
+	case PACKET_INPROGRESS:
+		test_item->status = STATUS_INPROGRESS;
+		state->started = now;
+		break;
+	default:
+		/* a test lasts from its "inprogress" till its outcome */
+		test_item->status = STATUS_UNDEFINED + status;
+		if (state->started > 0 && now >= state->started) {
+			test_item->duration = now - state->started;
+		}
+		break;
+	}
+	if ((event->flags & FLAG_FILE_CONTENT) && event->content_len != 0 &&
+	    test_append_text(ctx->arena,
+			     test_attachment(test_item, event->file_name,
+					     event->file_name_len),
+			     (const char *)event->content,
+			     event->content_len) != 0) {
+		ctx->failed = 1;
+	}
+}
+
+/* an outcome of a test of a live stream goes to a callback */
+static void
+report_test(struct subunit_v2_parser *ctx,
+	    const struct subunit_packet *packet, double started)
+{
+	uint32_t len = packet->test_id_len;
+	if (len + 1 > ctx->name_size) {
+		char *name = realloc(ctx->name, len + 1);
+		if (name == NULL) {
+			perror("malloc failed");
+			ctx->failed = 1;
+			return;
+		}
+		ctx->name = name;
+		ctx->name_size = len + 1;
+	}
+	memcpy(ctx->name, packet->test_id, len);
+	ctx->name[len] = '\0';
+
+	tailq_test test_item;
+	memset(&test_item, 0, sizeof(test_item));
+	test_item.name = ctx->name;
+	test_item.status = STATUS_UNDEFINED +
+			   (packet->flags & FLAG_STATUS_MASK);
+	if (started > 0 && packet->timestamp >= started) {
+		test_item.duration = packet->timestamp - started;
+	}
+	ctx->on_test(&test_item, ctx->arg);
+}
+
+/* tags, attachments and enumerations of a live stream are skipped */
+static void
+stream_packet(struct subunit_v2_parser *ctx,
+	      const struct subunit_packet *packet)
+{
+	int status = packet->flags & FLAG_STATUS_MASK;
+	if (status == PACKET_UNDEFINED || status == PACKET_ENUMERATION) {
+		return;
+	}
+
+	uint32_t len = packet->test_id_len;
+	struct live_test *live = hashmap_get(ctx->tests, packet->test_id, len);
+	if (status == PACKET_INPROGRESS) {
+		if (live == NULL) {
+			live = malloc(sizeof(*live) + len);
+			if (live == NULL) {
+				perror("malloc failed");
+				ctx->failed = 1;
+				return;
+			}
+			memcpy(live->id, packet->test_id, len);
+			if (hashmap_put(ctx->tests, live->id, len, live) != 0) {
+				free(live);
+				ctx->failed = 1;
+				return;
+			}
+		}
+		live->started = packet->timestamp;
+		return;
+	}
+
+	double started = 0;
+	if (live != NULL) {
+		started = live->started;
+		hashmap_remove(ctx->tests, live->id, len);
+		free(live);
+	}
+	report_test(ctx, packet, started);
+}
+
+static void
+apply_packet(struct subunit_v2_parser *ctx,
+	     const struct subunit_packet *packet)
+{
+	note_time(&ctx->first, &ctx->last, packet->timestamp);
+	if (packet->test_id == NULL) {
+		/* e.g. output of a whole run */
+		return;
+	}
+	if (ctx->on_test != NULL) {
+		stream_packet(ctx, packet);
+		return;
+	}
+
+	struct test_state *state;
+	state = find_test(ctx, packet->test_id, packet->test_id_len);
+	if (state == NULL) {
+		ctx->failed = 1;
+		return;
+	}
+	if (!is_noop(packet)) {
+		struct test_event event;
+		event_from_packet(&event, packet);
+		apply_event(ctx, state, &event);
+	}
+}
+
+/*
+ * Packets of a buffer, returns a number of bytes used. An incomplete
+ * packet at the end is left for the next call unless a stream is over.
+ * Bytes that are not packets are skipped up to the next signature.
+ */
+static size_t
+decode_packets(struct subunit_v2_parser *ctx, const uint8_t *data,
+	       size_t len, int eof)
+{
+	size_t pos = 0;
+	while (pos < len && !ctx->failed) {
+		struct subunit_packet packet;
+		int n = subunit_v2_decode(data + pos, len - pos, &packet);
+		if (n > 0) {
+			apply_packet(ctx, &packet);
+			ctx->skipping = 0;
+			pos += n;
+			continue;
+		}
+		if (n == 0 && !eof) {
+			break;
+		}
+		if (!ctx->skipping) {
+			ctx->n_corrupt++;
+			ctx->skipping = 1;
 		}
+		const uint8_t *next = memchr(data + pos + 1, SUBUNIT_SIGNATURE,
+					     len - pos - 1);
+		pos = next != NULL ? (size_t)(next - data) : len;
 	}
-	*/
+
+	return pos;
+}
+
+static struct suiteq *
+parser_finish(struct subunit_v2_parser *ctx)
+{
+	if (ctx->n_corrupt != 0) {
+		fprintf(stderr, "Skipped %zu corrupted parts of a subunit stream\n",
+			ctx->n_corrupt);
+	}
+	hashmap_free(ctx->tests);
+	arena_free(ctx->scratch);
 
 	struct suiteq *suites = NULL;
-	suites = calloc(1, sizeof(struct suiteq));
+	if (!ctx->failed) {
+		suites = arena_alloc(ctx->arena, sizeof(struct suiteq));
+		if (suites == NULL) {
+			perror("malloc failed");
+		}
+	}
 	if (suites == NULL) {
-		perror("malloc failed");
-		free_suite(suite_item);
+		if (ctx->arena == NULL) {
+			free_suite(ctx->suite);
+		}
+		return NULL;
 	}
+	ctx->suite->started = ctx->first;
+	ctx->suite->time = ctx->last - ctx->first;
 	TAILQ_INIT(suites);
-	TAILQ_INSERT_TAIL(suites, suite_item, entries);
+	TAILQ_INSERT_TAIL(suites, ctx->suite, entries);
 
 	return suites;
 }
 
-tailq_test *
-read_subunit_v2_packet(FILE * stream)
+/*
+ * A large stream in memory is decoded by several threads. A length of a
+ * packet follows its header, so a stream is cut into chunks on packet
+ * boundaries without decoding packets. Every chunk is decoded by its own
+ * thread that groups changes of tests by test id, then chunks are merged
+ * in order. Changes of a test are applied in the same order as by
+ * decode_packets() and tests do not depend on each other, so the result
+ * is the same. A stream with a corrupted packet is decoded sequentially.
+ */
+
+#define PARALLEL_MIN_SIZE	(16 * 1024 * 1024)
+
+static int subunit_v2_jobs = 1;
+
+/* changes of a test in a chunk */
+struct chunk_test {
+	struct chunk_test *next;	/* in order of first packets */
+	const char *name;	/* interned */
+	uint32_t len;		/* of a name */
+	struct test_event *events;
+	struct test_event **tail;
+};
+
+struct chunk {
+	const uint8_t *data;
+	size_t len;
+	struct arena *scratch;	/* tests and events */
+	struct hashmap *tests;	/* chunk_test by a test id */
+	struct chunk_test *first_test;
+	struct chunk_test **tail;
+	double first;
+	double last;
+	int corrupt;
+	int failed;
+	pthread_t thread;
+	int threaded;
+};
+
+void
+subunit_v2_set_jobs(int jobs)
 {
-	subunit_header header;
-	int n_bytes = 0;
-	n_bytes = fread(&header, sizeof(subunit_header), 1, stream);
-	if ((n_bytes == 0) || (n_bytes < (int)sizeof(subunit_header))) {
-		return NULL;
+	subunit_v2_jobs = jobs;
+}
+
+static int
+chunk_packet(struct chunk *chunk, const struct subunit_packet *packet)
+{
+	note_time(&chunk->first, &chunk->last, packet->timestamp);
+	if (packet->test_id == NULL) {
+		return 0;
 	}
-	tailq_test *test_item;
-	test_item = calloc(1, sizeof(tailq_test));
-	if (test_item == NULL) {
+
+	struct chunk_test *test;
+	test = hashmap_get(chunk->tests, packet->test_id, packet->test_id_len);
+	if (test == NULL) {
+		test = arena_alloc(chunk->scratch, sizeof(*test));
+		if (test == NULL || hashmap_put(chunk->tests, packet->test_id,
+						packet->test_id_len, test) != 0) {
+			perror("malloc failed");
+			return -1;
+		}
+		test->name = intern_len(packet->test_id, packet->test_id_len);
+		if (test->name == NULL) {
+			perror("malloc failed");
+			return -1;
+		}
+		test->len = packet->test_id_len;
+		test->tail = &test->events;
+		*chunk->tail = test;
+		chunk->tail = &test->next;
+	}
+	if (is_noop(packet)) {
+		return 0;
+	}
+
+	struct test_event *event = arena_alloc(chunk->scratch, sizeof(*event));
+	if (event == NULL) {
 		perror("malloc failed");
-		return NULL;
+		return -1;
 	}
+	event_from_packet(event, packet);
+	*test->tail = event;
+	test->tail = &event->next;
 
-	uint16_t flags = htons(header.flags);
-	printf("SIGNATURE: %02hhX\n", header.signature);
-	printf("FLAGS: %02hX\n", flags);
-	assert(header.signature == SUBUNIT_SIGNATURE);
+	return 0;
+}
 
-	int8_t version;
-	version = HI(flags) >> 4;
-	printf("\tVERSION: %d\n", version);
-	assert(version == SUBUNIT_VERSION);
+static void *
+decode_chunk(void *arg)
+{
+	struct chunk *chunk = arg;
+	size_t pos = 0;
+	while (pos < chunk->len) {
+		struct subunit_packet packet;
+		int n = subunit_v2_decode(chunk->data + pos, chunk->len - pos,
+					  &packet);
+		if (n <= 0) {
+			chunk->corrupt = 1;
+			break;
+		}
+		if (chunk_packet(chunk, &packet) != 0) {
+			chunk->failed = 1;
+			break;
+		}
+		pos += n;
+	}
 
-	/*
-	int8_t status;
-	status = flags & 0x0007;
-	printf("\tSTATUS: %d\n", status);
-	test_item->status = status;
-	assert(status <= 0x0007);
+	return NULL;
+}
 
-	uint32_t field_value;
-	field_value = read_field(stream);
-	printf("TOTAL LENGTH: %u\n", field_value);
-	assert(field_value < PACKET_MAX_LENGTH);
+/*
+ * Cut a stream into at most n chunks of about the same size, -1 when
+ * lengths of packets do not add up.
+ */
+static int
+split_packets(const uint8_t *data, size_t len, struct chunk *chunks, int n)
+{
+	size_t pos = 0, start = 0;
+	int i = 0;
+	while (pos < len) {
+		const uint8_t *p = data + pos + 3;
+		uint32_t length;
+		if (len - pos < 4 || data[pos] != SUBUNIT_SIGNATURE ||
+		    read_number(&p, data + len, &length) != 0 ||
+		    length < PACKET_MIN_LENGTH || length > len - pos) {
+			return -1;
+		}
+		pos += length;
+		if (pos - start >= len / n && i + 1 < n) {
+			chunks[i].data = data + start;
+			chunks[i].len = pos - start;
+			start = pos;
+			i++;
+		}
+	}
+	if (start < len) {
+		chunks[i].data = data + start;
+		chunks[i].len = len - start;
+		i++;
+	}
 
-	if (flags & FLAG_TIMESTAMP) {
-		printf("FLAG_TIMESTAMP ");
-		field_value = read_field(stream);
-		printf("%08X\n", field_value);
-	};
-	if (flags & FLAG_TEST_ID) {
-		printf("FLAG_TEST_ID ");
-		field_value = read_field(stream);
-		printf("%08X\n", field_value);
-	};
-	if (flags & FLAG_TAGS) {
-		printf("FLAG_TAGS ");
-		field_value = read_field(stream);
-		printf("%02X\n", field_value);
-	};
-	if (flags & FLAG_MIME_TYPE) {
-		printf("FLAG_MIME_TYPE ");
-		field_value = read_field(stream);
-		printf("%02X\n", field_value);
-	};
-	if (flags & FLAG_FILE_CONTENT) {
-		printf("FLAG_FILE_CONTENT ");
-		field_value = read_field(stream);
-		printf("%08X\n", field_value);
-	};
-	if (flags & FLAG_ROUTE_CODE) {
-		printf("FLAG_ROUTE_CODE ");
-		field_value = read_field(stream);
-		printf("%08X\n", field_value);
-	};
-	if (flags & FLAG_EOF) {
-		printf("FLAG_EOF\n");
-	};
-	if (flags & FLAG_RUNNABLE) {
-		printf("FLAG_RUNNABLE\n");
-	};
-	printf("CRC32: ");
-	field_value = read_field(stream);
-	printf("%08X\n", field_value);
-	*/
+	return i;
+}
 
-	return test_item;
+/*
+ * Tests of chunks are looked up in tests of a stream by their interned
+ * names once per chunk, changes of a test are applied without a lookup.
+ */
+static void
+merge_chunk(struct subunit_v2_parser *ctx, struct chunk *chunk)
+{
+	note_time(&ctx->first, &ctx->last, chunk->first);
+	note_time(&ctx->first, &ctx->last, chunk->last);
+
+	struct chunk_test *test;
+	for (test = chunk->first_test; test && !ctx->failed; test = test->next) {
+		struct test_state *state = hashmap_get(ctx->tests, test->name,
+						       test->len);
+		if (state == NULL) {
+			state = add_test(ctx, test->name);
+			if (state == NULL ||
+			    hashmap_put(ctx->tests, test->name, test->len,
+					state) != 0) {
+				perror("malloc failed");
+				ctx->failed = 1;
+				break;
+			}
+		}
+		struct test_event *event;
+		for (event = test->events; event; event = event->next) {
+			apply_event(ctx, state, event);
+		}
+	}
 }
 
+/* -1 when a stream is left to decode_packets() */
+static int
+decode_parallel(struct subunit_v2_parser *ctx, const uint8_t *data,
+		size_t len, int jobs)
+{
+	struct chunk *chunks = calloc(jobs, sizeof(struct chunk));
+	if (chunks == NULL) {
+		perror("malloc failed");
+		return -1;
+	}
+	int n = split_packets(data, len, chunks, jobs);
+	if (n < 2) {
+		free(chunks);
+		return -1;
+	}
+
+	int i, rc = 0;
+	for (i = 0; i < n; i++) {
+		chunks[i].tail = &chunks[i].first_test;
+		chunks[i].scratch = arena_new();
+		chunks[i].tests = hashmap_new(0);
+		if (chunks[i].scratch == NULL || chunks[i].tests == NULL) {
+			perror("malloc failed");
+			chunks[i].failed = 1;
+			continue;
+		}
+		if (i != 0 && pthread_create(&chunks[i].thread, NULL,
+					     decode_chunk, &chunks[i]) == 0) {
+			chunks[i].threaded = 1;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		if (chunks[i].threaded) {
+			pthread_join(chunks[i].thread, NULL);
+		} else if (!chunks[i].failed) {
+			decode_chunk(&chunks[i]);
+		}
+		if (chunks[i].corrupt) {
+			rc = -1;
+		}
+		if (chunks[i].failed) {
+			ctx->failed = 1;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		if (rc == 0 && !ctx->failed) {
+			merge_chunk(ctx, &chunks[i]);
+		}
+		hashmap_free(chunks[i].tests);
+		arena_free(chunks[i].scratch);
+	}
+	free(chunks);
+
+	return ctx->failed ? 0 : rc;
+}
+
+struct suiteq *
+parse_subunit_v2(FILE * stream)
+{
+	return parse_subunit_v2_arena(stream, NULL);
+}
+
+/*
+ * A stream is read into a buffer that holds at least one packet, a
+ * buffer grows when a packet is larger than it.
+ */
+struct suiteq *
+parse_subunit_v2_arena(FILE * stream, struct arena *arena)
+{
+	struct subunit_v2_parser ctx;
+	if (parser_init(&ctx, arena) != 0) {
+		return NULL;
+	}
+
+	size_t cap = BUFFSIZE, len = 0;
+	uint8_t *buf = malloc(cap);
+	if (buf == NULL) {
+		perror("malloc failed");
+		ctx.failed = 1;
+	}
+	int eof = 0;
+	while (!ctx.failed && !eof) {
+		size_t n = fread(buf + len, 1, cap - len, stream);
+		if (ferror(stream)) {
+			fprintf(stderr, "Read error\n");
+			ctx.failed = 1;
+			break;
+		}
+		len += n;
+		eof = n == 0 || feof(stream);
+		size_t used = decode_packets(&ctx, buf, len, eof);
+		memmove(buf, buf + used, len - used);
+		len -= used;
+		if (len == cap) {
+			/* a packet is larger than a buffer */
+			uint8_t *larger = realloc(buf, cap * 2);
+			if (larger == NULL) {
+				perror("malloc failed");
+				ctx.failed = 1;
+				break;
+			}
+			buf = larger;
+			cap *= 2;
+		}
+	}
+	free(buf);
+
+	return parser_finish(&ctx);
+}
+
+/* a stream that is already in memory, e.g. mapped */
+struct suiteq *
+parse_subunit_v2_buffer(const char *data, size_t len, struct arena *arena)
+{
+	struct subunit_v2_parser ctx;
+	if (parser_init(&ctx, arena) != 0) {
+		return NULL;
+	}
+	int jobs = subunit_v2_jobs > 0 ? subunit_v2_jobs : pool_default_jobs();
+	if (jobs < 2 || len < PARALLEL_MIN_SIZE ||
+	    decode_parallel(&ctx, (const uint8_t *)data, len, jobs) != 0) {
+		decode_packets(&ctx, (const uint8_t *)data, len, 1);
+	}
+
+	return parser_finish(&ctx);
+}
 
 /*
+ * A live stream, e.g. a pipe. Every finished test is passed to a callback
+ * and forgotten, so memory does not grow with a number of tests.
+ */
+struct subunit_v2_parser *
+subunit_v2_stream_new(test_result_cb cb, void *arg)
+{
+	struct subunit_v2_parser *ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	ctx->tests = hashmap_new(0);
+	if (ctx->tests == NULL) {
+		free(ctx);
+		return NULL;
+	}
+	ctx->on_test = cb;
+	ctx->arg = arg;
 
-CRC32
-const char *s = "0xb30x2901b329010c03666f6f";
-printf("%lX, should be %X\n", crc32(0, (const void*)s, strlen(s)), sample_crc32);
-http://bxr.su/OpenBSD/bin/md5/crc.c
+	return ctx;
+}
 
-https://rosettacode.org/wiki/CRC-32#C
-http://csbruce.com/software/crc32.c
+/* complete packets of data, returns a number of bytes used */
+size_t
+subunit_v2_stream_parse(struct subunit_v2_parser *ctx, const char *data,
+			size_t len, int eof)
+{
+	return decode_packets(ctx, (const uint8_t *)data, len, eof);
+}
 
-Parse timestamp
-int y, M, d, h, m;
-float sec;
-char *dateStr = "2014-11-12T19:12:14.505Z";
-sscanf(dateStr, "%d-%d-%dT%d:%d:%fZ", &y, &M, &d, &h, &m, &sec);
-https://github.com/mlabbe/c_date_parse
+void
+subunit_v2_stream_free(struct subunit_v2_parser *ctx)
+{
+	if (ctx == NULL) {
+		return;
+	}
+	if (ctx->n_corrupt != 0) {
+		fprintf(stderr, "Skipped %zu corrupted parts of a subunit stream\n",
+			ctx->n_corrupt);
+	}
+	struct hashmap_entry *e;
+	hashmap_foreach(ctx->tests, e) {
+		free(e->value);
+	}
+	hashmap_free(ctx->tests);
+	free(ctx->name);
+	free(ctx);
+}
 
-UTF-8
-https://github.com/benkasminbullock/unicode-c/blob/master/unicode.c
-https://github.com/clibs/cutef8
+/* a test of a single packet, its status only */
+tailq_test *
+read_subunit_v2_packet(FILE * stream)
+{
+	uint8_t head[7];
+	if (fread(head, 1, 4, stream) != 4) {
+		return NULL;
+	}
+	size_t n = head[3] >> 6;
+	if (n > 0 && fread(head + 4, 1, n, stream) != n) {
+		return NULL;
+	}
+	const uint8_t *p = head + 3;
+	uint32_t length;
+	if (read_number(&p, head + 4 + n, &length) != 0 ||
+	    length < PACKET_MIN_LENGTH || length > PACKET_MAX_LENGTH ||
+	    length < 4 + n) {
+		return NULL;
+	}
+	uint8_t *data = malloc(length);
+	if (data == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	memcpy(data, head, 4 + n);
+	struct subunit_packet packet;
+	tailq_test *test_item = NULL;
+	if (fread(data + 4 + n, 1, length - 4 - n, stream) == length - 4 - n &&
+	    subunit_v2_decode(data, length, &packet) > 0) {
+		test_item = calloc(1, sizeof(tailq_test));
+		if (test_item == NULL) {
+			perror("malloc failed");
+		} else {
+			test_item->name = intern_len(packet.test_id,
+						     packet.test_id_len);
+			test_item->status = STATUS_UNDEFINED +
+					    (packet.flags & FLAG_STATUS_MASK);
+		}
+	}
+	free(data);
 
-*/
+	return test_item;
+}
@@ -45,6 +45,10 @@
 #define FLAG_MIME_TYPE		0x0020
 #define FLAG_EOF		0x0010
 #define FLAG_FILE_CONTENT	0x0040
+#define FLAG_STATUS_MASK	0x0007
+
+/* a packet is at least a header, a length and a CRC32 */
+#define PACKET_MIN_LENGTH	8
 
 struct subunit_header {
     uint8_t  signature;
@@ -55,9 +59,40 @@ typedef struct subunit_header subunit_header;
 
 typedef uint32_t timestamp;
 
+/* a decoded packet, strings and a content point into a stream */
+struct subunit_packet {
+    uint16_t flags;
+    double timestamp;		/* seconds since the Epoch, 0 - none */
+    const char *test_id;
+    uint32_t test_id_len;
+    uint32_t n_tags;
+    const uint8_t *tags;	/* n_tags strings one after another */
+    const char *mime_type;
+    uint32_t mime_type_len;
+    const char *file_name;
+    uint32_t file_name_len;
+    const uint8_t *content;
+    uint32_t content_len;
+    const char *route_code;
+    uint32_t route_code_len;
+};
+
+int subunit_v2_decode(const uint8_t *data, size_t len,
+		      struct subunit_packet *packet);
 uint32_t read_field(FILE *stream);
 tailq_test *read_subunit_v2_packet(FILE *stream);
 struct suiteq *parse_subunit_v2(FILE *stream);
+struct suiteq *parse_subunit_v2_arena(FILE *stream, struct arena *arena);
+struct suiteq *parse_subunit_v2_buffer(const char *data, size_t len,
+				       struct arena *arena);
+void subunit_v2_set_jobs(int jobs);
+
+struct subunit_v2_parser;
+struct subunit_v2_parser *subunit_v2_stream_new(test_result_cb cb, void *arg);
+size_t subunit_v2_stream_parse(struct subunit_v2_parser *ctx,
+			       const char *data, size_t len, int eof);
+void subunit_v2_stream_free(struct subunit_v2_parser *ctx);
 int is_subunit_v2(char* path);
+int is_subunit_v2_buffer(const char *data, size_t len);
 
 #endif				/* PARSE_SUBUNIT_V2_H */
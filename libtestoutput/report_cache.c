@@ -0,0 +1,804 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "intern.h"
+#include "parse_junit.h"
+#include "report_cache.h"
+
+/*
+ * Cache file layout, all integers are in a host byte order:
+ *
+ * header: magic[8] version:u32 byte_order:u32 junit_opts n_entries:u32
+ * junit_opts: text_limit:i64 text_spans:u32 use_expat:u32
+ * entry:  path:str digest[20] size:i64 mtime:i64 length:u64 report[length]
+ * report: format:u32 time:i64 path:str id:str summary n_suites:u32 suite...
+ * summary: n_pass:u32 n_fail:u32 n_skip:u32 n_total:u32 total_time:f64
+ *         slowest:str slowest_time:f64
+ * suite:  name:str hostname:str timestamp:str started:i64
+ *         n_failures:i32 n_errors:i32 time:f64 n_tests:u32 test...
+ * test:   name:str time:str duration:f64 comment:str diagnostics:str
+ *         error:str system_out:str system_err:str error_span
+ *         system_out_span system_err_span status:u32
+ * span:   offset:i64 length:i64
+ * str:    length:u32 bytes[length], length NULL_STR is a NULL string
+ */
+
+#define NULL_STR	UINT32_MAX
+
+struct wbuf {
+	unsigned char *data;
+	size_t len;
+	size_t size;
+	int error;
+};
+
+struct rbuf {
+	const unsigned char *p;
+	const unsigned char *end;
+	int error;
+	struct arena *arena;	/* strings go to the heap when NULL */
+};
+
+static void
+put(struct wbuf *b, const void *data, size_t len)
+{
+	if (b->error) {
+		return;
+	}
+	if (b->len + len > b->size) {
+		size_t size = b->size ? b->size : 256;
+		while (size < b->len + len) {
+			size *= 2;
+		}
+		unsigned char *p = realloc(b->data, size);
+		if (p == NULL) {
+			perror("malloc failed");
+			b->error = 1;
+			return;
+		}
+		b->data = p;
+		b->size = size;
+	}
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+static void
+put_u32(struct wbuf *b, uint32_t v)
+{
+	put(b, &v, sizeof(v));
+}
+
+static void
+put_i64(struct wbuf *b, int64_t v)
+{
+	put(b, &v, sizeof(v));
+}
+
+static void
+put_f64(struct wbuf *b, double v)
+{
+	put(b, &v, sizeof(v));
+}
+
+static void
+put_str(struct wbuf *b, const char *s)
+{
+	if (s == NULL) {
+		put_u32(b, NULL_STR);
+		return;
+	}
+	uint32_t len = strlen(s);
+	put_u32(b, len);
+	put(b, s, len);
+}
+
+static void
+get(struct rbuf *b, void *data, size_t len)
+{
+	if (b->error || (size_t)(b->end - b->p) < len) {
+		b->error = 1;
+		memset(data, 0, len);
+		return;
+	}
+	memcpy(data, b->p, len);
+	b->p += len;
+}
+
+static uint32_t
+get_u32(struct rbuf *b)
+{
+	uint32_t v;
+	get(b, &v, sizeof(v));
+	return v;
+}
+
+static int64_t
+get_i64(struct rbuf *b)
+{
+	int64_t v;
+	get(b, &v, sizeof(v));
+	return v;
+}
+
+static double
+get_f64(struct rbuf *b)
+{
+	double v;
+	get(b, &v, sizeof(v));
+	return v;
+}
+
+/* bytes of a string in the buffer, NULL for a NULL string */
+static const char *
+get_bytes(struct rbuf *b, uint32_t *len)
+{
+	*len = get_u32(b);
+	if (b->error || *len == NULL_STR) {
+		return NULL;
+	}
+	if ((size_t)(b->end - b->p) < *len) {
+		b->error = 1;
+		return NULL;
+	}
+	const char *s = (const char *)b->p;
+	b->p += *len;
+
+	return s;
+}
+
+static char *
+get_str(struct rbuf *b)
+{
+	uint32_t len;
+	const char *bytes = get_bytes(b, &len);
+	if (bytes == NULL) {
+		return NULL;
+	}
+	char *s = arena_strndup(b->arena, bytes, len);
+	if (s == NULL) {
+		b->error = 1;
+	}
+
+	return s;
+}
+
+static const char *
+get_name(struct rbuf *b)
+{
+	uint32_t len;
+	const char *bytes = get_bytes(b, &len);
+	if (bytes == NULL) {
+		return NULL;
+	}
+	const char *s = intern_len(bytes, len);
+	if (s == NULL) {
+		b->error = 1;
+	}
+
+	return s;
+}
+
+static void
+put_span(struct wbuf *b, const struct text_span *span)
+{
+	put_i64(b, span->offset);
+	put_i64(b, span->len);
+}
+
+static void
+get_span(struct rbuf *b, struct text_span *span)
+{
+	span->offset = get_i64(b);
+	span->len = get_i64(b);
+}
+
+static void
+serialize_summary(struct wbuf *b, struct report_summary *s)
+{
+	put_u32(b, s->n_pass);
+	put_u32(b, s->n_fail);
+	put_u32(b, s->n_skip);
+	put_u32(b, s->n_total);
+	put_f64(b, s->total_time);
+	put_str(b, s->slowest);
+	put_f64(b, s->slowest_time);
+}
+
+static void
+deserialize_summary(struct rbuf *b, struct report_summary *s)
+{
+	s->n_pass = get_u32(b);
+	s->n_fail = get_u32(b);
+	s->n_skip = get_u32(b);
+	s->n_total = get_u32(b);
+	s->total_time = get_f64(b);
+	s->slowest = get_name(b);
+	s->slowest_time = get_f64(b);
+}
+
+static void
+serialize_suites(struct wbuf *b, struct suiteq *suites)
+{
+	uint32_t n = 0;
+	tailq_suite *suite_item = NULL;
+	if (suites != NULL) {
+		TAILQ_FOREACH(suite_item, suites, entries) {
+			n++;
+		}
+	}
+	put_u32(b, n);
+	if (n == 0) {
+		return;
+	}
+	TAILQ_FOREACH(suite_item, suites, entries) {
+		put_str(b, suite_item->name);
+		put_str(b, suite_item->hostname);
+		put_str(b, suite_item->timestamp);
+		put_i64(b, suite_item->started);
+		put_u32(b, suite_item->n_failures);
+		put_u32(b, suite_item->n_errors);
+		put_f64(b, suite_item->time);
+
+		uint32_t n_tests = 0;
+		tailq_test *test_item = NULL;
+		TAILQ_FOREACH(test_item, suite_item->tests, entries) {
+			n_tests++;
+		}
+		put_u32(b, n_tests);
+		TAILQ_FOREACH(test_item, suite_item->tests, entries) {
+			put_str(b, test_item->name);
+			put_str(b, test_item->time);
+			put_f64(b, test_item->duration);
+			put_str(b, test_item->comment);
+			put_str(b, test_item->diagnostics);
+			put_str(b, test_item->error);
+			put_str(b, test_item->system_out);
+			put_str(b, test_item->system_err);
+			put_span(b, &test_item->error_span);
+			put_span(b, &test_item->system_out_span);
+			put_span(b, &test_item->system_err_span);
+			put_u32(b, test_item->status);
+		}
+	}
+}
+
+unsigned char *
+serialize_report(tailq_report *report, size_t *len)
+{
+	struct wbuf b = { NULL, 0, 0, 0 };
+
+	put_u32(&b, report->format);
+	put_i64(&b, report->time);
+	put_str(&b, (char *)report->path);
+	put_str(&b, (char *)report->id);
+	serialize_summary(&b, &report->summary);
+	serialize_suites(&b, report->suites);
+	if (b.error) {
+		free(b.data);
+		return NULL;
+	}
+	*len = b.len;
+
+	return b.data;
+}
+
+static struct suiteq *
+deserialize_suites(struct rbuf *b)
+{
+	struct suiteq *suites;
+	suites = arena_alloc(b->arena, sizeof(struct suiteq));
+	if (suites == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	TAILQ_INIT(suites);
+
+	uint32_t n_suites = get_u32(b);
+	uint32_t i, j;
+	for (i = 0; i < n_suites && !b->error; i++) {
+		tailq_suite *suite_item = arena_alloc(b->arena, sizeof(tailq_suite));
+		if (suite_item == NULL) {
+			perror("malloc failed");
+			b->error = 1;
+			break;
+		}
+		suite_item->tests = arena_alloc(b->arena, sizeof(struct testq));
+		if (suite_item->tests == NULL) {
+			perror("malloc failed");
+			b->error = 1;
+			break;
+		}
+		TAILQ_INIT(suite_item->tests);
+		TAILQ_INSERT_TAIL(suites, suite_item, entries);
+
+		suite_item->name = get_name(b);
+		suite_item->hostname = get_name(b);
+		suite_item->timestamp = get_str(b);
+		suite_item->started = get_i64(b);
+		suite_item->n_failures = get_u32(b);
+		suite_item->n_errors = get_u32(b);
+		suite_item->time = get_f64(b);
+
+		uint32_t n_tests = get_u32(b);
+		for (j = 0; j < n_tests && !b->error; j++) {
+			tailq_test *test_item = arena_alloc(b->arena, sizeof(tailq_test));
+			if (test_item == NULL) {
+				perror("malloc failed");
+				b->error = 1;
+				break;
+			}
+			TAILQ_INSERT_TAIL(suite_item->tests, test_item, entries);
+			test_item->name = get_name(b);
+			test_item->time = get_str(b);
+			test_item->duration = get_f64(b);
+			test_item->comment = get_str(b);
+			test_item->diagnostics = get_str(b);
+			test_item->error = get_str(b);
+			test_item->system_out = get_str(b);
+			test_item->system_err = get_str(b);
+			get_span(b, &test_item->error_span);
+			get_span(b, &test_item->system_out_span);
+			get_span(b, &test_item->system_err_span);
+			test_item->status = get_u32(b);
+		}
+	}
+
+	return suites;
+}
+
+/*
+ * Suites follow a summary of a report, so a summary is read without
+ * touching the rest of a serialized report.
+ */
+tailq_report *
+deserialize_report(const unsigned char *data, size_t len, int summary)
+{
+	struct rbuf b = { data, data + len, 0, NULL };
+
+	tailq_report *report = calloc(1, sizeof(tailq_report));
+	if (report == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	report->format = get_u32(&b);
+	report->time = get_i64(&b);
+	report->path = (unsigned char *)get_str(&b);
+	report->id = (unsigned char *)get_str(&b);
+	str_to_digest((char *)report->id, report->digest);
+	deserialize_summary(&b, &report->summary);
+	if (summary) {
+		if (b.error) {
+			free_report(report);
+			return NULL;
+		}
+		return report;
+	}
+	if ((report->arena = b.arena = arena_new()) == NULL) {
+		free_report(report);
+		return NULL;
+	}
+	report->suites = deserialize_suites(&b);
+	if (b.error || report->suites == NULL) {
+		free_report(report);
+		return NULL;
+	}
+
+	return report;
+}
+
+static void
+free_entry(struct cache_entry *entry)
+{
+	if (entry->owned) {
+		free((void *)entry->data);
+	}
+	free(entry->path);
+	free(entry);
+}
+
+/*
+ * A cache file is mapped, so only pages with entries that are looked up
+ * are read, e.g. summaries of reports but not their suites.
+ */
+static int
+load(struct report_cache *cache)
+{
+	int fd = open(cache->path, O_RDONLY);
+	if (fd == -1) {
+		return errno == ENOENT ? 0 : -1;
+	}
+	struct stat sb;
+	if (fstat(fd, &sb) == -1 || sb.st_size == 0) {
+		close(fd);
+		return -1;
+	}
+	void *p = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	cache->buf = p;
+	cache->len = sb.st_size;
+
+	struct rbuf b = { cache->buf, cache->buf + cache->len, 0, NULL };
+	char magic[sizeof(CACHE_MAGIC) - 1];
+	get(&b, magic, sizeof(magic));
+	if (memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 ||
+	    get_u32(&b) != CACHE_VERSION ||
+	    get_u32(&b) != CACHE_BYTE_ORDER) {
+		return -1;
+	}
+	/* e.g. texts were cut by another limit */
+	struct junit_opts opts;
+	junit_get_opts(&opts);
+	if (get_i64(&b) != (int64_t)opts.text_limit ||
+	    get_u32(&b) != (uint32_t)opts.text_spans ||
+	    get_u32(&b) != (uint32_t)opts.use_expat) {
+		return -1;
+	}
+
+	uint32_t n = get_u32(&b);
+	uint32_t i;
+	for (i = 0; i < n && !b.error; i++) {
+		struct cache_entry *entry = calloc(1, sizeof(struct cache_entry));
+		if (entry == NULL) {
+			perror("malloc failed");
+			return -1;
+		}
+		entry->path = get_str(&b);
+		get(&b, entry->digest, sizeof(entry->digest));
+		entry->size = get_i64(&b);
+		entry->mtime = get_i64(&b);
+		entry->len = get_i64(&b);
+		entry->data = b.p;
+		if (b.error || entry->path == NULL ||
+		    (size_t)(b.end - b.p) < entry->len) {
+			free_entry(entry);
+			return -1;
+		}
+		b.p += entry->len;
+		if (hashmap_put(cache->index, entry->path,
+				strlen(entry->path), entry) != 0) {
+			free_entry(entry);
+			return -1;
+		}
+		if (hashmap_put(cache->by_digest, entry->digest,
+				sizeof(entry->digest), entry) != 0) {
+			return -1;
+		}
+	}
+
+	return b.error ? -1 : 0;
+}
+
+static void
+clear(struct report_cache *cache)
+{
+	struct hashmap_entry *e;
+	hashmap_foreach(cache->index, e) {
+		free_entry(e->value);
+	}
+	hashmap_free(cache->index);
+	hashmap_free(cache->by_digest);
+	cache->index = NULL;
+	cache->by_digest = NULL;
+}
+
+struct report_cache *
+cache_open(const char *path)
+{
+	struct report_cache *cache;
+	cache = calloc(1, sizeof(struct report_cache));
+	if (cache == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	cache->path = strdup(path);
+	cache->index = hashmap_new(0);
+	cache->by_digest = hashmap_new(0);
+	if (cache->path == NULL || cache->index == NULL ||
+	    cache->by_digest == NULL) {
+		perror("malloc failed");
+		hashmap_free(cache->index);
+		hashmap_free(cache->by_digest);
+		free(cache->path);
+		free(cache);
+		return NULL;
+	}
+	pthread_mutex_init(&cache->lock, NULL);
+
+	if (load(cache) != 0) {
+		/* broken or stale cache, start from scratch */
+		fprintf(stderr, "ignore cache %s\n", path);
+		clear(cache);
+		cache->index = hashmap_new(0);
+		cache->by_digest = hashmap_new(0);
+		cache->dirty = 1;
+		if (cache->index == NULL || cache->by_digest == NULL) {
+			cache_close(cache);
+			return NULL;
+		}
+	}
+
+	return cache;
+}
+
+void
+cache_close(struct report_cache *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+	if (cache->index != NULL) {
+		clear(cache);
+	}
+	pthread_mutex_destroy(&cache->lock);
+	if (cache->buf != NULL) {
+		munmap(cache->buf, cache->len);
+	}
+	free(cache->path);
+	free(cache);
+}
+
+static tailq_report *
+lookup(struct report_cache *cache, const char *path, const struct stat *sb,
+       int summary)
+{
+	const unsigned char *data = NULL;
+	size_t len = 0;
+
+	pthread_mutex_lock(&cache->lock);
+	struct cache_entry *entry = hashmap_get(cache->index, path, strlen(path));
+	if (entry != NULL && entry->size == (int64_t)sb->st_size &&
+	    entry->mtime == (int64_t)sb->st_mtime) {
+		entry->used = 1;
+		data = entry->data;
+		len = entry->len;
+	}
+	pthread_mutex_unlock(&cache->lock);
+
+	if (data == NULL) {
+		return NULL;
+	}
+
+	return deserialize_report(data, len, summary);
+}
+
+tailq_report *
+cache_lookup(struct report_cache *cache, const char *path,
+	     const struct stat *sb)
+{
+	return lookup(cache, path, sb, 0);
+}
+
+tailq_report *
+cache_lookup_summary(struct report_cache *cache, const char *path,
+		     const struct stat *sb)
+{
+	return lookup(cache, path, sb, 1);
+}
+
+int
+cache_update(struct report_cache *cache, const char *path,
+	     const struct stat *sb, tailq_report *report)
+{
+	size_t len = 0;
+	unsigned char *data = serialize_report(report, &len);
+	if (data == NULL) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+	struct cache_entry *entry = hashmap_get(cache->index, path, strlen(path));
+	if (entry == NULL) {
+		entry = calloc(1, sizeof(struct cache_entry));
+		if (entry != NULL && (entry->path = strdup(path)) != NULL &&
+		    hashmap_put(cache->index, entry->path,
+				strlen(entry->path), entry) == 0) {
+			entry->owned = 1;
+			report_digest(entry->path, entry->digest);
+			hashmap_put(cache->by_digest, entry->digest,
+				    sizeof(entry->digest), entry);
+		} else {
+			perror("malloc failed");
+			if (entry != NULL) {
+				free(entry->path);
+			}
+			free(entry);
+			free(data);
+			pthread_mutex_unlock(&cache->lock);
+			return -1;
+		}
+	} else if (entry->owned) {
+		free((void *)entry->data);
+	}
+	entry->owned = 1;
+	entry->data = data;
+	entry->len = len;
+	entry->size = sb->st_size;
+	entry->mtime = sb->st_mtime;
+	entry->used = 1;
+	cache->dirty = 1;
+	pthread_mutex_unlock(&cache->lock);
+
+	return 0;
+}
+
+void
+cache_remove(struct report_cache *cache, const char *path)
+{
+	pthread_mutex_lock(&cache->lock);
+	struct cache_entry *entry;
+	entry = hashmap_remove(cache->index, path, strlen(path));
+	if (entry != NULL) {
+		hashmap_remove(cache->by_digest, entry->digest,
+			       sizeof(entry->digest));
+		free_entry(entry);
+		cache->dirty = 1;
+	}
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/* path of a report by its digest, valid until the cache is closed */
+const char *
+cache_find_digest(struct report_cache *cache, const unsigned char digest[])
+{
+	pthread_mutex_lock(&cache->lock);
+	struct cache_entry *entry = hashmap_get(cache->by_digest, digest,
+						REPORT_DIGEST_LEN);
+	pthread_mutex_unlock(&cache->lock);
+
+	return entry ? entry->path : NULL;
+}
+
+/* with summary set a returned report has no suites */
+tailq_report *
+cache_process_file(struct report_cache *cache, const char *path,
+		   int summary)
+{
+	struct stat sb;
+	if (stat(path, &sb) == -1) {
+		perror("cannot open specified path");
+		return NULL;
+	}
+
+	tailq_report *report = lookup(cache, path, &sb, summary);
+	if (report != NULL) {
+		return report;
+	}
+	report = process_file(path);
+	if (report != NULL && report->format != FORMAT_UNKNOWN) {
+		cache_update(cache, path, &sb, report);
+	}
+	if (report != NULL && summary) {
+		free_report_suites(report);
+	}
+
+	return report;
+}
+
+/*
+ * Entries that were not looked up or updated belong to removed files and
+ * are dropped. A cache is written to a temporary file first and then
+ * renamed, so concurrent readers always see a complete file.
+ */
+int
+cache_save(struct report_cache *cache)
+{
+	uint32_t n = 0;
+	struct hashmap_entry *e;
+	hashmap_foreach(cache->index, e) {
+		struct cache_entry *entry = e->value;
+		if (entry->used) {
+			n++;
+		}
+	}
+	if (!cache->dirty && n == cache->index->count) {
+		return 0;
+	}
+
+	int path_len = strlen(cache->path) + sizeof(".XXXXXX");
+	char *tmp_path = calloc(path_len, sizeof(char));
+	if (tmp_path == NULL) {
+		perror("malloc failed");
+		return -1;
+	}
+	snprintf(tmp_path, path_len, "%s.XXXXXX", cache->path);
+	int fd = mkstemp(tmp_path);
+	if (fd != -1) {
+		fchmod(fd, 0644);
+	}
+	FILE *file = fd == -1 ? NULL : fdopen(fd, "w");
+	if (file == NULL) {
+		perror("cannot create cache");
+		if (fd != -1) {
+			close(fd);
+			unlink(tmp_path);
+		}
+		free(tmp_path);
+		return -1;
+	}
+
+	uint32_t version = CACHE_VERSION;
+	uint32_t byte_order = CACHE_BYTE_ORDER;
+	struct junit_opts opts;
+	junit_get_opts(&opts);
+	int64_t text_limit = opts.text_limit;
+	uint32_t text_spans = opts.text_spans;
+	uint32_t use_expat = opts.use_expat;
+	fwrite(CACHE_MAGIC, 1, sizeof(CACHE_MAGIC) - 1, file);
+	fwrite(&version, sizeof(version), 1, file);
+	fwrite(&byte_order, sizeof(byte_order), 1, file);
+	fwrite(&text_limit, sizeof(text_limit), 1, file);
+	fwrite(&text_spans, sizeof(text_spans), 1, file);
+	fwrite(&use_expat, sizeof(use_expat), 1, file);
+	fwrite(&n, sizeof(n), 1, file);
+	hashmap_foreach(cache->index, e) {
+		struct cache_entry *entry = e->value;
+		if (!entry->used) {
+			continue;
+		}
+		uint32_t len = strlen(entry->path);
+		uint64_t data_len = entry->len;
+		fwrite(&len, sizeof(len), 1, file);
+		fwrite(entry->path, 1, len, file);
+		fwrite(entry->digest, 1, sizeof(entry->digest), file);
+		fwrite(&entry->size, sizeof(entry->size), 1, file);
+		fwrite(&entry->mtime, sizeof(entry->mtime), 1, file);
+		fwrite(&data_len, sizeof(data_len), 1, file);
+		fwrite(entry->data, 1, entry->len, file);
+	}
+
+	int rc = 0;
+	int failed = ferror(file);
+	if (fclose(file) != 0) {
+		failed = 1;
+	}
+	if (failed || rename(tmp_path, cache->path) == -1) {
+		perror("cannot write cache");
+		unlink(tmp_path);
+		rc = -1;
+	} else {
+		cache->dirty = 0;
+	}
+	free(tmp_path);
+
+	return rc;
+}
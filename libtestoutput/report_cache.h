@@ -0,0 +1,90 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef REPORT_CACHE_H
+#define REPORT_CACHE_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "hashmap.h"
+#include "parse_common.h"
+
+/*
+ * On-disk cache of parsed reports. Every entry holds a report serialized
+ * to a compact binary form and is keyed by a path, a size and a
+ * modification time of a report file, so a changed file is parsed again.
+ * Options of parsers that change parsed reports are kept in a header and
+ * the whole cache is dropped when they differ from current ones.
+ */
+
+#define CACHE_MAGIC		"TESTRES\0"
+#define CACHE_VERSION		8
+#define CACHE_BYTE_ORDER	0x01020304
+
+struct cache_entry {
+	char *path;
+	unsigned char digest[REPORT_DIGEST_LEN];	/* of a path */
+	int64_t size;
+	int64_t mtime;
+	const unsigned char *data;	/* serialized report */
+	size_t len;
+	int owned;			/* data is not a part of a loaded file */
+	int used;			/* file still exists */
+};
+
+struct report_cache {
+	char *path;
+	unsigned char *buf;		/* contents of a loaded cache file */
+	size_t len;
+	struct hashmap *index;		/* path -> struct cache_entry */
+	struct hashmap *by_digest;	/* digest -> struct cache_entry */
+	int dirty;
+	pthread_mutex_t lock;
+};
+
+struct report_cache *cache_open(const char *path);
+void cache_close(struct report_cache *cache);
+int cache_save(struct report_cache *cache);
+tailq_report *cache_lookup(struct report_cache *cache, const char *path,
+			   const struct stat *sb);
+tailq_report *cache_lookup_summary(struct report_cache *cache, const char *path,
+				   const struct stat *sb);
+int cache_update(struct report_cache *cache, const char *path,
+		 const struct stat *sb, tailq_report *report);
+void cache_remove(struct report_cache *cache, const char *path);
+const char *cache_find_digest(struct report_cache *cache,
+			      const unsigned char digest[]);
+tailq_report *cache_process_file(struct report_cache *cache, const char *path,
+				 int summary);
+
+unsigned char *serialize_report(tailq_report *report, size_t *len);
+tailq_report *deserialize_report(const unsigned char *data, size_t len,
+				 int summary);
+
+#endif				/* REPORT_CACHE_H */
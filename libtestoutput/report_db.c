@@ -0,0 +1,598 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "intern.h"
+#include "parse_junit.h"
+#include "report_db.h"
+
+#ifdef HAVE_SQLITE3
+
+#include <sqlite3.h>
+
+static const char *schema =
+	"CREATE TABLE IF NOT EXISTS reports ("
+	"  id INTEGER PRIMARY KEY,"
+	"  digest TEXT NOT NULL UNIQUE,"
+	"  path TEXT,"
+	"  format INTEGER NOT NULL,"
+	"  time INTEGER NOT NULL,"
+	"  n_pass INTEGER NOT NULL,"
+	"  n_fail INTEGER NOT NULL,"
+	"  n_skip INTEGER NOT NULL,"
+	"  n_total INTEGER NOT NULL DEFAULT 0,"
+	"  total_time REAL NOT NULL DEFAULT 0,"
+	"  slowest TEXT,"
+	"  slowest_time REAL NOT NULL DEFAULT 0);"
+	"CREATE TABLE IF NOT EXISTS suites ("
+	"  id INTEGER PRIMARY KEY,"
+	"  report_id INTEGER NOT NULL REFERENCES reports(id) ON DELETE CASCADE,"
+	"  name TEXT,"
+	"  hostname TEXT,"
+	"  timestamp TEXT,"
+	"  n_failures INTEGER,"
+	"  n_errors INTEGER,"
+	"  time REAL);"
+	"CREATE TABLE IF NOT EXISTS tests ("
+	"  id INTEGER PRIMARY KEY,"
+	"  suite_id INTEGER NOT NULL REFERENCES suites(id) ON DELETE CASCADE,"
+	"  name TEXT,"
+	"  time TEXT,"
+	"  duration REAL,"
+	"  status INTEGER NOT NULL,"
+	"  comment TEXT,"
+	"  error TEXT,"
+	"  system_out TEXT,"
+	"  system_err TEXT);"
+	"CREATE INDEX IF NOT EXISTS reports_time ON reports(time);"
+	"CREATE INDEX IF NOT EXISTS suites_report ON suites(report_id);"
+	"CREATE INDEX IF NOT EXISTS tests_suite ON tests(suite_id);"
+	"CREATE INDEX IF NOT EXISTS tests_name ON tests(name);"
+	"CREATE INDEX IF NOT EXISTS tests_status ON tests(status);"
+	"CREATE INDEX IF NOT EXISTS tests_duration ON tests(duration);";
+
+/* columns added to reports after the first version of the schema */
+static const char *migration =
+	"ALTER TABLE reports ADD COLUMN n_total INTEGER NOT NULL DEFAULT 0;"
+	"ALTER TABLE reports ADD COLUMN total_time REAL NOT NULL DEFAULT 0;"
+	"ALTER TABLE reports ADD COLUMN slowest TEXT;"
+	"ALTER TABLE reports ADD COLUMN slowest_time REAL NOT NULL DEFAULT 0;";
+
+/*
+ * Version of data in a database kept in user_version, 1 - report ids are
+ * digests printed with two hex digits per byte.
+ */
+#define DB_VERSION	1
+
+static sqlite3 *
+db_open(const char *path, int flags)
+{
+	sqlite3 *db = NULL;
+	if (sqlite3_open_v2(path, &db, flags, NULL) != SQLITE_OK) {
+		fprintf(stderr, "cannot open database %s: %s\n", path,
+			sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return NULL;
+	}
+	sqlite3_busy_timeout(db, 5000);
+
+	return db;
+}
+
+static int
+db_exec(sqlite3 *db, const char *sql)
+{
+	char *errmsg = NULL;
+	if (sqlite3_exec(db, sql, NULL, NULL, &errmsg) != SQLITE_OK) {
+		fprintf(stderr, "database error: %s\n", errmsg);
+		sqlite3_free(errmsg);
+		return -1;
+	}
+
+	return 0;
+}
+
+static sqlite3_stmt *
+db_prepare(sqlite3 *db, const char *sql)
+{
+	sqlite3_stmt *stmt = NULL;
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+		fprintf(stderr, "database error: %s\n", sqlite3_errmsg(db));
+		return NULL;
+	}
+
+	return stmt;
+}
+
+/* run a statement that returns no rows and make it ready for reuse */
+static int
+db_step(sqlite3_stmt *stmt)
+{
+	int rc = sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+
+	return rc == SQLITE_DONE ? 0 : -1;
+}
+
+static int
+has_summary(sqlite3 *db)
+{
+	sqlite3_stmt *stmt = NULL;
+	int rc = sqlite3_prepare_v2(db, "SELECT slowest_time FROM reports",
+				    -1, &stmt, NULL);
+	sqlite3_finalize(stmt);
+
+	return rc == SQLITE_OK;
+}
+
+static int
+db_version(sqlite3 *db)
+{
+	sqlite3_stmt *stmt = NULL;
+	int version = -1;
+	if (sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &stmt,
+			       NULL) == SQLITE_OK &&
+	    sqlite3_step(stmt) == SQLITE_ROW) {
+		version = sqlite3_column_int(stmt, 0);
+	}
+	sqlite3_finalize(stmt);
+
+	return version;
+}
+
+/*
+ * Ids of reports were printed with a varying number of digits per byte,
+ * so a stored report was not found by its id. Such ids are computed again
+ * from paths of reports.
+ */
+static int
+migrate_digests(sqlite3 *db)
+{
+	sqlite3_stmt *sel = db_prepare(db,
+		"SELECT id, path FROM reports WHERE length(digest) != 40");
+	sqlite3_stmt *upd = db_prepare(db,
+		"UPDATE reports SET digest = ? WHERE id = ?");
+	int rc = sel && upd ? 0 : -1;
+	while (rc == 0 && sqlite3_step(sel) == SQLITE_ROW) {
+		const char *path = (const char *)sqlite3_column_text(sel, 1);
+		if (path == NULL) {
+			continue;
+		}
+		unsigned char digest[REPORT_DIGEST_LEN];
+		unsigned char id[REPORT_DIGEST_LEN * 2 + 1];
+		report_digest(path, digest);
+		digest_to_str(id, digest, REPORT_DIGEST_LEN);
+		sqlite3_bind_text(upd, 1, (char *)id, -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int64(upd, 2, sqlite3_column_int64(sel, 0));
+		rc = db_step(upd);
+	}
+	sqlite3_finalize(sel);
+	sqlite3_finalize(upd);
+
+	return rc;
+}
+
+static char *
+column_str(struct arena *arena, sqlite3_stmt *stmt, int col)
+{
+	const unsigned char *s = sqlite3_column_text(stmt, col);
+	if (s == NULL) {
+		return NULL;
+	}
+
+	return arena_strndup(arena, (const char *)s,
+			     sqlite3_column_bytes(stmt, col));
+}
+
+static const char *
+column_name(sqlite3_stmt *stmt, int col)
+{
+	const unsigned char *s = sqlite3_column_text(stmt, col);
+	if (s == NULL) {
+		return NULL;
+	}
+
+	return intern_len((const char *)s, sqlite3_column_bytes(stmt, col));
+}
+
+/* a text left in a report file is stored as a text, see junit_text() */
+static void
+bind_test_text(sqlite3_stmt *stmt, int i, const char *path, const char *text,
+	       const struct text_span *span)
+{
+	char *copy;
+	text = junit_text(path, text, span, &copy);
+	if (copy != NULL) {
+		sqlite3_bind_text(stmt, i, copy, -1, free);
+	} else {
+		sqlite3_bind_text(stmt, i, text, -1, SQLITE_STATIC);
+	}
+}
+
+static int
+store_suites(sqlite3 *db, sqlite3_stmt *ins_suite, sqlite3_stmt *ins_test,
+	     sqlite3_int64 report_id, const char *path, struct suiteq *suites)
+{
+	tailq_suite *suite_item = NULL;
+	TAILQ_FOREACH(suite_item, suites, entries) {
+		sqlite3_bind_int64(ins_suite, 1, report_id);
+		sqlite3_bind_text(ins_suite, 2, suite_item->name, -1, SQLITE_STATIC);
+		sqlite3_bind_text(ins_suite, 3, suite_item->hostname, -1, SQLITE_STATIC);
+		sqlite3_bind_text(ins_suite, 4, suite_item->timestamp, -1, SQLITE_STATIC);
+		sqlite3_bind_int(ins_suite, 5, suite_item->n_failures);
+		sqlite3_bind_int(ins_suite, 6, suite_item->n_errors);
+		sqlite3_bind_double(ins_suite, 7, suite_item->time);
+		if (db_step(ins_suite) != 0) {
+			return -1;
+		}
+		sqlite3_int64 suite_id = sqlite3_last_insert_rowid(db);
+
+		tailq_test *test_item = NULL;
+		TAILQ_FOREACH(test_item, suite_item->tests, entries) {
+			sqlite3_bind_int64(ins_test, 1, suite_id);
+			sqlite3_bind_text(ins_test, 2, test_item->name, -1, SQLITE_STATIC);
+			sqlite3_bind_text(ins_test, 3, test_item->time, -1, SQLITE_STATIC);
+			if (test_item->time != NULL) {
+				sqlite3_bind_double(ins_test, 4, test_item->duration);
+			} else {
+				sqlite3_bind_null(ins_test, 4);
+			}
+			sqlite3_bind_int(ins_test, 5, test_item->status);
+			sqlite3_bind_text(ins_test, 6, test_item->comment, -1, SQLITE_STATIC);
+			bind_test_text(ins_test, 7, path, test_item->error,
+				       &test_item->error_span);
+			bind_test_text(ins_test, 8, path, test_item->system_out,
+				       &test_item->system_out_span);
+			bind_test_text(ins_test, 9, path, test_item->system_err,
+				       &test_item->system_err_span);
+			if (db_step(ins_test) != 0) {
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * All reports are stored in a single transaction with prepared
+ * statements. A report that is already in a database is replaced.
+ */
+int
+db_store_reports(const char *path, struct reportq *reports)
+{
+	sqlite3 *db = db_open(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+	if (db == NULL) {
+		return -1;
+	}
+	if (db_exec(db, "PRAGMA foreign_keys = ON") != 0 ||
+	    db_exec(db, schema) != 0 ||
+	    (!has_summary(db) && db_exec(db, migration) != 0) ||
+	    db_exec(db, "BEGIN") != 0) {
+		sqlite3_close(db);
+		return -1;
+	}
+	char set_version[32];
+	snprintf(set_version, sizeof(set_version), "PRAGMA user_version = %d",
+		 DB_VERSION);
+	if (db_version(db) < DB_VERSION &&
+	    (migrate_digests(db) != 0 || db_exec(db, set_version) != 0)) {
+		fprintf(stderr, "database error: %s\n", sqlite3_errmsg(db));
+		db_exec(db, "ROLLBACK");
+		sqlite3_close(db);
+		return -1;
+	}
+
+	sqlite3_stmt *del_report = db_prepare(db,
+		"DELETE FROM reports WHERE digest = ?");
+	sqlite3_stmt *ins_report = db_prepare(db,
+		"INSERT INTO reports (digest, path, format, time, n_pass, n_fail, "
+		"n_skip, n_total, total_time, slowest, slowest_time) "
+		"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+	sqlite3_stmt *ins_suite = db_prepare(db,
+		"INSERT INTO suites (report_id, name, hostname, timestamp, "
+		"n_failures, n_errors, time) VALUES (?, ?, ?, ?, ?, ?, ?)");
+	sqlite3_stmt *ins_test = db_prepare(db,
+		"INSERT INTO tests (suite_id, name, time, duration, status, "
+		"comment, error, system_out, system_err) "
+		"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
+
+	int rc = 0;
+	if (!del_report || !ins_report || !ins_suite || !ins_test) {
+		rc = -1;
+	}
+	tailq_report *report_item = NULL;
+	TAILQ_FOREACH(report_item, reports, entries) {
+		if (rc != 0) {
+			break;
+		}
+		sqlite3_bind_text(del_report, 1, (char *)report_item->id, -1, SQLITE_STATIC);
+		if (db_step(del_report) != 0) {
+			rc = -1;
+			break;
+		}
+		sqlite3_bind_text(ins_report, 1, (char *)report_item->id, -1, SQLITE_STATIC);
+		sqlite3_bind_text(ins_report, 2, (char *)report_item->path, -1, SQLITE_STATIC);
+		sqlite3_bind_int(ins_report, 3, report_item->format);
+		sqlite3_bind_int64(ins_report, 4, report_item->time);
+		sqlite3_bind_int(ins_report, 5, report_item->summary.n_pass);
+		sqlite3_bind_int(ins_report, 6, report_item->summary.n_fail);
+		sqlite3_bind_int(ins_report, 7, report_item->summary.n_skip);
+		sqlite3_bind_int(ins_report, 8, report_item->summary.n_total);
+		sqlite3_bind_double(ins_report, 9, report_item->summary.total_time);
+		sqlite3_bind_text(ins_report, 10, report_item->summary.slowest, -1, SQLITE_STATIC);
+		sqlite3_bind_double(ins_report, 11, report_item->summary.slowest_time);
+		if (db_step(ins_report) != 0) {
+			rc = -1;
+			break;
+		}
+		if (report_item->suites != NULL &&
+		    store_suites(db, ins_suite, ins_test,
+				 sqlite3_last_insert_rowid(db),
+				 (const char *)report_item->path,
+				 report_item->suites) != 0) {
+			rc = -1;
+		}
+	}
+	if (rc != 0) {
+		fprintf(stderr, "database error: %s\n", sqlite3_errmsg(db));
+	}
+
+	sqlite3_finalize(del_report);
+	sqlite3_finalize(ins_report);
+	sqlite3_finalize(ins_suite);
+	sqlite3_finalize(ins_test);
+	if (db_exec(db, rc == 0 ? "COMMIT" : "ROLLBACK") != 0) {
+		rc = -1;
+	}
+	sqlite3_close(db);
+
+	return rc;
+}
+
+static struct suiteq *
+db_load_suites(struct arena *arena, sqlite3_stmt *sel_suites,
+	       sqlite3_stmt *sel_tests, sqlite3_int64 report_id)
+{
+	struct suiteq *suites;
+	suites = arena_alloc(arena, sizeof(struct suiteq));
+	if (suites == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	TAILQ_INIT(suites);
+
+	sqlite3_bind_int64(sel_suites, 1, report_id);
+	while (sqlite3_step(sel_suites) == SQLITE_ROW) {
+		tailq_suite *suite_item = arena_alloc(arena, sizeof(tailq_suite));
+		if (suite_item == NULL) {
+			perror("malloc failed");
+			break;
+		}
+		suite_item->tests = arena_alloc(arena, sizeof(struct testq));
+		if (suite_item->tests == NULL) {
+			perror("malloc failed");
+			break;
+		}
+		TAILQ_INIT(suite_item->tests);
+		suite_item->name = column_name(sel_suites, 1);
+		suite_item->hostname = column_name(sel_suites, 2);
+		suite_item->timestamp = column_str(arena, sel_suites, 3);
+		suite_item->n_failures = sqlite3_column_int(sel_suites, 4);
+		suite_item->n_errors = sqlite3_column_int(sel_suites, 5);
+		suite_item->time = sqlite3_column_double(sel_suites, 6);
+		suite_item->started = parse_iso8601(suite_item->timestamp);
+		TAILQ_INSERT_TAIL(suites, suite_item, entries);
+
+		sqlite3_bind_int64(sel_tests, 1, sqlite3_column_int64(sel_suites, 0));
+		while (sqlite3_step(sel_tests) == SQLITE_ROW) {
+			tailq_test *test_item = arena_alloc(arena, sizeof(tailq_test));
+			if (test_item == NULL) {
+				perror("malloc failed");
+				break;
+			}
+			test_item->name = column_name(sel_tests, 0);
+			test_item->time = column_str(arena, sel_tests, 1);
+			test_item->status = sqlite3_column_int(sel_tests, 2);
+			test_item->comment = column_str(arena, sel_tests, 3);
+			test_item->error = column_str(arena, sel_tests, 4);
+			test_item->system_out = column_str(arena, sel_tests, 5);
+			test_item->system_err = column_str(arena, sel_tests, 6);
+			test_item->duration = sqlite3_column_double(sel_tests, 7);
+			TAILQ_INSERT_TAIL(suite_item->tests, test_item, entries);
+		}
+		sqlite3_reset(sel_tests);
+	}
+	sqlite3_reset(sel_suites);
+
+	return suites;
+}
+
+/*
+ * A GLOB pattern of names that start with a string, wildcards in a string
+ * are matched literally. A GLOB prefix is looked up in the tests_name
+ * index, a LIKE is not as it ignores case and the column does not.
+ */
+static char *
+glob_prefix(const char *s)
+{
+	char *pattern = malloc(strlen(s) * 3 + 2);
+	if (pattern == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	char *p = pattern;
+	for (; *s != '\0'; s++) {
+		if (*s == '*' || *s == '?' || *s == '[') {
+			*p++ = '[';
+			*p++ = *s;
+			*p++ = ']';
+		} else {
+			*p++ = *s;
+		}
+	}
+	*p++ = '*';
+	*p = '\0';
+
+	return pattern;
+}
+
+struct reportq *
+process_db_filter(const char *path, struct db_filter *filter)
+{
+	sqlite3 *db = db_open(path, SQLITE_OPEN_READONLY);
+	if (db == NULL) {
+		return NULL;
+	}
+
+	/*
+	 * Only conditions that are set go to a query, so indexes are used.
+	 * A database written before the summary columns were added has
+	 * counters only.
+	 */
+	int summary = has_summary(db);
+	char sql[1024] = "SELECT id, digest, path, format, time, n_pass, n_fail, "
+			 "n_skip";
+	strcat(sql, summary ? ", n_total, total_time, slowest, slowest_time "
+			      "FROM reports WHERE 1" : " FROM reports WHERE 1");
+	if (filter && filter->report_id) {
+		strcat(sql, " AND digest = ?1");
+	}
+	if (filter && filter->since) {
+		strcat(sql, " AND time >= ?2");
+	}
+	if (filter && filter->test_name) {
+		strcat(sql, " AND id IN (SELECT s.report_id FROM tests t"
+			    " JOIN suites s ON s.id = t.suite_id WHERE t.name = ?3)");
+	}
+	if (filter && filter->search) {
+		strcat(sql, " AND id IN (SELECT s.report_id FROM tests t"
+			    " JOIN suites s ON s.id = t.suite_id"
+			    " WHERE t.name GLOB ?4)");
+	}
+	strcat(sql, " ORDER BY time, id");
+
+	sqlite3_stmt *sel_reports = db_prepare(db, sql);
+	sqlite3_stmt *sel_suites = db_prepare(db,
+		"SELECT id, name, hostname, timestamp, n_failures, n_errors, time "
+		"FROM suites WHERE report_id = ? ORDER BY id");
+	sqlite3_stmt *sel_tests = db_prepare(db,
+		"SELECT name, time, status, comment, error, system_out, system_err, "
+		"duration FROM tests WHERE suite_id = ? ORDER BY id");
+	char *search = filter && filter->search ? glob_prefix(filter->search) :
+	    NULL;
+	struct reportq *reports = calloc(1, sizeof(struct reportq));
+	if (!sel_reports || !sel_suites || !sel_tests || !reports ||
+	    (filter && filter->search && !search)) {
+		free(search);
+		sqlite3_finalize(sel_reports);
+		sqlite3_finalize(sel_suites);
+		sqlite3_finalize(sel_tests);
+		sqlite3_close(db);
+		free(reports);
+		return NULL;
+	}
+	TAILQ_INIT(reports);
+
+	if (filter) {
+		sqlite3_bind_text(sel_reports, 1, filter->report_id, -1, SQLITE_STATIC);
+		sqlite3_bind_int64(sel_reports, 2, filter->since);
+		sqlite3_bind_text(sel_reports, 3, filter->test_name, -1, SQLITE_STATIC);
+		sqlite3_bind_text(sel_reports, 4, search, -1, free);
+	}
+	while (sqlite3_step(sel_reports) == SQLITE_ROW) {
+		tailq_report *report = calloc(1, sizeof(tailq_report));
+		if (report == NULL) {
+			perror("malloc failed");
+			break;
+		}
+		report->id = (unsigned char *)column_str(NULL, sel_reports, 1);
+		report->path = (unsigned char *)column_str(NULL, sel_reports, 2);
+		if (str_to_digest((char *)report->id, report->digest) != 0 &&
+		    report->path != NULL) {
+			/* an old id in a database not written since */
+			report_digest((char *)report->path, report->digest);
+		}
+		report->format = sqlite3_column_int(sel_reports, 3);
+		report->time = sqlite3_column_int64(sel_reports, 4);
+		report->summary.n_pass = sqlite3_column_int(sel_reports, 5);
+		report->summary.n_fail = sqlite3_column_int(sel_reports, 6);
+		report->summary.n_skip = sqlite3_column_int(sel_reports, 7);
+		if (summary) {
+			report->summary.n_total = sqlite3_column_int(sel_reports, 8);
+			report->summary.total_time = sqlite3_column_double(sel_reports, 9);
+			report->summary.slowest = column_name(sel_reports, 10);
+			report->summary.slowest_time = sqlite3_column_double(sel_reports, 11);
+		}
+		if ((filter == NULL || !filter->summary) &&
+		    (report->arena = arena_new()) != NULL) {
+			report->suites = db_load_suites(report->arena, sel_suites,
+					sel_tests, sqlite3_column_int64(sel_reports, 0));
+			if (!summary && report->suites != NULL) {
+				summarize_report(report);
+			}
+		}
+		TAILQ_INSERT_TAIL(reports, report, entries);
+	}
+
+	sqlite3_finalize(sel_reports);
+	sqlite3_finalize(sel_suites);
+	sqlite3_finalize(sel_tests);
+	sqlite3_close(db);
+
+	return reports;
+}
+
+#else	/* HAVE_SQLITE3 */
+
+struct reportq *
+process_db_filter(const char *path, struct db_filter *filter)
+{
+	fprintf(stderr, "built without SQLite support\n");
+	return NULL;
+}
+
+int
+db_store_reports(const char *path, struct reportq *reports)
+{
+	fprintf(stderr, "built without SQLite support\n");
+	return -1;
+}
+
+#endif	/* HAVE_SQLITE3 */
+
+struct reportq *
+process_db(const char *path)
+{
+	return process_db_filter(path, NULL);
+}
@@ -0,0 +1,260 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parse_common.h"
+#include "parse_subunit_v1.h"
+#include "parse_subunit_v2.h"
+#include "stream.h"
+
+struct tap_parser;
+extern struct tap_parser *tap_stream_new(test_result_cb cb, void *arg);
+extern size_t tap_stream_parse(struct tap_parser *ctx, const char *data,
+			       size_t len, bool eof);
+extern void tap_stream_flush(struct tap_parser *ctx);
+extern void tap_stream_free(struct tap_parser *ctx);
+
+/*
+ * Bytes that are not parsed yet are kept in a buffer, i.e. an incomplete
+ * line or packet and the beginning of a stream while its format is not
+ * known. A buffer grows only when a line or a packet is longer than it.
+ */
+struct test_stream {
+	enum test_format format;
+	test_result_cb cb;
+	void *arg;
+	union {
+		struct tap_parser *tap;
+		struct subunit_v1_parser *subunit_v1;
+		struct subunit_v2_parser *subunit_v2;
+	} parser;
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+struct test_stream *
+stream_new(test_result_cb cb, void *arg)
+{
+	struct test_stream *s = calloc(1, sizeof(struct test_stream));
+	if (s == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	s->format = FORMAT_UNKNOWN;
+	s->cb = cb;
+	s->arg = arg;
+
+	return s;
+}
+
+static int
+buffer_append(struct test_stream *s, const char *data, size_t len)
+{
+	if (s->len + len > s->size) {
+		size_t size = s->size ? s->size : 4096;
+		while (size < s->len + len) {
+			size *= 2;
+		}
+		char *buf = realloc(s->buf, size);
+		if (buf == NULL) {
+			perror("malloc failed");
+			return -1;
+		}
+		s->buf = buf;
+		s->size = size;
+	}
+	memcpy(s->buf + s->len, data, len);
+	s->len += len;
+
+	return 0;
+}
+
+/*
+ * A format is detected by complete lines, so that e.g. "ok" is not taken
+ * for TAP before the rest of a line arrives. 0 when more data is needed.
+ */
+static int
+detect(struct test_stream *s, bool eof)
+{
+	size_t n = s->len;
+	if (!eof && n < SNIFF_SIZE && n != 0 &&
+	    (uint8_t)s->buf[0] != SUBUNIT_SIGNATURE) {
+		while (n > 0 && s->buf[n - 1] != '\n') {
+			n--;
+		}
+	}
+
+	enum detect_confidence confidence;
+	enum test_format format = sniff_format(s->buf, n, &confidence);
+	if (format == FORMAT_UNKNOWN) {
+		if (!eof && s->len < SNIFF_SIZE) {
+			return 0;
+		}
+		fprintf(stderr, "Format of a stream is not recognized\n");
+		return -1;
+	}
+
+	int ok = 0;
+	switch (format) {
+	case FORMAT_TAP13:
+		s->parser.tap = tap_stream_new(s->cb, s->arg);
+		ok = s->parser.tap != NULL;
+		break;
+	case FORMAT_SUBUNIT_V1:
+		s->parser.subunit_v1 = subunit_v1_stream_new(s->cb, s->arg);
+		ok = s->parser.subunit_v1 != NULL;
+		break;
+	case FORMAT_SUBUNIT_V2:
+		s->parser.subunit_v2 = subunit_v2_stream_new(s->cb, s->arg);
+		ok = s->parser.subunit_v2 != NULL;
+		break;
+	case FORMAT_JUNIT:
+		fprintf(stderr, "JUnit reports can not be streamed\n");
+		break;
+	case FORMAT_UNKNOWN:
+		break;
+	}
+	if (!ok) {
+		return -1;
+	}
+	s->format = format;
+
+	return 1;
+}
+
+static size_t
+parse(struct test_stream *s, const char *data, size_t len, bool eof)
+{
+	switch (s->format) {
+	case FORMAT_TAP13:
+		return tap_stream_parse(s->parser.tap, data, len, eof);
+	case FORMAT_SUBUNIT_V1:
+		return subunit_v1_stream_parse(s->parser.subunit_v1, data, len,
+					       eof);
+	case FORMAT_SUBUNIT_V2:
+		return subunit_v2_stream_parse(s->parser.subunit_v2, data, len,
+					       eof);
+	case FORMAT_JUNIT:
+	case FORMAT_UNKNOWN:
+		break;
+	}
+
+	return 0;
+}
+
+/* -1 when a format of a stream is not recognized or on a memory error */
+int
+stream_feed(struct test_stream *s, const char *data, size_t len)
+{
+	if (s->format != FORMAT_UNKNOWN && s->len == 0) {
+		/* the common case, nothing is left from the last piece */
+		size_t used = parse(s, data, len, false);
+		return buffer_append(s, data + used, len - used);
+	}
+	if (buffer_append(s, data, len) != 0) {
+		return -1;
+	}
+	if (s->format == FORMAT_UNKNOWN) {
+		int rc = detect(s, false);
+		if (rc <= 0) {
+			return rc;
+		}
+	}
+	size_t used = parse(s, s->buf, s->len, false);
+	memmove(s->buf, s->buf + used, s->len - used);
+	s->len -= used;
+
+	return 0;
+}
+
+/*
+ * Nothing is read for a while. A TAP test may be followed by its YAML
+ * block, so a test that is waiting for one is reported now.
+ */
+void
+stream_idle(struct test_stream *s)
+{
+	if (s->format == FORMAT_TAP13) {
+		tap_stream_flush(s->parser.tap);
+	}
+}
+
+/* the end of a stream, the rest of a buffer is parsed */
+int
+stream_finish(struct test_stream *s)
+{
+	if (s->format == FORMAT_UNKNOWN) {
+		if (s->len == 0) {
+			return 0;
+		}
+		if (detect(s, true) <= 0) {
+			return -1;
+		}
+	}
+	parse(s, s->buf, s->len, true);
+	s->len = 0;
+	stream_idle(s);
+
+	return 0;
+}
+
+void
+stream_free(struct test_stream *s)
+{
+	if (s == NULL) {
+		return;
+	}
+	switch (s->format) {
+	case FORMAT_TAP13:
+		tap_stream_free(s->parser.tap);
+		break;
+	case FORMAT_SUBUNIT_V1:
+		subunit_v1_stream_free(s->parser.subunit_v1);
+		break;
+	case FORMAT_SUBUNIT_V2:
+		subunit_v2_stream_free(s->parser.subunit_v2);
+		break;
+	case FORMAT_JUNIT:
+	case FORMAT_UNKNOWN:
+		break;
+	}
+	free(s->buf);
+	free(s);
+}
+
+enum test_format
+stream_format(const struct test_stream *s)
+{
+	return s->format;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+
+#include "parse_common.h"
+
+/*
+ * A report that is still being written, e.g. to a pipe. Data is fed in
+ * pieces of any size, a format is detected by the first bytes and every
+ * finished test is passed to a callback right away. Finished tests are
+ * not kept, so memory does not grow with a length of a stream. JUnit is
+ * not supported, its tests are known only when a document is complete.
+ */
+
+struct test_stream;
+
+struct test_stream *stream_new(test_result_cb cb, void *arg);
+int stream_feed(struct test_stream *s, const char *data, size_t len);
+void stream_idle(struct test_stream *s);
+int stream_finish(struct test_stream *s);
+void stream_free(struct test_stream *s);
+enum test_format stream_format(const struct test_stream *s);
+
+#endif				/* STREAM_H */
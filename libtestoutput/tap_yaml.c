@@ -0,0 +1,298 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parse_common.h"
+#include "tap_yaml.h"
+
+struct line {
+	const char *start;	/* of the text after the indentation */
+	const char *end;	/* of the text without a line break */
+	const char *next;	/* the next line or NULL */
+	size_t indent;
+};
+
+static int
+next_line(const char *p, struct line *l)
+{
+	if (p == NULL || *p == '\0') {
+		return 0;
+	}
+	const char *end = strchr(p, '\n');
+	l->next = end != NULL ? end + 1 : NULL;
+	if (end == NULL) {
+		end = p + strlen(p);
+	}
+	if (end > p && end[-1] == '\r') {
+		end--;
+	}
+	l->indent = 0;
+	while (p < end && *p == ' ') {
+		p++;
+		l->indent++;
+	}
+	l->start = p;
+	l->end = end;
+
+	return 1;
+}
+
+static int
+is_blank_line(const struct line *l)
+{
+	return l->start == l->end || *l->start == '#';
+}
+
+/* indentation of keys of the top level */
+static size_t
+base_indent(const char *yaml)
+{
+	struct line l;
+	const char *p = yaml;
+	while (next_line(p, &l)) {
+		if (!is_blank_line(&l)) {
+			return l.indent;
+		}
+		p = l.next;
+	}
+
+	return 0;
+}
+
+/* splits "key: value", the value is empty for a nested block */
+static int
+split_key(const struct line *l, const char **colon)
+{
+	const char *p;
+	for (p = l->start; p < l->end; p++) {
+		if (*p == ':' && (p + 1 == l->end || p[1] == ' ')) {
+			*colon = p;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void
+trim(const char **start, const char **end)
+{
+	while (*start < *end && (**start == ' ' || **start == '\t')) {
+		(*start)++;
+	}
+	while (*end > *start && ((*end)[-1] == ' ' || (*end)[-1] == '\t')) {
+		(*end)--;
+	}
+}
+
+/*
+ * Duration of a test from the "duration_ms" key, this is the only value
+ * taken when a report is parsed. Returns 0 and the duration in
+ * milliseconds or -1 when there is no valid duration.
+ */
+int
+tap_yaml_duration(const char *yaml, double *ms)
+{
+	static const char key[] = "duration_ms";
+	size_t base = base_indent(yaml);
+	struct line l;
+	const char *p = yaml;
+	while (next_line(p, &l)) {
+		p = l.next;
+		const char *colon;
+		if (l.indent != base || (size_t)(l.end - l.start) < sizeof(key) ||
+		    memcmp(l.start, key, sizeof(key) - 1) != 0 ||
+		    !split_key(&l, &colon) || colon != l.start + sizeof(key) - 1) {
+			continue;
+		}
+		const char *v = colon + 1, *end = l.end;
+		trim(&v, &end);
+		if (end > v + 1 && (*v == '\'' || *v == '"') && end[-1] == *v) {
+			v++;
+			end--;
+		}
+		char buf[64];
+		if (v == end || (size_t)(end - v) >= sizeof(buf)) {
+			return -1;
+		}
+		memcpy(buf, v, end - v);
+		buf[end - v] = '\0';
+		const char *rest;
+		double value = parse_number(buf, &rest);
+		if (*rest != '\0' || !(value >= 0)) {
+			return -1;
+		}
+		*ms = value;
+		return 0;
+	}
+
+	return -1;
+}
+
+static char *
+unquote(const char *s, const char *end)
+{
+	char *value = malloc(end - s + 1);
+	if (value == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	char quote = end > s + 1 && (*s == '\'' || *s == '"') &&
+		     end[-1] == *s ? *s : '\0';
+	if (quote != '\0') {
+		s++;
+		end--;
+	}
+	char *d = value;
+	for (; s < end; s++) {
+		if (quote == '\'' && *s == '\'' && s + 1 < end && s[1] == '\'') {
+			s++;
+		} else if (quote == '"' && *s == '\\' && s + 1 < end) {
+			s++;
+			switch (*s) {
+			case 'n':
+				*d++ = '\n';
+				continue;
+			case 't':
+				*d++ = '\t';
+				continue;
+			default:
+				break;
+			}
+		}
+		*d++ = *s;
+	}
+	*d = '\0';
+
+	return value;
+}
+
+/*
+ * Lines of a nested block or a block scalar after a key. A literal block
+ * ('|') and a nested block keep line breaks, a folded one ('>') is joined
+ * with spaces. The common indentation is removed.
+ */
+static char *
+block_value(const char *p, size_t base, char style, const char **next)
+{
+	struct line l;
+	size_t indent = (size_t)-1, size = 1;
+	const char *q = p, *last = p;
+	while (next_line(q, &l) && (l.start == l.end || l.indent > base)) {
+		if (l.start != l.end) {
+			if (l.indent < indent) {
+				indent = l.indent;
+			}
+			last = l.next;
+		}
+		size += l.end - l.start + l.indent + 1;
+		q = l.next;
+	}
+	*next = last;
+
+	char *value = malloc(size);
+	if (value == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	char *d = value;
+	for (q = p; q != last && next_line(q, &l); q = l.next) {
+		if (d != value) {
+			*d++ = style == '>' ? ' ' : '\n';
+		}
+		if (l.start != l.end) {
+			size_t extra = l.indent - indent;
+			memset(d, ' ', extra);
+			d += extra;
+			memcpy(d, l.start, l.end - l.start);
+			d += l.end - l.start;
+		}
+	}
+	*d = '\0';
+
+	return value;
+}
+
+/* keys and values of a block, free them with tap_yaml_free() */
+struct tap_yaml_item *
+tap_yaml_parse(const char *yaml, size_t *n)
+{
+	struct tap_yaml_item *items = NULL;
+	size_t cap = 0;
+	size_t base = base_indent(yaml);
+	struct line l;
+	const char *p = yaml;
+	*n = 0;
+	while (next_line(p, &l)) {
+		p = l.next;
+		const char *colon;
+		if (is_blank_line(&l) || l.indent != base || !split_key(&l, &colon)) {
+			continue;
+		}
+		if (*n == cap) {
+			cap = cap ? cap * 2 : 8;
+			struct tap_yaml_item *tmp = realloc(items, cap * sizeof(*items));
+			if (tmp == NULL) {
+				perror("malloc failed");
+				break;
+			}
+			items = tmp;
+		}
+		struct tap_yaml_item *item = &items[*n];
+		const char *v = colon + 1, *end = l.end;
+		trim(&v, &end);
+		item->key = unquote(l.start, colon);
+		if (v == end || *v == '|' || *v == '>') {
+			item->value = block_value(p, base, v == end ? '\0' : *v, &p);
+		} else {
+			item->value = unquote(v, end);
+		}
+		if (item->key == NULL || item->value == NULL) {
+			free(item->key);
+			free(item->value);
+			break;
+		}
+		(*n)++;
+	}
+
+	return items;
+}
+
+void
+tap_yaml_free(struct tap_yaml_item *items, size_t n)
+{
+	size_t i;
+	for (i = 0; i < n; i++) {
+		free(items[i].key);
+		free(items[i].value);
+	}
+	free(items);
+}
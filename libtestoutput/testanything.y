@@ -26,39 +26,95 @@
  *
  */
 
+%code requires {
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <parse_common.h>
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+/* state of a single parse, see parse_testanything_arena() */
+struct tap_parser {
+	struct arena *arena;	/* owner of a parsed report, NULL - the heap */
+	struct tailq_suite *cur_suite;
+	struct tailq_test *cur_test;
+	bool is_bailout;
+	bool is_test;
+	long tc_planned;
+	long tc_current;
+	long tc_processed;
+	char *string;		/* words collected so far */
+	char *name;		/* a name of a plain result line */
+	size_t name_size;
+	yyscan_t scanner;
+	int lineno;		/* of the next line to parse */
+	bool failed;		/* the grammar gave up, the rest is dropped */
+	bool rejected;		/* not a report of a known version */
+	test_result_cb on_test;	/* a live stream, tests are not kept */
+	void *arg;
+	tailq_test pending;	/* a live test, its YAML block may follow */
+	bool has_pending;
+	char *pending_name;
+	size_t pending_name_size;
+};
+}
+
 %{
-#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <strings.h>
 
 #include <parse_common.h>
+#include "arena.h"
+#include "intern.h"
 #include "parse_testanything.tab.h"
+#include "tap_yaml.h"
 
-struct suiteq *parse_testanything(FILE *f);
-void yyerror(const char *);
-int yylex(void);
-static void set_missed_status(long tc_missed);
+/* versions of the protocol that are understood */
+#define TAP_VERSION_MIN	13
+#define TAP_VERSION_MAX	14
 
-static tailq_test *create_new_test(void);
-static tailq_suite *create_new_suite(void);
+/* at most this many tests are recorded for numbers a report skips or
+   for planned tests after a bail out */
+#define TAP_MAX_GAP	1024
 
-static tailq_suite *cur_suite = NULL;
-static tailq_test *cur_test = NULL;
-struct suiteq *suites = NULL;
-
-static bool is_bailout = false;
-static bool is_test = false;
-
-static long tc_planned = 0;
-static long tc_current = 0;
-static long tc_processed = 0;
-
-static char *string = NULL, *word = NULL, *number = NULL;
-
-static tailq_test *create_new_test(void) {
+struct suiteq *parse_testanything(FILE *f);
+struct suiteq *parse_testanything_arena(FILE *f, struct arena *a);
+struct suiteq *parse_testanything_buffer(const char *data, size_t len,
+					 struct arena *a);
+void testanything_set_fast_path(bool enable);
+struct tap_parser *tap_stream_new(test_result_cb cb, void *arg);
+size_t tap_stream_parse(struct tap_parser *ctx, const char *data, size_t len,
+			bool eof);
+void tap_stream_flush(struct tap_parser *ctx);
+void tap_stream_free(struct tap_parser *ctx);
+
+/* the reentrant scanner of testanything.l */
+int yylex(YYSTYPE *yylval_param, yyscan_t yyscanner);
+int yylex_init(yyscan_t *scanner);
+int yylex_destroy(yyscan_t yyscanner);
+int yyget_lineno(yyscan_t yyscanner);
+int tap_parse_lines(const char *data, size_t len, int lineno,
+		    struct tap_parser *ctx, yyscan_t yyscanner);
+
+void yyerror(yyscan_t scanner, struct tap_parser *ctx, const char *s);
+static void set_missed_status(struct tap_parser *ctx, long tc_missed);
+static void note_number(struct tap_parser *ctx, long number);
+
+static tailq_test *create_new_test(struct tap_parser *ctx);
+static tailq_suite *create_new_suite(struct tap_parser *ctx);
+static char *take_string(struct tap_parser *ctx);
+static const char *take_name(struct tap_parser *ctx);
+
+static tailq_test *create_new_test(struct tap_parser *ctx) {
    tailq_test *test_item = NULL;
-   test_item = calloc(1, sizeof(tailq_test));
+   test_item = arena_alloc(ctx->arena, sizeof(tailq_test));
    if (test_item == NULL) {
       perror("calloc");
       return NULL;
@@ -67,18 +123,20 @@ static tailq_test *create_new_test(void) {
    return test_item;
 }
 
-static tailq_suite *create_new_suite(void) {
+static tailq_suite *create_new_suite(struct tap_parser *ctx) {
    tailq_suite *test_suite = NULL;
-   test_suite = calloc(1, sizeof(tailq_suite));
+   test_suite = arena_alloc(ctx->arena, sizeof(tailq_suite));
    if (!test_suite) {
       perror("calloc");
       return NULL;
    }
 
-   test_suite->tests = calloc(1, sizeof(struct testq));
+   test_suite->tests = arena_alloc(ctx->arena, sizeof(struct testq));
    if (!test_suite->tests) {
       perror("calloc");
-      free_suite(test_suite);
+      if (ctx->arena == NULL) {
+         free_suite(test_suite);
+      }
       return NULL;
    }
    TAILQ_INIT(test_suite->tests);
@@ -86,18 +144,126 @@ static tailq_suite *create_new_suite(void) {
    return test_suite;
 }
 
-static void set_missed_status(long tc_missed) {
+/* a string collected from words is moved to an arena */
+static char *take_string(struct tap_parser *ctx) {
+   char *s = ctx->string;
+   ctx->string = NULL;
+   if (ctx->arena != NULL && s != NULL) {
+      char *copy = arena_strdup(ctx->arena, s);
+      free(s);
+      s = copy;
+   }
+
+   return s;
+}
+
+/* a name of a live test is not interned, it is valid till the next test */
+static const char *keep_name(struct tap_parser *ctx, const char *s,
+                             size_t len) {
+   if (s == NULL) {
+      return NULL;
+   }
+   if (len + 1 > ctx->pending_name_size) {
+      char *name = realloc(ctx->pending_name, len + 1);
+      if (name == NULL) {
+         perror("malloc failed");
+         return NULL;
+      }
+      ctx->pending_name = name;
+      ctx->pending_name_size = len + 1;
+   }
+   memcpy(ctx->pending_name, s, len);
+   ctx->pending_name[len] = '\0';
+
+   return ctx->pending_name;
+}
+
+/* names of tests are interned, see intern.h */
+static const char *take_name(struct tap_parser *ctx) {
+   const char *name;
+   if (ctx->on_test != NULL) {
+      name = keep_name(ctx, ctx->string,
+                       ctx->string != NULL ? strlen(ctx->string) : 0);
+   } else {
+      name = intern(ctx->string);
+   }
+   free(ctx->string);
+   ctx->string = NULL;
+
+   return name;
+}
+
+static void report_pending(struct tap_parser *ctx) {
+   if (ctx->has_pending) {
+      ctx->has_pending = false;
+      ctx->on_test(&ctx->pending, ctx->arg);
+   }
+}
+
+/* a test of a live stream is reported when the next line is read */
+static void insert_test(struct tap_parser *ctx, tailq_test *test) {
+   if (ctx->on_test == NULL) {
+      TAILQ_INSERT_TAIL(ctx->cur_suite->tests, test, entries);
+      return;
+   }
+   report_pending(ctx);
+   memset(&ctx->pending, 0, sizeof(ctx->pending));
+   ctx->pending.name = test->name;
+   ctx->pending.status = test->status;
+   ctx->has_pending = true;
+   free_test(test);
+}
+
+/* planned tests that have not run before a bail out are skipped */
+static void set_missed_status(struct tap_parser *ctx, long tc_missed) {
    long i = 0;
-   for(i = 0; i <= tc_missed; i++) {
-      tailq_test *test = create_new_test();
+   if (tc_missed > TAP_MAX_GAP) {
+      tc_missed = TAP_MAX_GAP;
+   }
+   for(i = 0; i < tc_missed; i++) {
+      tailq_test *test = create_new_test(ctx);
+      if (test == NULL) {
+         break;
+      }
       test->name = NULL;
       test->status = STATUS_SKIP;
-      TAILQ_INSERT_TAIL(cur_suite->tests, test, entries);
+      insert_test(ctx, test);
+   }
+}
+
+/*
+ * Tests are numbered from 1 in order. Numbers a report skips are tests
+ * that have not run, they are recorded as missing. A test out of order or
+ * with a number seen before is kept as it is.
+ */
+static void note_number(struct tap_parser *ctx, long number) {
+   unsigned long missed = 0;
+   if (number > ctx->tc_processed) {
+      missed = (unsigned long)(number - ctx->tc_processed) - 1;
+   }
+   if (missed > TAP_MAX_GAP) {
+      missed = TAP_MAX_GAP;
+   }
+   for (; missed > 0; missed--) {
+      tailq_test *test = create_new_test(ctx);
+      if (test == NULL) {
+         break;
+      }
+      test->status = STATUS_MISSING;
+      insert_test(ctx, test);
+   }
+   if (number > ctx->tc_processed) {
+      ctx->tc_processed = number;
    }
+   ctx->tc_current = number;
 }
 
 %}
 
+%define api.pure full
+%param {yyscan_t scanner}
+%parse-param {struct tap_parser *ctx}
+
 %token NOT OK BAILOUT SKIP TODO
 %token HASH DASH PLAN TAP_VERSION
 %token WORD NUMBER NL YAML_START YAML_END
@@ -114,98 +280,130 @@ static void set_missed_status(long tc_missed) {
 %type <string> 		string
 %type <string> 		status
 
+/* words that are dropped on a syntax error */
+%destructor { free($$); } WORD PLAN
+
 %%
 program		: program test_line
-		| error NL { yyerrok; }
+		| error NL {
+			/* a test and words of a broken line are dropped */
+			if (ctx->cur_test != NULL && ctx->arena == NULL) {
+				free_test(ctx->cur_test);
+			}
+			ctx->cur_test = NULL;
+			free(ctx->string);
+			ctx->string = NULL;
+			yyerrok;
+		}
 		|
 		;
 
 test_line	: TAP_VERSION NUMBER NL {
-			int version = $2;
-			assert(version == 13);
+			if ($2 < TAP_VERSION_MIN || $2 > TAP_VERSION_MAX) {
+				yyerror(scanner, ctx, "unsupported TAP version");
+				ctx->rejected = true;
+				YYABORT;
+			}
 		}
 		| PLAN comment NL {
-			if (sscanf($1, "1..%ld", &tc_planned) != 1) {
+			int n = sscanf($1, "1..%ld", &ctx->tc_planned);
+			free($1);
+			if (n != 1) {
 			   perror("sscanf");
 			   return -1;
 			}
 		}
 		| status test_number description comment NL {
-			cur_test->time = NULL;
-			TAILQ_INSERT_TAIL(cur_suite->tests, cur_test, entries);
-			cur_test = NULL;
-			is_test = false;
-		}
-		| comment NL {
-			fprintf(stderr, "COMMENT\n");
+			ctx->cur_test->time = NULL;
+			insert_test(ctx, ctx->cur_test);
+			ctx->cur_test = NULL;
+			ctx->is_test = false;
 		}
+		| comment NL
 		| BAILOUT string NL {
-			fprintf(stderr, "BAIL OUT!\n");
-			is_bailout = true;
-			set_missed_status(tc_planned - tc_current);
-			string = NULL;
-		}
-		| YAML_START NL yaml_strings YAML_END NL {
-			fprintf(stderr, "YAML\n");
+			ctx->is_bailout = true;
+			set_missed_status(ctx, ctx->tc_planned - ctx->tc_current);
+			free(ctx->string);
+			ctx->string = NULL;
 		}
 		;
 
 comment	: HASH directive string {
-			cur_test->comment = string;
-			string = NULL;
+			/* a comment of a test or a line of its own */
+			char *comment = take_string(ctx);
+			if (ctx->cur_test != NULL) {
+				ctx->cur_test->comment = comment;
+			} else if (ctx->arena == NULL) {
+				free(comment);
+			}
 		}
 		|
 		;
 
 test_number	: NUMBER {
-		tc_current = $1;
-		assert(tc_current == tc_processed);
+		note_number(ctx, $1);
 		}
 		;
 
 description	: string {
-		cur_test->name = string;
-		string = NULL;
+		ctx->cur_test->name = take_name(ctx);
 		}
 		| DASH string {
-		cur_test->name = string;
-		string = NULL;
+		ctx->cur_test->name = take_name(ctx);
 		}
 		|
 		;
 
 status	: OK {
-		cur_test = create_new_test();
-		cur_test->status = STATUS_PASS;
-		tc_processed++;
-		is_test = true;
+		report_pending(ctx);
+		ctx->cur_test = create_new_test(ctx);
+		if (ctx->cur_test == NULL) {
+			YYABORT;
+		}
+		ctx->cur_test->status = STATUS_PASS;
+		ctx->is_test = true;
 		}
 		| NOT OK {
-		cur_test = create_new_test();
-		cur_test->status = STATUS_FAILED;
-		tc_processed++;
-		is_test = true;
+		report_pending(ctx);
+		ctx->cur_test = create_new_test(ctx);
+		if (ctx->cur_test == NULL) {
+			YYABORT;
+		}
+		ctx->cur_test->status = STATUS_FAILED;
+		ctx->is_test = true;
 		}
 		;
 
 directive	: TODO {
-		cur_test->status = STATUS_TODO;
+		if (ctx->cur_test != NULL) {
+			ctx->cur_test->status = STATUS_TODO;
+		}
 		}
 		| SKIP {
-		cur_test->status = STATUS_SKIP;
+		if (ctx->cur_test != NULL) {
+			ctx->cur_test->status = STATUS_SKIP;
+		}
 		}
 		|
 		;
 
 string	: string WORD {
-		word = $2;
-		if (string == NULL) {
-		    string = strdup(word);
+		char *word = $2;
+		if (ctx->string == NULL) {
+		    ctx->string = word;
 		} else {
-		    string = realloc(string, strlen(string) + strlen(word) + 2);
-		    sprintf(string, "%s %s", string, word);
-                    free(word);
-                }
+		    size_t len = strlen(ctx->string);
+		    char *string = realloc(ctx->string, len + strlen(word) + 2);
+		    if (string == NULL) {
+			perror("malloc failed");
+			free(word);
+			YYABORT;
+		    }
+		    string[len] = ' ';
+		    strcpy(string + len + 1, word);
+		    ctx->string = string;
+		    free(word);
+		}
 		}
 		| string NUMBER {
 /*
@@ -222,56 +420,474 @@ string	: string WORD {
 		|
 		;
 
-yaml_strings: yaml_strings string NL
-		|
-		;
 %%
 
-#include <ctype.h>
-#include <sys/queue.h>
+void yyerror(yyscan_t scanner, struct tap_parser *ctx, const char *s)
+{
+    fprintf(stderr, "Warning: %s, line %d\n", s, yyget_lineno(scanner));
+}
+
+
+#define TAP_BUFFER_SIZE (64 * 1024)
 
-extern int yylex();
-extern int yyparse();
-extern int yylineno;
-extern FILE *yyin;
+/* lines of a report are turned into tests without the grammar when possible */
+static bool tap_fast_path = true;
 
-void yyerror(const char *s)
+void testanything_set_fast_path(bool enable)
 {
-    fprintf(stderr, "Warning: %s, line %d\n", s, yylineno);
+    tap_fast_path = enable;
 }
 
-struct suiteq *parse_testanything(FILE *f) {
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t';
+}
 
-  if (f == NULL) {
-    return NULL;
-  }
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
 
-  is_bailout = false;
-  is_test = false;
+/* [[:alpha:][:punct:]] of the scanner, words are made of these */
+static bool is_symbol(char c)
+{
+    return c > ' ' && c < 0x7f && !is_digit(c);
+}
 
-  tc_planned = 0;
-  tc_current = 0;
-  tc_processed = 0;
+/* the end of a number or NULL when the scanner takes it for a plan */
+static const char *skip_number(const char *p, const char *end)
+{
+    if (end - p > 3 && p[1] == '.' && p[2] == '.' && is_digit(p[3])) {
+        return NULL;
+    }
+    while (p < end && is_digit(*p)) {
+        p++;
+    }
+
+    return p;
+}
 
-  cur_suite = create_new_suite();
-  if (!cur_suite) {
-      return NULL;
-  }
-
-  yyin = f;
-  yylineno = 1;
-  yyparse();
-
-  suites = calloc(1, sizeof(struct suiteq));
-  if (!suites) {
-    perror("calloc");
-    free_tests(cur_suite->tests);
-    free_suite(cur_suite);
-    return NULL;
-  }
-  TAILQ_INIT(suites);
-  TAILQ_INSERT_TAIL(suites, cur_suite, entries);
-  free(string);
-
-  return suites;
+/* a word that is a token of the scanner or starts one */
+static bool is_keyword(const char *w, size_t len)
+{
+    switch (len) {
+    case 1:
+        return *w == '-' || *w == '#';
+    case 2:
+        return memcmp(w, "ok", 2) == 0;
+    case 3:
+        return memcmp(w, "not", 3) == 0 || memcmp(w, "---", 3) == 0 ||
+               memcmp(w, "...", 3) == 0;
+    case 4:
+        return memcmp(w, "TODO", 4) == 0 || strncasecmp(w, "skip", 4) == 0 ||
+               memcmp(w, "Bail", 4) == 0;
+    case 7:
+        return strncasecmp(w, "skipped", 7) == 0;
+    default:
+        return false;
+    }
+}
+
+/*
+ * A plain result line "ok N - description" or "not ok N description"
+ * without a directive. The name is the one the grammar makes: words are
+ * joined with a single space and numbers are dropped. It is left in
+ * ctx->name, anything unusual is left to the grammar.
+ */
+static bool scan_plain_line(struct tap_parser *ctx, const char *p,
+                            const char *end, enum test_status *status,
+                            long *number, size_t *name_len)
+{
+    *status = STATUS_PASS;
+    if (end - p > 3 && memcmp(p, "not", 3) == 0 && is_blank(p[3])) {
+        *status = STATUS_FAILED;
+        for (p += 3; p < end && is_blank(*p); p++);
+    }
+    if (end - p < 3 || p[0] != 'o' || p[1] != 'k' || !is_blank(p[2])) {
+        return false;
+    }
+    for (p += 2; p < end && is_blank(*p); p++);
+
+    const char *digits = p;
+    if (p == end || !is_digit(*p) || (p = skip_number(p, end)) == NULL ||
+        p - digits > 9) {
+        return false;
+    }
+    *number = 0;
+    for (; digits < p; digits++) {
+        *number = *number * 10 + (*digits - '0');
+    }
+
+    size_t len = 0;
+    bool first = true;
+    while (p < end) {
+        if (is_blank(*p)) {
+            p++;
+            continue;
+        }
+        if (is_digit(*p)) {
+            if ((p = skip_number(p, end)) == NULL) {
+                return false;
+            }
+            first = false;
+            continue;
+        }
+        if (!is_symbol(*p)) {
+            return false;
+        }
+        const char *word = p;
+        while (p < end && is_symbol(*p)) {
+            p++;
+        }
+        size_t word_len = p - word;
+        if (first && word_len == 1 && *word == '-') {
+            first = false;
+            continue;
+        }
+        first = false;
+        if (is_keyword(word, word_len)) {
+            return false;
+        }
+        if (len != 0) {
+            ctx->name[len++] = ' ';
+        }
+        memcpy(ctx->name + len, word, word_len);
+        len += word_len;
+    }
+    *name_len = len;
+
+    return true;
+}
+
+/* a test of a plain result line, its number is checked as in the grammar */
+static bool add_plain_test(struct tap_parser *ctx, enum test_status status,
+                           long number, size_t name_len)
+{
+    tailq_test *test = create_new_test(ctx);
+    if (test == NULL) {
+        return false;
+    }
+    test->status = status;
+    note_number(ctx, number);
+    if (ctx->on_test != NULL) {
+        report_pending(ctx);
+        if (name_len != 0) {
+            test->name = keep_name(ctx, ctx->name, name_len);
+        }
+    } else if (name_len != 0) {
+        test->name = intern_len(ctx->name, name_len);
+    }
+    insert_test(ctx, test);
+    ctx->cur_test = NULL;
+
+    return true;
+}
+
+static bool is_yaml_mark(const char *p, const char *end, bool end_mark)
+{
+    for (; p < end && is_blank(*p); p++);
+    for (; end > p && is_blank(end[-1]); end--);
+
+    return end - p == 3 && (memcmp(p, "---", 3) == 0 ||
+                            (end_mark && memcmp(p, "...", 3) == 0));
+}
+
+static void parse_run(struct tap_parser *ctx, const char *run,
+                      const char *end, int lineno)
+{
+    if (run < end && !ctx->failed &&
+        tap_parse_lines(run, end - run, lineno, ctx, ctx->scanner) != 0) {
+        ctx->failed = true;
+    }
+}
+
+static bool grow_name(struct tap_parser *ctx, size_t size)
+{
+    if (size <= ctx->name_size) {
+        return true;
+    }
+    if (size < ctx->name_size * 2) {
+        size = ctx->name_size * 2;
+    }
+    char *name = realloc(ctx->name, size);
+    if (name == NULL) {
+        perror("malloc failed");
+        return false;
+    }
+    ctx->name = name;
+    ctx->name_size = size;
+
+    return true;
+}
+
+/* a YAML block belongs to the test before it */
+static void add_diagnostics(struct tap_parser *ctx, const char *text,
+                            size_t len)
+{
+    tailq_test *test;
+    if (ctx->on_test != NULL) {
+        test = ctx->has_pending ? &ctx->pending : NULL;
+    } else {
+        test = TAILQ_LAST(ctx->cur_suite->tests, testq);
+    }
+    if (test == NULL || test->diagnostics != NULL) {
+        return;
+    }
+    char *yaml = arena_strndup(ctx->arena, text, len);
+    double ms;
+    if (yaml != NULL && tap_yaml_duration(yaml, &ms) == 0) {
+        test->duration = ms / 1000;
+        if (ctx->on_test == NULL) {
+            char time[32];
+            snprintf(time, sizeof(time), "%g", test->duration);
+            test->time = arena_strdup(ctx->arena, time);
+        }
+    }
+    if (ctx->on_test != NULL) {
+        /* only a duration of a live test is needed */
+        free(yaml);
+    } else {
+        test->diagnostics = yaml;
+    }
+}
+
+/*
+ * The end of a YAML block that starts at p or NULL when it is not read
+ * yet. A block is kept as is, only its duration is taken now.
+ */
+static const char *parse_yaml(struct tap_parser *ctx, const char *p,
+                              const char *end, bool eof, int *lines)
+{
+    const char *block = p;
+    *lines = 0;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (nl == NULL && !eof) {
+            return NULL;
+        }
+        const char *next = nl != NULL ? nl + 1 : end;
+        ++*lines;
+        if (is_yaml_mark(p, nl != NULL ? nl : end, true)) {
+            add_diagnostics(ctx, block, p - block);
+            return next;
+        }
+        p = next;
+    }
+    if (!eof) {
+        return NULL;
+    }
+    add_diagnostics(ctx, block, end - block);
+
+    return end;
+}
+
+/*
+ * Parses complete lines of data and returns the number of bytes used.
+ * Runs of lines that are not plain results go to the grammar at once.
+ */
+static size_t parse_lines(struct tap_parser *ctx, const char *data,
+                          size_t len, bool eof)
+{
+    const char *p = data, *end = data + len;
+    const char *run = data;
+    int line = ctx->lineno, run_line = line;
+    while (p < end && !ctx->failed) {
+        const char *nl = memchr(p, '\n', end - p);
+        if (nl == NULL && !eof) {
+            break;
+        }
+        const char *next = nl != NULL ? nl + 1 : end;
+        enum test_status status;
+        long number;
+        size_t name_len;
+        if (tap_fast_path && nl != NULL && grow_name(ctx, nl - p) &&
+            scan_plain_line(ctx, p, nl, &status, &number, &name_len)) {
+            parse_run(ctx, run, p, run_line);
+            if (add_plain_test(ctx, status, number, name_len)) {
+                run = next;
+                run_line = line + 1;
+            } else {
+                run = p;
+                run_line = line;
+            }
+        } else if (nl != NULL && is_yaml_mark(p, nl, false)) {
+            parse_run(ctx, run, p, run_line);
+            int lines;
+            const char *after = parse_yaml(ctx, next, end, eof, &lines);
+            if (after == NULL) {
+                /* the block is taken when its end is read */
+                ctx->lineno = line;
+                return p - data;
+            }
+            next = after;
+            line += lines;
+            run = next;
+            run_line = line + 1;
+        }
+        p = next;
+        line++;
+    }
+    parse_run(ctx, run, p, run_line);
+    ctx->lineno = line;
+
+    return p - data;
+}
+
+static bool parser_init(struct tap_parser *ctx, struct arena *a)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->arena = a;
+    ctx->lineno = 1;
+    ctx->cur_suite = create_new_suite(ctx);
+    if (ctx->cur_suite == NULL) {
+        return false;
+    }
+    if (yylex_init(&ctx->scanner) != 0) {
+        perror("yylex_init");
+        if (a == NULL) {
+            free_suite(ctx->cur_suite);
+        }
+        return false;
+    }
+
+    return true;
+}
+
+static struct suiteq *parser_finish(struct tap_parser *ctx)
+{
+    yylex_destroy(ctx->scanner);
+    free(ctx->pending_name);
+    if (ctx->cur_test != NULL && ctx->arena == NULL) {
+        /* a test on a line the grammar has not finished */
+        free_test(ctx->cur_test);
+    }
+    free(ctx->string);
+    free(ctx->name);
+    if (ctx->rejected) {
+        if (ctx->arena == NULL) {
+            free_tests(ctx->cur_suite->tests);
+            free_suite(ctx->cur_suite);
+        }
+        return NULL;
+    }
+
+    struct suiteq *suites = arena_alloc(ctx->arena, sizeof(struct suiteq));
+    if (!suites) {
+        perror("calloc");
+        if (ctx->arena == NULL) {
+            free_tests(ctx->cur_suite->tests);
+            free_suite(ctx->cur_suite);
+        }
+        return NULL;
+    }
+    TAILQ_INIT(suites);
+    TAILQ_INSERT_TAIL(suites, ctx->cur_suite, entries);
+
+    return suites;
+}
+
+struct suiteq *parse_testanything(FILE *f)
+{
+    return parse_testanything_arena(f, NULL);
+}
+
+/* all state of a parse is in the context, so parses may run concurrently */
+struct suiteq *parse_testanything_arena(FILE *f, struct arena *a)
+{
+    if (f == NULL) {
+        return NULL;
+    }
+
+    struct tap_parser ctx;
+    if (!parser_init(&ctx, a)) {
+        return NULL;
+    }
+    size_t size = TAP_BUFFER_SIZE, len = 0;
+    char *buf = malloc(size);
+    if (buf == NULL) {
+        perror("malloc failed");
+        return parser_finish(&ctx);
+    }
+    bool eof = false;
+    while (!eof && !ctx.failed) {
+        if (len == size) {
+            char *p = realloc(buf, size * 2);
+            if (p == NULL) {
+                perror("malloc failed");
+                free(buf);
+                return parser_finish(&ctx);
+            }
+            buf = p;
+            size *= 2;
+        }
+        size_t n = fread(buf + len, 1, size - len, f);
+        len += n;
+        eof = n == 0 || feof(f);
+        size_t used = parse_lines(&ctx, buf, len, eof);
+        memmove(buf, buf + used, len - used);
+        len -= used;
+    }
+    free(buf);
+
+    return parser_finish(&ctx);
+}
+
+struct suiteq *parse_testanything_buffer(const char *data, size_t len,
+                                         struct arena *a)
+{
+    struct tap_parser ctx;
+    if (!parser_init(&ctx, a)) {
+        return NULL;
+    }
+    parse_lines(&ctx, data, len, true);
+
+    return parser_finish(&ctx);
+}
+
+/*
+ * A live stream, every test is passed to a callback. A test is reported
+ * when the next line is read, because a YAML block with its duration may
+ * follow it, or by tap_stream_flush() when nothing is read for a while.
+ */
+struct tap_parser *tap_stream_new(test_result_cb cb, void *arg)
+{
+    struct tap_parser *ctx = malloc(sizeof(*ctx));
+    if (ctx == NULL) {
+        perror("malloc failed");
+        return NULL;
+    }
+    if (!parser_init(ctx, NULL)) {
+        free(ctx);
+        return NULL;
+    }
+    ctx->on_test = cb;
+    ctx->arg = arg;
+
+    return ctx;
+}
+
+/* complete lines of data, returns a number of bytes used */
+size_t tap_stream_parse(struct tap_parser *ctx, const char *data, size_t len,
+                        bool eof)
+{
+    return parse_lines(ctx, data, len, eof);
+}
+
+void tap_stream_flush(struct tap_parser *ctx)
+{
+    report_pending(ctx);
+}
+
+void tap_stream_free(struct tap_parser *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+    report_pending(ctx);
+    struct suiteq *suites = parser_finish(ctx);
+    if (suites != NULL) {
+        free_suites(suites);
+        free(suites);
+    }
+    free(ctx);
 }
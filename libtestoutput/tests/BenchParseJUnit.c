@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arena.h"
+#include "parse_common.h"
+#include "parse_junit.h"
+
+/*
+ * Throughput of the JUnit parser with the scanner and with expat alone.
+ * Usage: BenchParseJUnit [report.xml | size_in_mb]
+ */
+
+#define DEFAULT_SIZE_MB 64
+#define ROUNDS 5
+
+static char *read_report(const char *path, size_t *len)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror("fopen");
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    *len = ftell(file);
+    rewind(file);
+    char *data = malloc(*len);
+    if (data == NULL || fread(data, 1, *len, file) != *len) {
+        perror("read");
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+
+    return data;
+}
+
+/* a report with passed and failed tests and their output */
+static char *make_report(size_t size, size_t *len)
+{
+    char *data = malloc(size + 4096);
+    if (data == NULL) {
+        perror("malloc failed");
+        return NULL;
+    }
+    char *p = data;
+    p += sprintf(p, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                    "<testsuites>\n<testsuite name=\"bench\" tests=\"0\" "
+                    "timestamp=\"2020-05-01T10:00:00\" time=\"1.0\">\n");
+    int i;
+    for (i = 0; (size_t)(p - data) < size; i++) {
+        p += sprintf(p, "  <testcase classname=\"bench.Case%d\" name=\"test_%d\" "
+                        "time=\"0.%03d\">\n", i % 100, i, i % 1000);
+        if (i % 10 == 0) {
+            p += sprintf(p, "    <failure message=\"assertion failed\">"
+                            "expected &lt;1&gt; but was &lt;2&gt;\n"
+                            "  at bench.Case%d.test_%d(Case.java:%d)\n"
+                            "    </failure>\n", i % 100, i, i % 500);
+        }
+        p += sprintf(p, "    <system-out>");
+        int j;
+        for (j = 0; j < 8; j++) {
+            p += sprintf(p, "[%06d] step %d of test_%d is done in %d ms\n",
+                         j, j, i, (i * 7 + j) % 100);
+        }
+        p += sprintf(p, "</system-out>\n  </testcase>\n");
+    }
+    p += sprintf(p, "</testsuite>\n</testsuites>\n");
+    *len = p - data;
+
+    return data;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the best of a few rounds, GB/s */
+static double bench(const char *data, size_t len, int use_expat)
+{
+    struct junit_opts opts = { JUNIT_TEXT_LIMIT, 0, use_expat };
+    junit_set_opts(&opts);
+    double best = 0;
+    int i;
+    for (i = 0; i < ROUNDS; i++) {
+        struct arena *arena = arena_new();
+        double start = now();
+        struct suiteq *suites = parse_junit_buffer(data, len, arena);
+        double elapsed = now() - start;
+        arena_free(arena);
+        if (suites == NULL) {
+            fprintf(stderr, "Report is not parsed\n");
+            return 0;
+        }
+        if (i == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    return len / best / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t len = 0;
+    char *data;
+    if (argc > 1 && strspn(argv[1], "0123456789") != strlen(argv[1])) {
+        data = read_report(argv[1], &len);
+    } else {
+        size_t mb = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_SIZE_MB;
+        data = make_report(mb * 1024 * 1024, &len);
+    }
+    if (data == NULL) {
+        return 1;
+    }
+
+    double expat = bench(data, len, 1);
+    double scanner = bench(data, len, 0);
+    printf("report: %zu bytes\n", len);
+    printf("expat:   %.3f GB/s\n", expat);
+    printf("scanner: %.3f GB/s (%.1fx)\n", scanner,
+           expat > 0 ? scanner / expat : 0);
+    free(data);
+
+    return 0;
+}
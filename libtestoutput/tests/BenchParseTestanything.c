@@ -0,0 +1,132 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arena.h"
+#include "parse_common.h"
+
+/*
+ * Throughput of the TAP parser with the fast path for plain result lines
+ * and with the grammar alone.
+ * Usage: BenchParseTestanything [report.tap | number_of_lines]
+ */
+
+#define DEFAULT_LINES 1000000
+#define ROUNDS 3
+
+extern struct suiteq *parse_testanything_buffer(const char *data, size_t len,
+						struct arena *arena);
+extern void testanything_set_fast_path(bool enable);
+
+static char *read_report(const char *path, size_t *len)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror("fopen");
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    *len = ftell(file);
+    rewind(file);
+    char *data = malloc(*len);
+    if (data == NULL || fread(data, 1, *len, file) != *len) {
+        perror("read");
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+
+    return data;
+}
+
+/* mostly plain results with a few directives, comments and YAML blocks */
+static char *make_report(size_t lines, size_t *len)
+{
+    char *data = malloc(lines * 80 + 64);
+    if (data == NULL) {
+        perror("malloc failed");
+        return NULL;
+    }
+    char *p = data;
+    p += sprintf(p, "TAP version 13\n1..%zu\n", lines);
+    size_t i;
+    for (i = 1; i <= lines; i++) {
+        if (i % 1000 == 0) {
+            p += sprintf(p, "not ok %zu - case_%zu fails\n"
+                            "  ---\n  message: failure\n  ...\n", i, i % 5000);
+        } else if (i % 500 == 0) {
+            p += sprintf(p, "ok %zu - case_%zu # SKIP not supported\n",
+                         i, i % 5000);
+        } else if (i % 100 == 0) {
+            p += sprintf(p, "# group %zu\nok %zu - case_%zu\n",
+                         i / 100, i, i % 5000);
+        } else {
+            p += sprintf(p, "ok %zu - module.Class.test_case_%zu works\n",
+                         i, i % 5000);
+        }
+    }
+    *len = p - data;
+
+    return data;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the best of a few rounds, MB/s */
+static double bench(const char *data, size_t len, bool fast)
+{
+    testanything_set_fast_path(fast);
+    double best = 0;
+    int i;
+    for (i = 0; i < ROUNDS; i++) {
+        struct arena *arena = arena_new();
+        double start = now();
+        struct suiteq *suites = parse_testanything_buffer(data, len, arena);
+        double elapsed = now() - start;
+        arena_free(arena);
+        if (suites == NULL) {
+            fprintf(stderr, "Report is not parsed\n");
+            return 0;
+        }
+        if (i == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    return len / best / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t len = 0;
+    char *data;
+    if (argc > 1 && strspn(argv[1], "0123456789") != strlen(argv[1])) {
+        data = read_report(argv[1], &len);
+    } else {
+        size_t lines = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_LINES;
+        data = make_report(lines, &len);
+    }
+    if (data == NULL) {
+        return 1;
+    }
+
+    double grammar = bench(data, len, false);
+    double fast = bench(data, len, true);
+    printf("report:    %zu bytes\n", len);
+    printf("grammar:   %.1f MB/s\n", grammar);
+    printf("fast path: %.1f MB/s (%.1fx)\n", fast,
+           grammar > 0 ? fast / grammar : 0);
+    free(data);
+
+    return 0;
+}
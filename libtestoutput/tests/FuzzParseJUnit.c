@@ -1,10 +1,15 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include "parse_common.h"
 #include "parse_junit.h"
 
 int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
-    // parse_junit((const char *)data);
+    struct suiteq *suites = parse_junit_buffer((const char *)data, size, NULL);
+    if (suites != NULL) {
+        free_suites(suites);
+        free(suites);
+    }
     return 0;
 }
@@ -1,10 +1,15 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include "parse_common.h"
 #include "parse_subunit_v1.h"
 
 int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
-    // parse_subunit_v1((const char *)data);
+    struct suiteq *suites = parse_subunit_v1_buffer((const char *)data, size, NULL);
+    if (suites != NULL) {
+        free_suites(suites);
+        free(suites);
+    }
     return 0;
 }
@@ -1,9 +1,26 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include "parse_common.h"
 
+extern struct suiteq *parse_testanything(FILE *f);
+
 int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
-    // parse_testanything((const char *)data);
+    if (size == 0) {
+        return 0;
+    }
+    FILE *file = fmemopen((void *)data, size, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    struct suiteq *suites = parse_testanything(file);
+    fclose(file);
+    if (suites != NULL) {
+        free_suites(suites);
+        free(suites);
+    }
     return 0;
 }
@@ -0,0 +1,47 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "parse_common.h"
+
+#define SAMPLE_FILE_JUNIT "samples/junit.xml"
+
+int TestArena(int argc, char *argv[])
+{
+    struct arena *arena = arena_new();
+    assert(arena != NULL);
+
+    char *s = arena_strdup(arena, "test_add.TestAdd.test_add_control_dir");
+    assert(strcmp(s, "test_add.TestAdd.test_add_control_dir") == 0);
+    assert(arena_strdup(arena, NULL) == NULL);
+    assert(strcmp(arena_strndup(arena, "abcdef", 3), "abc") == 0);
+
+    /* memory is zeroed and aligned after strings */
+    tailq_test *test = arena_alloc(arena, sizeof(tailq_test));
+    assert(test != NULL && ((uintptr_t)test % 16) == 0);
+    assert(test->name == NULL && test->status == 0);
+
+    /* larger than a chunk */
+    char *big = arena_alloc(arena, 4 * 1024 * 1024);
+    assert(big != NULL && big[4 * 1024 * 1024 - 1] == 0);
+    int i;
+    for (i = 0; i < 100000; i++) {
+        assert(arena_alloc(arena, 24) != NULL);
+    }
+    arena_free(arena);
+
+    /* a NULL arena allocates from the heap */
+    s = arena_strdup(NULL, "name");
+    assert(strcmp(s, "name") == 0);
+    free(s);
+
+    tailq_report *report = process_file(SAMPLE_FILE_JUNIT);
+    assert(report != NULL && report->arena != NULL);
+    assert(!TAILQ_EMPTY(report->suites));
+    free_report(report);
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "columns.h"
+#include "intern.h"
+#include "parse_common.h"
+
+#define SAMPLE_FILE_JUNIT "samples/junit.xml"
+
+int TestColumns(int argc, char *argv[])
+{
+    tailq_report *report = process_file(SAMPLE_FILE_JUNIT);
+    assert(report != NULL);
+
+    struct test_columns *cols = report_columns(report);
+    assert(cols != NULL && report_columns(report) == cols);
+
+    size_t n = 0;
+    double time = 0;
+    tailq_suite *suite_item = NULL;
+    TAILQ_FOREACH(suite_item, report->suites, entries) {
+        tailq_test *test_item = NULL;
+        TAILQ_FOREACH(test_item, suite_item->tests, entries) {
+            assert(cols->status[n] == test_item->status);
+            assert(cols->name_id[n] == intern_id(test_item->name));
+            assert(cols->suite_id[n] == intern_id(suite_item->name));
+            time += test_item->duration;
+            n++;
+        }
+    }
+    assert(n > 0 && cols->n == n);
+    double sum = 0;
+    size_t i;
+    for (i = 0; i < cols->n; i++) {
+        sum += cols->duration[i];
+    }
+    assert(sum - time < 1e-9 && time - sum < 1e-9);
+
+    /* a history keeps rows of every report with its index */
+    struct reportq reports;
+    TAILQ_INIT(&reports);
+    TAILQ_INSERT_TAIL(&reports, report, entries);
+    tailq_report *other = process_file(SAMPLE_FILE_JUNIT);
+    assert(other != NULL);
+    TAILQ_INSERT_TAIL(&reports, other, entries);
+
+    struct test_columns *history = columns_from_reports(&reports);
+    assert(history != NULL && history->n == 2 * n);
+    assert(history->report[0] == 0 && history->report[n] == 1);
+    assert(history->name_id[0] == history->name_id[n]);
+    assert(memcmp(history->duration, cols->duration,
+                  n * sizeof(*cols->duration)) == 0);
+    columns_free(history);
+
+    /* columns go away with suites */
+    free_report_suites(other);
+    assert(other->columns == NULL && report_columns(other) == NULL);
+    free_reports(&reports);
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "input.h"
+#include "parse_common.h"
+
+#define SAMPLE_FILE_JUNIT "samples/junit.xml"
+#define SAMPLE_FILE_JUNIT_GZIP "samples/junit-min.xml.gz"
+#define SAMPLE_FILE_SUBUNIT_V2 "samples/subunit_v2.subunit"
+#define SAMPLE_FILE_TESTANYTHING "samples/testanything.tap"
+
+static enum test_format sniff(const char *data, enum detect_confidence *c)
+{
+    return sniff_format(data, strlen(data), c);
+}
+
+int TestDetectFormat(int argc, char *argv[])
+{
+    enum detect_confidence c;
+
+    assert(sniff("<?xml version=\"1.0\"?>\n<testsuites>\n", &c) == FORMAT_JUNIT);
+    assert(c == CONFIDENCE_HIGH);
+    assert(sniff("<html></html>", &c) == FORMAT_JUNIT);
+    assert(c == CONFIDENCE_LOW);
+    assert(sniff("TAP version 13\n1..2\n", &c) == FORMAT_TAP13);
+    assert(c == CONFIDENCE_HIGH);
+    assert(sniff("# comment\n1..2\nok 1\n", &c) == FORMAT_TAP13);
+    assert(c == CONFIDENCE_HIGH);
+    assert(sniff("make: entering\nnot ok 1 - test\n", &c) == FORMAT_TAP13);
+    assert(c == CONFIDENCE_MEDIUM);
+    assert(sniff("progress: 28704\ntime: 2016-07-05 12:17:02Z\n", &c) == FORMAT_SUBUNIT_V1);
+    assert(c == CONFIDENCE_MEDIUM);
+    assert(sniff("success test LABEL\n", &c) == FORMAT_SUBUNIT_V1);
+    assert(sniff("\xb3\x29\x01\x0c", &c) == FORMAT_SUBUNIT_V2);
+    assert(c == CONFIDENCE_HIGH);
+    assert(sniff("okay\nnothing here\n", &c) == FORMAT_UNKNOWN);
+    assert(c == CONFIDENCE_NONE);
+    assert(sniff_format("", 0, &c) == FORMAT_UNKNOWN);
+
+    /* contents win over an extension */
+    assert(detect_format_buffer("report.log", "1..1\nok 1\n", 10) == FORMAT_TAP13);
+    assert(detect_format_buffer("report.xml", "1..1\nok 1\n", 10) == FORMAT_TAP13);
+    assert(detect_format_buffer("report.tap", "ok 1\n", 5) == FORMAT_TAP13);
+    assert(detect_format_buffer("report", "random", 6) == FORMAT_UNKNOWN);
+
+    assert(detect_format(SAMPLE_FILE_JUNIT) == FORMAT_JUNIT);
+    assert(detect_format(SAMPLE_FILE_JUNIT_GZIP) == FORMAT_JUNIT);
+    assert(detect_format_buffer("report.xml.gz", "", 0) == FORMAT_JUNIT);
+    assert(detect_format(SAMPLE_FILE_SUBUNIT_V2) == FORMAT_SUBUNIT_V2);
+    assert(detect_format(SAMPLE_FILE_TESTANYTHING) == FORMAT_TAP13);
+
+    /* a file is read into a buffer when mapping is disabled */
+    struct input in;
+    struct stat sb;
+    input_set_mmap(0);
+    assert(input_open(&in, SAMPLE_FILE_JUNIT_GZIP, &sb) == 0);
+    assert(!in.mapped && in.len == (size_t)sb.st_size);
+    assert(in.compression == COMPRESSION_GZIP);
+    input_close(&in);
+    assert(detect_format(SAMPLE_FILE_JUNIT_GZIP) == FORMAT_JUNIT);
+    assert(detect_format(SAMPLE_FILE_TESTANYTHING) == FORMAT_TAP13);
+    input_set_mmap(1);
+    assert(input_open(&in, SAMPLE_FILE_JUNIT, &sb) == 0);
+    assert(in.mapped && in.len == (size_t)sb.st_size);
+    input_close(&in);
+
+    return 0;
+}
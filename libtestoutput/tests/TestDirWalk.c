@@ -0,0 +1,150 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dir_walk.h"
+
+#define MAX_FILES 16
+
+struct found {
+    size_t prefix;		/* length of a walked directory */
+    char *files[MAX_FILES];
+    int n_files;
+    int n_dirs;
+    int stop;			/* return it from a callback */
+};
+
+static const char *const tree[] = {
+    "a.xml",
+    "b.tap",
+    ".hidden.xml",
+    ".hidden/c.xml",
+    "sub/d.xml",
+    "sub/deeper/e.xml",
+};
+
+static int on_file(const char *path, void *arg)
+{
+    struct found *found = arg;
+    assert(found->n_files < MAX_FILES);
+    found->files[found->n_files] = strdup(path + found->prefix + 1);
+    assert(found->files[found->n_files] != NULL);
+    found->n_files++;
+
+    return found->stop;
+}
+
+static int on_dir(const char *path, void *arg)
+{
+    struct found *found = arg;
+    found->n_dirs++;
+
+    return 0;
+}
+
+static int by_name(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* files found in a walk sorted and separated by spaces */
+static void walk(const char *dir, struct walk_opts *opts, const char *files,
+                 int n_dirs)
+{
+    struct found found = { strlen(dir), { NULL }, 0, 0, 0 };
+    assert(walk_dir(dir, opts, on_file, &found) == 0);
+
+    qsort(found.files, found.n_files, sizeof(found.files[0]), by_name);
+    char buf[256] = "";
+    int i;
+    for (i = 0; i < found.n_files; i++) {
+        if (i > 0) {
+            strcat(buf, " ");
+        }
+        strcat(buf, found.files[i]);
+        free(found.files[i]);
+    }
+    assert(strcmp(buf, files) == 0);
+    assert(opts->dir_cb == NULL || found.n_dirs == n_dirs);
+}
+
+static void make_tree(const char *dir)
+{
+    char path[128];
+    size_t i;
+    for (i = 0; i < sizeof(tree) / sizeof(tree[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, tree[i]);
+        char *slash = strrchr(path, '/');
+        *slash = '\0';
+        mkdir(path, 0755);
+        *slash = '/';
+        FILE *file = fopen(path, "w");
+        assert(file != NULL);
+        fclose(file);
+    }
+    /* a symbolic link to a directory is not followed */
+    snprintf(path, sizeof(path), "%s/link", dir);
+    assert(symlink("sub", path) == 0);
+}
+
+static void remove_tree(const char *dir)
+{
+    char path[128];
+    static const char *const dirs[] = { "sub/deeper", "sub", ".hidden" };
+    size_t i;
+    for (i = 0; i < sizeof(tree) / sizeof(tree[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, tree[i]);
+        unlink(path);
+    }
+    snprintf(path, sizeof(path), "%s/link", dir);
+    unlink(path);
+    for (i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, dirs[i]);
+        rmdir(path);
+    }
+    rmdir(dir);
+}
+
+int TestDirWalk(int argc, char *argv[])
+{
+    char dir[] = "/tmp/TestDirWalkXXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    make_tree(dir);
+
+    struct walk_opts opts = { 0, NULL, NULL };
+    walk(dir, &opts, "a.xml b.tap", 0);
+    opts.max_depth = 1;
+    walk(dir, &opts, "a.xml b.tap sub/d.xml", 0);
+    opts.max_depth = -1;
+    walk(dir, &opts, "a.xml b.tap sub/d.xml sub/deeper/e.xml", 0);
+
+    opts.pattern = "*.xml";
+    walk(dir, &opts, "a.xml sub/d.xml sub/deeper/e.xml", 0);
+    opts.pattern = "*.tap";
+    walk(dir, &opts, "b.tap", 0);
+    opts.pattern = "*.json";
+    walk(dir, &opts, "", 0);
+
+    /* hidden directories and a link to a directory are not visited */
+    opts.pattern = NULL;
+    opts.dir_cb = on_dir;
+    walk(dir, &opts, "a.xml b.tap sub/d.xml sub/deeper/e.xml", 3);
+    opts.max_depth = 1;
+    walk(dir, &opts, "a.xml b.tap sub/d.xml", 2);
+    opts.dir_cb = NULL;
+
+    /* a callback stops a walk */
+    struct found found = { strlen(dir), { NULL }, 0, 0, 1 };
+    assert(walk_dir(dir, &opts, on_file, &found) == 1);
+    assert(found.n_files == 1);
+    free(found.files[0]);
+
+    assert(walk_dir("/nonexistent", &opts, on_file, &found) == -1);
+
+    remove_tree(dir);
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+#include "parse_common.h"
+
+#define SAMPLE_FILE_JUNIT "samples/junit.xml"
+#define N_THREADS 4
+#define N_NAMES 1000
+
+static const char *interned[N_THREADS][N_NAMES];
+
+static void *intern_names(void *arg)
+{
+    const char **names = arg;
+    char name[32];
+    int i;
+    for (i = 0; i < N_NAMES; i++) {
+        snprintf(name, sizeof(name), "test_%d", i);
+        names[i] = intern(name);
+    }
+
+    return NULL;
+}
+
+static const char *kept;
+
+static void keep_one(void *arg)
+{
+    kept = intern(kept);
+}
+
+/* a compaction keeps strings that are still used and drops the rest */
+static void test_compact(void)
+{
+    char name[32];
+    int i;
+    for (i = 0; i < N_NAMES; i++) {
+        snprintf(name, sizeof(name), "dropped_%d", i);
+        assert(intern(name) != NULL);
+    }
+    kept = intern("kept name");
+    intern_compact(keep_one, NULL);
+    assert(intern_count() == 1);
+    assert(strcmp(kept, "kept name") == 0 && intern_id(kept) == 1);
+    assert(intern_find("kept name") == kept);
+    assert(intern_find("dropped_0") == NULL);
+    assert(intern("dropped_0") != NULL && intern_count() == 2);
+}
+
+int TestIntern(int argc, char *argv[])
+{
+    char buf[] = "test_add.TestAdd.test_add_control_dir";
+    const char *s = intern(buf);
+    assert(s != buf && strcmp(s, buf) == 0);
+    assert(intern("test_add.TestAdd.test_add_control_dir") == s);
+    assert(intern_len("test_add.TestAdd.test_add_control_dir(pre-views)",
+                      strlen(buf)) == s);
+    assert(intern_find(buf) == s);
+    assert(intern_find("never interned") == NULL);
+    assert(intern(NULL) == NULL && intern_id(NULL) == 0);
+
+    uint32_t id = intern_id(s);
+    assert(id != 0 && intern_id(intern("another name")) != id);
+    assert(intern_id(intern(buf)) == id);
+
+    /* threads interning the same names get the same pointers */
+    pthread_t threads[N_THREADS];
+    int i, j;
+    for (i = 0; i < N_THREADS; i++) {
+        assert(pthread_create(&threads[i], NULL, intern_names, interned[i]) == 0);
+    }
+    for (i = 0; i < N_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (i = 1; i < N_THREADS; i++) {
+        for (j = 0; j < N_NAMES; j++) {
+            assert(interned[i][j] == interned[0][j]);
+        }
+    }
+    /* names in different shards never share an id */
+    size_t count = intern_count();
+    char *seen = calloc(count + 1, 1);
+    assert(seen != NULL);
+    for (j = 0; j < N_NAMES; j++) {
+        uint32_t name_id = intern_id(interned[0][j]);
+        assert(name_id != 0 && name_id <= count && !seen[name_id]);
+        seen[name_id] = 1;
+    }
+    free(seen);
+
+    /* the same test in two reports has the same name pointer */
+    tailq_report *r1 = process_file(SAMPLE_FILE_JUNIT);
+    tailq_report *r2 = process_file(SAMPLE_FILE_JUNIT);
+    assert(r1 != NULL && r2 != NULL);
+    tailq_suite *s1 = TAILQ_FIRST(r1->suites);
+    tailq_suite *s2 = TAILQ_FIRST(r2->suites);
+    assert(s1->name == s2->name);
+    assert(TAILQ_FIRST(s1->tests)->name == TAILQ_FIRST(s2->tests)->name);
+    free_report(r1);
+    free_report(r2);
+
+    test_compact();
+
+    return 0;
+}
@@ -1,13 +1,196 @@
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "arena.h"
 #include "parse_common.h"
 #include "parse_junit.h"
+#include "test_common.h"
 
 #define SAMPLE_FILE_JUNIT "samples/junit.xml"
+#define SAMPLE_FILE_JUNIT_MIN "samples/junit-min.xml"
 
-void TestParseJUnit()
+static const char *samples[] = { SAMPLE_FILE_JUNIT, SAMPLE_FILE_JUNIT_MIN };
+
+static void assert_same_suites(struct suiteq *a, struct suiteq *b)
+{
+    tailq_suite *sa = TAILQ_FIRST(a), *sb = TAILQ_FIRST(b);
+    for (; sa && sb; sa = TAILQ_NEXT(sa, entries), sb = TAILQ_NEXT(sb, entries)) {
+        assert(sa->name == sb->name && sa->hostname == sb->hostname);
+        assert(same_str(sa->timestamp, sb->timestamp));
+        assert(sa->n_failures == sb->n_failures && sa->n_errors == sb->n_errors);
+        tailq_test *ta = TAILQ_FIRST(sa->tests), *tb = TAILQ_FIRST(sb->tests);
+        for (; ta && tb; ta = TAILQ_NEXT(ta, entries), tb = TAILQ_NEXT(tb, entries)) {
+            assert(ta->name == tb->name && ta->status == tb->status);
+            assert(same_str(ta->time, tb->time) && same_str(ta->comment, tb->comment));
+            assert(same_str(ta->error, tb->error));
+            assert(same_str(ta->system_out, tb->system_out));
+            assert(same_str(ta->system_err, tb->system_err));
+        }
+        assert(ta == NULL && tb == NULL);
+    }
+    assert(sa == NULL && sb == NULL);
+}
+
+/* a report with a failure and a system-out of n bytes */
+static char *make_report(size_t n)
+{
+    const char *head = "<testsuite name=\"s\"><testcase name=\"t\">"
+        "<failure>a &lt; b<![CDATA[ & c]]></failure><system-out>";
+    const char *tail = "</system-out></testcase></testsuite>";
+    char *xml = malloc(strlen(head) + n + strlen(tail) + 1);
+    assert(xml != NULL);
+    strcpy(xml, head);
+    memset(xml + strlen(head), 'x', n);
+    strcpy(xml + strlen(head) + n, tail);
+
+    return xml;
+}
+
+static void test_texts(void)
+{
+    struct junit_opts opts = { 16, 0, 0 };
+    junit_set_opts(&opts);
+
+    char *xml = make_report(100);
+    struct arena *arena = arena_new();
+    struct suiteq *suites = parse_junit_buffer(xml, strlen(xml), arena);
+    assert(suites != NULL);
+    tailq_test *test = TAILQ_FIRST(TAILQ_FIRST(suites)->tests);
+    assert(test->status == STATUS_FAILURE);
+    assert(strcmp(test->error, "a < b & c") == 0);
+    assert(strcmp(test->system_out, "xxxxxxxxxxxxxxxx\n[84 bytes truncated]") == 0);
+    assert(test->system_out_span.len == 0);
+    arena_free(arena);
+
+    /* a long text is left in a report file */
+    char path[] = "/tmp/TestParseJUnitXXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    assert(write(fd, xml, strlen(xml)) == (ssize_t)strlen(xml));
+    close(fd);
+    opts.text_spans = 1;
+    junit_set_opts(&opts);
+    suites = parse_junit_buffer(xml, strlen(xml), NULL);
+    assert(suites != NULL);
+    test = TAILQ_FIRST(TAILQ_FIRST(suites)->tests);
+    assert(test->system_out == NULL && test->system_out_span.len == 100);
+    char *text = junit_read_span(path, &test->system_out_span);
+    assert(text != NULL && strlen(text) == 100 && text[99] == 'x');
+    free(text);
+    free_suites(suites);
+    free(suites);
+    unlink(path);
+    free(xml);
+
+    opts.text_limit = JUNIT_TEXT_LIMIT;
+    opts.text_spans = 0;
+    junit_set_opts(&opts);
+}
+
+static struct suiteq *parse_buffer(const char *data, int use_expat)
+{
+    struct junit_opts opts = { JUNIT_TEXT_LIMIT, 0, use_expat };
+    junit_set_opts(&opts);
+
+    return parse_junit_buffer(data, strlen(data), NULL);
+}
+
+/* the scanner gives the same reports as expat or leaves them to expat */
+static void test_scanner(void)
+{
+    int i;
+    for (i = 0; i < 2; i++) {
+        FILE *file = fopen(samples[i], "rb");
+        assert(file != NULL);
+        fseek(file, 0, SEEK_END);
+        size_t len = ftell(file);
+        rewind(file);
+        char *data = malloc(len + 1);
+        assert(data != NULL && fread(data, 1, len, file) == len);
+        fclose(file);
+        data[len] = '\0';
+        struct suiteq *scanned = parse_buffer(data, 0);
+        struct suiteq *parsed = parse_buffer(data, 1);
+        assert(scanned != NULL && parsed != NULL);
+        assert_same_suites(scanned, parsed);
+        free_parsed(scanned);
+        free_parsed(parsed);
+        free(data);
+    }
+
+    const char *xml = "<?xml version='1.0'?>\r\n<!-- a report -->"
+        "<testsuite name='a &amp; b' time='1.5'><testcase name=\"t\">"
+        "<failure>x\r\n&#x41;&#66;<![CDATA[<y>\r]]></failure>"
+        "<system-err/></testcase></testsuite>";
+    struct suiteq *suites = parse_buffer(xml, 0);
+    assert(suites != NULL);
+    tailq_suite *suite = TAILQ_FIRST(suites);
+    assert(strcmp(suite->name, "a & b") == 0 && suite->time > 1);
+    assert(strcmp(TAILQ_FIRST(suite->tests)->error, "x\nAB<y>\n") == 0);
+    free_parsed(suites);
+
+    /* an entity of a DTD and an encoding are known to expat only */
+    xml = "<!DOCTYPE testsuite [<!ENTITY who \"world\">]>"
+        "<testsuite name='s'><testcase name='t'><error>&who;</error>"
+        "</testcase></testsuite>";
+    suites = parse_buffer(xml, 0);
+    assert(suites != NULL);
+    assert(strcmp(TAILQ_FIRST(TAILQ_FIRST(suites)->tests)->error, "world") == 0);
+    free_parsed(suites);
+    xml = "<?xml version='1.0' encoding='ISO-8859-1'?>"
+        "<testsuite name='caf\xe9'></testsuite>";
+    suites = parse_buffer(xml, 0);
+    assert(suites != NULL);
+    assert(strcmp(TAILQ_FIRST(suites)->name, "caf\xc3\xa9") == 0);
+    free_parsed(suites);
+
+    /* malformed reports are rejected by expat */
+    assert(parse_buffer("<testsuite><testcase></testsuite>", 0) == NULL);
+    assert(parse_buffer("<testsuite name='a' name='b'/>", 0) == NULL);
+    assert(parse_buffer("<testsuite>&bogus;</testsuite>", 0) == NULL);
+    assert(parse_buffer("<testsuite/><testsuite/>", 0) == NULL);
+    assert(parse_buffer("", 0) == NULL);
+
+    struct junit_opts opts = { JUNIT_TEXT_LIMIT, 0, 0 };
+    junit_set_opts(&opts);
+}
+
+/* a nested suite does not replace the suite it is nested in */
+static void test_nested(void)
+{
+    const char *xml = "<testsuites><testsuite name=\"outer\">"
+        "<testcase name=\"a\"/>"
+        "<testsuite name=\"inner\"><testcase name=\"b\"/></testsuite>"
+        "<testcase name=\"c\"/>"
+        "</testsuite></testsuites>";
+    int use_expat;
+    for (use_expat = 0; use_expat < 2; use_expat++) {
+        struct suiteq *suites = parse_buffer(xml, use_expat);
+        assert(suites != NULL);
+        tailq_suite *suite = TAILQ_FIRST(suites);
+        assert(strcmp(suite->name, "outer") == 0);
+        tailq_test *test = TAILQ_FIRST(suite->tests);
+        assert(strcmp(test->name, "a") == 0);
+        test = TAILQ_NEXT(test, entries);
+        assert(strcmp(test->name, "c") == 0);
+        assert(TAILQ_NEXT(test, entries) == NULL);
+        suite = TAILQ_NEXT(suite, entries);
+        assert(strcmp(suite->name, "inner") == 0);
+        test = TAILQ_FIRST(suite->tests);
+        assert(strcmp(test->name, "b") == 0);
+        assert(TAILQ_NEXT(test, entries) == NULL);
+        assert(TAILQ_NEXT(suite, entries) == NULL);
+        free_parsed(suites);
+    }
+
+    struct junit_opts opts = { JUNIT_TEXT_LIMIT, 0, 0 };
+    junit_set_opts(&opts);
+}
+
+int TestParseJUnit(int argc, char *argv[])
 {
     FILE *file;
     const char *name = SAMPLE_FILE_JUNIT;
@@ -17,4 +200,20 @@ void TestParseJUnit()
     struct suiteq *report = parse_junit(file);
     assert(report != NULL);
     fclose(file);
+    free_parsed(report);
+
+    parse_concurrently(parse_junit_r, assert_same_suites, samples, 2);
+
+    /* errors are returned */
+    const char *broken = "<testsuite name=\"s\"><testcase name=\"t\"></testsuite>";
+    assert(parse_junit_buffer(broken, strlen(broken), NULL) == NULL);
+    struct arena *arena = arena_new();
+    assert(parse_junit_buffer(broken, strlen(broken), arena) == NULL);
+    arena_free(arena);
+
+    test_texts();
+    test_scanner();
+    test_nested();
+
+    return 0;
 }
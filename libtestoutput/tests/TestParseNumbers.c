@@ -0,0 +1,75 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parse_common.h"
+
+#define SAMPLE_FILE_JUNIT "samples/junit.xml"
+#define SAMPLE_FILE_SUBUNIT_V1 "samples/subunit_v1-min.subunit"
+
+static int same(double a, double b)
+{
+    return a - b < 1e-9 && b - a < 1e-9;
+}
+
+int TestParseNumbers(int argc, char *argv[])
+{
+    const char *numbers[] = {
+        "0", "0.001", "1.5", "12.345678", "3", "-2.25", "1e3", "1.5E-3",
+        "0.000001", "123456789.123456", " 7.0"
+    };
+    size_t i;
+    for (i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+        assert(same(parse_seconds(numbers[i]), strtod(numbers[i], NULL)));
+    }
+    assert(same(parse_seconds(NULL), 0));
+    assert(same(parse_seconds(""), 0));
+    assert(same(parse_seconds("abc"), 0));
+
+    /* a number ends where strtod(3) stops too */
+    const char *tails[] = { "12ms", "1e", "1.5e+", "2.5E-1x", ".5", "abc" };
+    for (i = 0; i < sizeof(tails) / sizeof(tails[0]); i++) {
+        const char *end;
+        char *expected_end;
+        double expected = strtod(tails[i], &expected_end);
+        assert(same(parse_number(tails[i], &end), expected));
+        assert(end == expected_end);
+    }
+
+    assert(same(parse_iso8601("1970-01-01T00:00:00"), 0));
+    assert(same(parse_iso8601("2009-12-19T17:58:59"), 1261245539));
+    assert(same(parse_iso8601("2009-12-19"), 1261180800));
+    assert(same(parse_iso8601("2016-07-05 12:17:02.25Z"), 1467721022.25));
+    assert(same(parse_iso8601("2014-11-12T19:12:14+03:00"), 1415808734));
+    assert(same(parse_iso8601("2000-02-29T12:00:00-0130"), 951831000));
+    assert(same(parse_iso8601("not a date"), 0));
+    assert(same(parse_iso8601("2009-13-19T17:58:59"), 0));
+    assert(same(parse_iso8601(NULL), 0));
+
+    /* parsers fill in numbers */
+    tailq_report *report = process_file(SAMPLE_FILE_JUNIT);
+    assert(report != NULL);
+    tailq_suite *suite_item = NULL;
+    TAILQ_FOREACH(suite_item, report->suites, entries) {
+        if (suite_item->timestamp) {
+            assert(suite_item->started == (time_t)parse_iso8601(suite_item->timestamp));
+        }
+        tailq_test *test_item = NULL;
+        TAILQ_FOREACH(test_item, suite_item->tests, entries) {
+            if (test_item->time) {
+                assert(same(test_item->duration, parse_seconds(test_item->time)));
+            }
+        }
+    }
+    free_report(report);
+
+    report = process_file(SAMPLE_FILE_SUBUNIT_V1);
+    assert(report != NULL);
+    suite_item = TAILQ_FIRST(report->suites);
+    tailq_test *test_item = TAILQ_FIRST(suite_item->tests);
+    assert(test_item->duration > 0.0244 && test_item->duration < 0.0245);
+    free_report(report);
+
+    return 0;
+}
@@ -1,64 +1,150 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "parse_common.h"
 #include "parse_subunit_v1.h"
+#include "test_common.h"
 
-#define SAMPLE_FILE_SUBUNIT_V1 "samples/subunit_v1.subunit"
+#define SAMPLE_FILE_SUBUNIT_V1 "samples/subunit_v1-min.subunit"
 
-void TestParseSubunitV1()
+static struct suiteq *parse_string(const char *s)
 {
-    const char *name = SAMPLE_FILE_SUBUNIT_V1;
-    FILE *file;
+    return parse_subunit_v1_buffer(s, strlen(s), NULL);
+}
 
-    file = fopen(name, "r");
-    assert(file == NULL);
+static void test_resolve_directive()
+{
+    const struct {
+        const char *s;
+        enum directive dir;
+    } samples[] = {
+        { "test", DIR_TEST },
+        { "testing:", DIR_TEST },
+        { "success", DIR_SUCCESS },
+        { "Successful:", DIR_SUCCESS },
+        { "failure:", DIR_FAILURE },
+        { "error:", DIR_ERROR },
+        { "skip", DIR_SKIP },
+        { "xfail:", DIR_XFAIL },
+        { "uxsuccess", DIR_UXSUCCESS },
+        { "progress:", DIR_PROGRESS },
+        { "tags:", DIR_TAGS },
+        { "time:", DIR_TIME },
+        { "tame:", DIR_UNKNOWN },
+        { "succes", DIR_UNKNOWN },
+        { ":", DIR_UNKNOWN },
+        { "", DIR_UNKNOWN }
+    };
 
-    struct suiteq *suites;
-    suites = parse_subunit_v1(file);
+    size_t i;
+    for (i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        const char *s = samples[i].s;
+        assert(resolve_directive(s, strlen(s)) == samples[i].dir);
+    }
+}
 
+static void test_parse_sample()
+{
+    FILE *file = fopen(SAMPLE_FILE_SUBUNIT_V1, "r");
+    assert(file != NULL);
+    struct suiteq *suites = parse_subunit_v1(file);
     fclose(file);
-    free(suites);
+    assert(suites != NULL);
+
+    tailq_suite *suite = TAILQ_FIRST(suites);
+    tailq_test *test = TAILQ_FIRST(suite->tests);
+    assert(test != NULL);
+    assert(strcmp(test->name, "bzrlib.tests.blackbox.test_add.TestAdd."
+                  "test_add_from_subdir(view-aware)") == 0);
+    assert(test->status == STATUS_SUCCESS);
+    assert(test->duration > 0.024 && test->duration < 0.025);
+    test = TAILQ_NEXT(test, entries);
+    assert(test != NULL);
+    assert(strcmp(test->name, "bzrlib.tests.test_http.TestBadProtocolServer."
+                  "test_http_has(pycurl,HTTP/1.1)") == 0);
+    assert(test->status == STATUS_SKIPPED);
+    assert(strcmp(test->comment,
+                  "pycurl doesn't check the protocol version\n") == 0);
+    assert(TAILQ_NEXT(test, entries) == NULL);
+    free_parsed(suites);
+}
+
+/* details in brackets are not directives */
+static void test_details()
+{
+    struct suiteq *suites = parse_string(
+        "test: a\n"
+        "failure: a [\n"
+        "Traceback:\n"
+        "success: b\n"
+        "]\n"
+        "error: c [ multipart\n"
+        "Content-Type: text/plain;charset=utf8\n"
+        "traceback\n"
+        "7\r\nline\n]\n"
+        "3\r\nend0\r\n"
+        "Content-Type: text/plain;charset=utf8\n"
+        "reason\n"
+        "2\r\nno0\r\n"
+        "]\n"
+        "xfail: d\n");
+    assert(suites != NULL);
+
+    tailq_test *test = TAILQ_FIRST(TAILQ_FIRST(suites)->tests);
+    assert(strcmp(test->name, "a") == 0);
+    assert(test->status == STATUS_FAILURE);
+    assert(strcmp(test->error, "Traceback:\nsuccess: b\n") == 0);
+    test = TAILQ_NEXT(test, entries);
+    assert(strcmp(test->name, "c") == 0);
+    assert(test->status == STATUS_FAILED);
+    assert(strcmp(test->error, "line\n]\nend") == 0);
+    assert(strcmp(test->comment, "no") == 0);
+    test = TAILQ_NEXT(test, entries);
+    assert(strcmp(test->name, "d") == 0);
+    assert(test->status == STATUS_XFAILURE);
+    assert(TAILQ_NEXT(test, entries) == NULL);
+    free_parsed(suites);
+}
+
+/* lines have no length limit */
+static void test_long_line()
+{
+    size_t len = 200 * 1024;
+    char *name = malloc(len + 1);
+    assert(name != NULL);
+    memset(name, 'x', len);
+    name[len] = '\0';
+
+    size_t buf_size = 2 * len + 32;
+    char *buf = malloc(buf_size);
+    assert(buf != NULL);
+    buf_size = sprintf(buf, "test: %s\nsuccess: %s\n", name, name);
+    FILE *stream = fmemopen(buf, buf_size, "r");
+    assert(stream != NULL);
+    struct suiteq *suites = parse_subunit_v1(stream);
+    fclose(stream);
+    assert(suites != NULL);
+
+    tailq_test *test = TAILQ_FIRST(TAILQ_FIRST(suites)->tests);
+    assert(test != NULL);
+    assert(strcmp(test->name, name) == 0);
+    assert(test->status == STATUS_SUCCESS);
+    assert(TAILQ_NEXT(test, entries) == NULL);
+    free_parsed(suites);
+    free(buf);
+    free(name);
 }
 
-void test_parse_subunit_v1_line()
+int TestParseSubunitV1(int argc, char *argv[])
 {
-	const char *test_sample[] = {
-	"test test LABEL",
-	"testing test LABEL",
-	"test: test LABEL",
-	"testing: test LABEL",
-	"success test LABEL",
-	"success: test LABEL",
-	"successful test LABEL",
-	"successful: test LABEL",
-	"failure: test LABEL",
-	"failure: test LABEL DETAILS",
-	"error: test LABEL",
-	"error: test LABEL DETAILS",
-	"skip test LABEL",
-	"skip: test LABEL",
-	"skip test LABEL DETAILS",
-	"skip: test LABEL DETAILS",
-	"xfail test LABEL",
-	"xfail: test LABEL",
-	"xfail test LABEL DETAILS",
-	"xfail: test LABEL DETAILS",
-	"uxsuccess test LABEL",
-	"uxsuccess: test LABEL",
-	"uxsuccess test LABEL DETAILS",
-	"uxsuccess: test LABEL DETAILS",
-	"progress: +10",
-	"progress: -14",
-	"progress: push",
-	"progress: pop",
-	"tags: -small +big",
-	"time: 2018-09-10 23:59:29Z" };
+    test_resolve_directive();
+    test_parse_sample();
+    test_details();
+    test_long_line();
 
-	const char** qq = test_sample;
-	for (int i = 0; i <  (int)(sizeof(test_sample)/sizeof(char*)); ++i) {
-		parse_line_subunit_v1((char*)*qq);
-		++qq;
-	}
+    return 0;
 }
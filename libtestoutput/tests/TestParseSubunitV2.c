@@ -2,47 +2,75 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <arpa/inet.h>
 
 #include "parse_common.h"
 #include "parse_subunit_v2.h"
+#include "test_common.h"
 
-#define SAMPLE_FILE_SUBUNIT_V1 "samples/subunit_v1.subunit"
+#define SAMPLE_FILE_SUBUNIT_V1 "samples/subunit_v1-min.subunit"
 #define SAMPLE_FILE_SUBUNIT_V2 "samples/subunit_v2.subunit"
 
-void TestParseSubunitV2()
+/* tests and their statuses in SAMPLE_FILE_SUBUNIT_V2 */
+#define SAMPLE_TESTS 94
+#define SAMPLE_SUCCESS 59
+#define SAMPLE_SKIPPED 35
+
+/* copies of the sample in a stream large enough to be decoded in parallel */
+#define SAMPLE_COPIES 700
+
+// Packet sample, with test id, runnable set, status=enumeration.
+// Spaces below are to visually break up:
+// signature / flags / length / testid / crc32
+// b3 2901 0c 03666f6f 08555f1b
+static const uint8_t sample_packet[] = {
+    0xb3, 0x29, 0x01, 0x0c, 0x03, 0x66, 0x6f, 0x6f, 0x08, 0x55, 0x5f, 0x1b
+};
+
+static void test_decode_packet()
+{
+    struct subunit_packet packet;
+    int len = sizeof(sample_packet);
+
+    assert(subunit_v2_decode(sample_packet, len, &packet) == len);
+    assert(packet.flags & FLAG_TEST_ID);
+    assert(packet.flags & FLAG_RUNNABLE);
+    assert(packet.test_id_len == 3);
+    assert(memcmp(packet.test_id, "foo", 3) == 0);
+    assert((packet.flags & FLAG_STATUS_MASK) == 1);
+
+    /* incomplete */
+    assert(subunit_v2_decode(sample_packet, len - 1, &packet) == 0);
+
+    /* CRC32 does not match */
+    uint8_t corrupted[sizeof(sample_packet)];
+    memcpy(corrupted, sample_packet, len);
+    corrupted[5] = 'g';
+    assert(subunit_v2_decode(corrupted, len, &packet) == -1);
+}
+
+static void test_read_packet()
 {
-    // Packet sample, with test id, runnable set, status=enumeration.
-    // Spaces below are to visually break up:
-    // signature / flags / length / testid / crc32
-    // b3 2901 0c 03666f6f 08555f1b
-    // echo 03666f6f | xxd -p -r
-
-    subunit_header sample_header = { .signature = 0xb3, .flags = ntohs(0x2901) };
-    uint16_t sample_length = 0x0c;
-    uint32_t sample_testid = 0x03666f6f;
-    uint32_t sample_crc32 = 0x08555f1b;
-
-    char* buf = NULL;
+    char *buf = NULL;
     size_t buf_size = 0;
-    tailq_test * test;
-    FILE* stream = open_memstream(&buf, &buf_size);
-    fwrite(&sample_header, 1, sizeof(sample_header), stream);
-    fwrite(&sample_length, 1, sizeof(sample_length), stream);
-    fwrite(&sample_testid, 1, sizeof(sample_testid), stream);
-    fwrite(&sample_crc32, 1, sizeof(sample_crc32), stream);
-
-    test = read_subunit_v2_packet(stream);
+    FILE *stream = open_memstream(&buf, &buf_size);
+    fwrite(sample_packet, 1, sizeof(sample_packet), stream);
+    fflush(stream);
+    rewind(stream);
+
+    tailq_test *test = read_subunit_v2_packet(stream);
     fclose(stream);
 
-    assert(strcmp(test->name, "") == 0);
+    assert(test != NULL);
+    assert(strcmp(test->name, "foo") == 0);
+    assert(test->status == STATUS_ENUMERATION);
 
     free(buf);
     free(test);
 }
 
-void test_is_subunit_v2()
+static void test_is_subunit_v2()
 {
     const char *file_subunit_v1 = SAMPLE_FILE_SUBUNIT_V1;
     const char *file_subunit_v2 = SAMPLE_FILE_SUBUNIT_V2;
@@ -51,16 +79,159 @@ void test_is_subunit_v2()
     assert(is_subunit_v2((char*)file_subunit_v2) == 0);
 }
 
-void test_parse_subunit_v2()
+static void check_sample(struct suiteq *suites)
 {
-    const char *name = SAMPLE_FILE_SUBUNIT_V2;
-    FILE *file;
+    assert(suites != NULL);
+    tailq_suite *suite = TAILQ_FIRST(suites);
+    assert(suite != NULL);
+    assert(suite->time > 0);
 
-    file = fopen(name, "r");
-    assert(file == NULL);
+    int n_tests = 0, n_success = 0, n_skipped = 0;
+    tailq_test *test;
+    TAILQ_FOREACH(test, suite->tests, entries) {
+        n_tests++;
+        if (test->status == STATUS_SUCCESS) {
+            n_success++;
+            assert(test->duration >= 0);
+        } else if (test->status == STATUS_SKIPPED) {
+            n_skipped++;
+        }
+    }
+    assert(n_tests == SAMPLE_TESTS);
+    assert(n_success == SAMPLE_SUCCESS);
+    assert(n_skipped == SAMPLE_SKIPPED);
+}
+
+static void test_parse_subunit_v2()
+{
+    FILE *file = fopen(SAMPLE_FILE_SUBUNIT_V2, "rb");
+    assert(file != NULL);
+    struct suiteq *suites = parse_subunit_v2(file);
+    fclose(file);
+    check_sample(suites);
+    free_parsed(suites);
+}
 
-    struct suiteq *suites;
-    suites = parse_subunit_v2(file);
+static char *read_sample(size_t *len)
+{
+    FILE *file = fopen(SAMPLE_FILE_SUBUNIT_V2, "rb");
+    assert(file != NULL);
+    fseek(file, 0, SEEK_END);
+    *len = ftell(file);
+    rewind(file);
+    char *data = malloc(*len);
+    assert(data != NULL);
+    assert(fread(data, 1, *len, file) == *len);
     fclose(file);
-    free(suites);
+
+    return data;
+}
+
+/* a corrupted packet is skipped, the rest of a stream is parsed */
+static void test_corrupted()
+{
+    size_t len;
+    char *data = read_sample(&len);
+    struct suiteq *suites = parse_subunit_v2_buffer(data, len, NULL);
+    check_sample(suites);
+    free_parsed(suites);
+
+    /* garbage before the first packet and in the middle of a stream */
+    char *garbage = malloc(len + 32);
+    assert(garbage != NULL);
+    memset(garbage, 'x', 16);
+    memcpy(garbage + 16, data, len / 2);
+    memset(garbage + 16 + len / 2, 0xb3, 16);
+    memcpy(garbage + 32 + len / 2, data + len / 2, len - len / 2);
+    suites = parse_subunit_v2_buffer(garbage, len + 32, NULL);
+    assert(suites != NULL);
+    free_parsed(suites);
+
+    size_t i;
+    for (i = 0; i < len; i += 97) {
+        data[i] ^= 0x5a;
+        suites = parse_subunit_v2_buffer(data, len, NULL);
+        assert(suites != NULL);
+        free_parsed(suites);
+        data[i] ^= 0x5a;
+    }
+    free(garbage);
+    free(data);
+}
+
+static int same_time(double a, double b)
+{
+    return a - b < 1e-9 && b - a < 1e-9;
+}
+
+static void check_same(struct suiteq *a, struct suiteq *b)
+{
+    tailq_suite *suite_a = TAILQ_FIRST(a);
+    tailq_suite *suite_b = TAILQ_FIRST(b);
+    assert(suite_a->started == suite_b->started);
+    assert(same_time(suite_a->time, suite_b->time));
+
+    tailq_test *test_a = TAILQ_FIRST(suite_a->tests);
+    tailq_test *test_b = TAILQ_FIRST(suite_b->tests);
+    while (test_a != NULL && test_b != NULL) {
+        assert(test_a->name == test_b->name);
+        assert(test_a->status == test_b->status);
+        assert(same_time(test_a->duration, test_b->duration));
+        assert(same_str(test_a->error, test_b->error));
+        assert(same_str(test_a->comment, test_b->comment));
+        assert(same_str(test_a->system_out, test_b->system_out));
+        assert(same_str(test_a->system_err, test_b->system_err));
+        test_a = TAILQ_NEXT(test_a, entries);
+        test_b = TAILQ_NEXT(test_b, entries);
+    }
+    assert(test_a == NULL && test_b == NULL);
+}
+
+/* threads decode a large stream the same way as a single thread */
+static void test_parallel()
+{
+    size_t len;
+    char *data = read_sample(&len);
+    char *stream = malloc(len * SAMPLE_COPIES);
+    assert(stream != NULL);
+    int i;
+    for (i = 0; i < SAMPLE_COPIES; i++) {
+        memcpy(stream + i * len, data, len);
+    }
+
+    subunit_v2_set_jobs(1);
+    struct suiteq *sequential;
+    sequential = parse_subunit_v2_buffer(stream, len * SAMPLE_COPIES, NULL);
+    subunit_v2_set_jobs(4);
+    struct suiteq *parallel;
+    parallel = parse_subunit_v2_buffer(stream, len * SAMPLE_COPIES, NULL);
+    check_sample(parallel);
+    check_same(sequential, parallel);
+    free_parsed(sequential);
+    free_parsed(parallel);
+
+    /* a corrupted packet, the stream is decoded by a single thread */
+    stream[len * SAMPLE_COPIES / 2] ^= 0x5a;
+    subunit_v2_set_jobs(1);
+    sequential = parse_subunit_v2_buffer(stream, len * SAMPLE_COPIES, NULL);
+    subunit_v2_set_jobs(4);
+    parallel = parse_subunit_v2_buffer(stream, len * SAMPLE_COPIES, NULL);
+    check_same(sequential, parallel);
+    free_parsed(sequential);
+    free_parsed(parallel);
+
+    free(stream);
+    free(data);
+}
+
+int TestParseSubunitV2(int argc, char *argv[])
+{
+    test_decode_packet();
+    test_read_packet();
+    test_is_subunit_v2();
+    test_parse_subunit_v2();
+    test_corrupted();
+    test_parallel();
+
+    return 0;
 }
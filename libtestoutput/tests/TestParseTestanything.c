@@ -1,18 +1,302 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <parse_common.h>
 
+#include "arena.h"
+#include "test_common.h"
+
 #define SAMPLE_FILE_TESTANYTHING "samples/testanything.tap"
+#define SAMPLE_FILE_TESTANYTHING_MIN "samples/testanything-min.tap"
 
 extern struct suiteq *parse_testanything(FILE *f);
+extern struct suiteq *parse_testanything_arena(FILE *f, struct arena *arena);
+extern struct suiteq *parse_testanything_buffer(const char *data, size_t len,
+						struct arena *arena);
+extern void testanything_set_fast_path(bool enable);
+
+static const char *samples[] = {
+    SAMPLE_FILE_TESTANYTHING,
+    SAMPLE_FILE_TESTANYTHING_MIN
+};
+
+static void assert_same_suites(struct suiteq *a, struct suiteq *b)
+{
+    tailq_test *test_a = TAILQ_FIRST(TAILQ_FIRST(a)->tests);
+    tailq_test *test_b = TAILQ_FIRST(TAILQ_FIRST(b)->tests);
+    while (test_a != NULL && test_b != NULL) {
+        assert(test_a->name == test_b->name);
+        assert(test_a->status == test_b->status);
+        assert(same_str(test_a->comment, test_b->comment));
+        assert(same_str(test_a->diagnostics, test_b->diagnostics));
+        test_a = TAILQ_NEXT(test_a, entries);
+        test_b = TAILQ_NEXT(test_b, entries);
+    }
+    assert(test_a == NULL && test_b == NULL);
+}
 
-void TestParseTestanything()
+static void test_parse_min()
 {
-    const char *name = SAMPLE_FILE_TESTANYTHING;
-    FILE *file;
-    file = fopen(name, "r");
-    assert(file == NULL);
-    parse_testanything(file);
+    struct suiteq *suites = parse_path(parse_testanything_arena,
+                                       SAMPLE_FILE_TESTANYTHING_MIN, NULL);
+    assert(suites != NULL);
+
+    tailq_test *test = TAILQ_FIRST(TAILQ_FIRST(suites)->tests);
+    assert(strcmp(test->name, "Creating test program") == 0);
+    assert(test->status == STATUS_PASS);
+    test = TAILQ_NEXT(test, entries);
+    assert(test->status == STATUS_PASS);
+    test = TAILQ_NEXT(test, entries);
+    assert(strcmp(test->name, "infinite loop") == 0);
+    assert(test->status == STATUS_TODO);
+    assert(strcmp(test->comment, "halting problem unsolved") == 0);
+    test = TAILQ_NEXT(test, entries);
+    assert(test->status == STATUS_TODO);
+    assert(TAILQ_NEXT(test, entries) == NULL);
+    free_parsed(suites);
+}
+
+/* a comment on a line of its own does not belong to a test */
+static void test_comment_line()
+{
+    const char tap[] = "1..1\n# just a comment\nok 1 - first\n";
+    FILE *file = fmemopen((void *)tap, sizeof(tap) - 1, "r");
+    assert(file != NULL);
+    struct suiteq *suites = parse_testanything(file);
     fclose(file);
+    assert(suites != NULL);
+
+    tailq_test *test = TAILQ_FIRST(TAILQ_FIRST(suites)->tests);
+    assert(test != NULL);
+    assert(strcmp(test->name, "first") == 0);
+    assert(test->comment == NULL);
+    assert(TAILQ_NEXT(test, entries) == NULL);
+    free_parsed(suites);
+}
+
+/* lines that the fast path takes and lines it leaves to the grammar */
+static const char tricky[] =
+    "TAP version 13\n"
+    "1..16\n"
+    "ok 1 - plain name\n"
+    "not ok 2 - failed one\n"
+    "ok 3 name without a dash\n"
+    "ok 4 - has 42 numbers 7 in it\n"
+    "ok 5\n"
+    "ok 6 - \n"
+    "ok 7 - skip is a keyword\n"
+    "ok 8 - a-b c--d #tag test_9x\t tabs\n"
+    "not ok 9 - with a directive # TODO not yet\n"
+    "  ---\n"
+    "  message: ok 1\n"
+    "  ...\n"
+    "ok 10 - after yaml\n"
+    "ok 11 - okay nothing notable\n"
+    "# comment\n"
+    "ok 12 - range 1..3 is a plan\n"
+    "ok 13 - Bail out! not really\n"
+    "ok 14 # SKIP no reason\n"
+    "ok 15 - \n"
+    "ok 16 - last line";
+
+static struct suiteq *parse_text(const char *text, size_t len, bool fast)
+{
+    testanything_set_fast_path(fast);
+    FILE *file = fmemopen((void *)text, len, "r");
+    assert(file != NULL);
+    struct suiteq *suites = parse_testanything(file);
+    fclose(file);
+    testanything_set_fast_path(true);
+    assert(suites != NULL);
+
+    return suites;
+}
+
+/* the fast path makes the same tests as the grammar alone */
+static void test_fast_path()
+{
+    struct suiteq *slow = parse_text(tricky, sizeof(tricky) - 1, false);
+    struct suiteq *fast = parse_text(tricky, sizeof(tricky) - 1, true);
+    assert_same_suites(slow, fast);
+    struct suiteq *buffer = parse_testanything_buffer(tricky,
+                                                      sizeof(tricky) - 1, NULL);
+    assert_same_suites(slow, buffer);
+
+    tailq_test *test = TAILQ_FIRST(TAILQ_FIRST(fast)->tests);
+    assert(strcmp(test->name, "plain name") == 0);
+    test = TAILQ_NEXT(test, entries);
+    assert(test->status == STATUS_FAILED);
+    test = TAILQ_NEXT(test, entries);
+    assert(strcmp(test->name, "name without a dash") == 0);
+    test = TAILQ_NEXT(test, entries);
+    assert(strcmp(test->name, "has numbers in it") == 0);
+    test = TAILQ_NEXT(test, entries);
+    assert(test->name == NULL);
+    free_parsed(slow);
+    free_parsed(fast);
+    free_parsed(buffer);
+
+    /* lines and YAML blocks cross the boundaries of reads */
+    size_t size = 256 * 1024, len = 0;
+    char *text = malloc(size);
+    assert(text != NULL);
+    int i;
+    for (i = 1; len + 256 < size; i++) {
+        len += sprintf(text + len, "ok %d - test number %d of many\n", i, i);
+        if (i % 97 == 0) {
+            len += sprintf(text + len, "  ---\n  duration_ms: %d\n  ...\n", i);
+        }
+        if (i % 89 == 0) {
+            len += sprintf(text + len, "# a comment\n");
+        }
+    }
+    slow = parse_text(text, len, false);
+    fast = parse_text(text, len, true);
+    assert_same_suites(slow, fast);
+    for (test = TAILQ_FIRST(TAILQ_FIRST(fast)->tests), i = 1; test != NULL;
+         test = TAILQ_NEXT(test, entries), i++) {
+        assert((test->diagnostics != NULL) == (i % 97 == 0));
+        assert(test->diagnostics == NULL ||
+               (int)(test->duration * 1000 + 0.5) == i);
+    }
+    free_parsed(slow);
+    free_parsed(fast);
+    free(text);
+}
+
+/* a YAML block is kept in the test before it */
+static void test_diagnostics()
+{
+    const char tap[] =
+        "1..2\n"
+        "not ok 1 - fails\n"
+        "  ---\n"
+        "  duration_ms: 125.5\n"
+        "  got: 1\n"
+        "  ...\n"
+        "ok 2 - passes\n";
+    struct suiteq *suites = parse_text(tap, sizeof(tap) - 1, true);
+    tailq_test *test = TAILQ_FIRST(TAILQ_FIRST(suites)->tests);
+    assert(test->status == STATUS_FAILED);
+    assert(strcmp(test->diagnostics, "  duration_ms: 125.5\n  got: 1\n") == 0);
+    assert(test->duration > 0.1254 && test->duration < 0.1256);
+    assert(strcmp(test->time, "0.1255") == 0);
+    test = TAILQ_NEXT(test, entries);
+    assert(strcmp(test->name, "passes") == 0);
+    assert(test->diagnostics == NULL);
+    assert(TAILQ_NEXT(test, entries) == NULL);
+    free_parsed(suites);
+}
+
+/* a report of a version that is not known is not taken */
+static void test_version()
+{
+    const char v14[] = "TAP version 14\n1..1\nok 1 - first\n";
+    struct suiteq *suites = parse_text(v14, sizeof(v14) - 1, false);
+    tailq_test *test = TAILQ_FIRST(TAILQ_FIRST(suites)->tests);
+    assert(strcmp(test->name, "first") == 0);
+    free_parsed(suites);
+
+    const char v12[] = "TAP version 12\n1..1\nok 1 - first\n";
+    assert(parse_testanything_buffer(v12, sizeof(v12) - 1, NULL) == NULL);
+    struct arena *arena = arena_new();
+    assert(arena != NULL);
+    assert(parse_testanything_buffer(v12, sizeof(v12) - 1, arena) == NULL);
+    arena_free(arena);
+}
+
+/* tests out of order are kept, numbers that are skipped are missing */
+static void test_numbers()
+{
+    const char tap[] =
+        "1..5\n"
+        "ok 2 - second\n"
+        "ok 1 - first\n"
+        "ok 1 - again\n"
+        "not ok 5 - last\n";
+    static const enum test_status statuses[] = {
+        STATUS_MISSING, STATUS_PASS, STATUS_PASS, STATUS_PASS,
+        STATUS_MISSING, STATUS_MISSING, STATUS_FAILED
+    };
+    struct suiteq *slow = parse_text(tap, sizeof(tap) - 1, false);
+    struct suiteq *fast = parse_text(tap, sizeof(tap) - 1, true);
+    assert_same_suites(slow, fast);
+    tailq_test *test = TAILQ_FIRST(TAILQ_FIRST(fast)->tests);
+    size_t i;
+    for (i = 0; i < sizeof(statuses) / sizeof(statuses[0]); i++) {
+        assert(test != NULL && test->status == statuses[i]);
+        test = TAILQ_NEXT(test, entries);
+    }
+    assert(test == NULL);
+    test = TAILQ_FIRST(TAILQ_FIRST(fast)->tests);
+    assert(test->name == NULL);
+    test = TAILQ_NEXT(test, entries);
+    assert(strcmp(test->name, "second") == 0);
+    test = TAILQ_NEXT(TAILQ_NEXT(test, entries), entries);
+    assert(strcmp(test->name, "again") == 0);
+    free_parsed(slow);
+    free_parsed(fast);
+
+    /* a huge number does not make a test for every number before it */
+    const char gap[] = "ok 1000000000 - far away\n";
+    fast = parse_text(gap, sizeof(gap) - 1, true);
+    i = 0;
+    TAILQ_FOREACH(test, TAILQ_FIRST(fast)->tests, entries) {
+        i++;
+    }
+    assert(i == 1024 + 1);
+    assert(strcmp(TAILQ_LAST(TAILQ_FIRST(fast)->tests, testq)->name,
+                  "far away") == 0);
+    free_parsed(fast);
+}
+
+static size_t count_tests(struct suiteq *suites)
+{
+    size_t n = 0;
+    tailq_test *test;
+    TAILQ_FOREACH(test, TAILQ_FIRST(suites)->tests, entries) {
+        n++;
+    }
+
+    return n;
+}
+
+/* planned tests that have not run before a bail out are skipped */
+static void test_bail_out()
+{
+    const char tap[] = "1..4\nok 1 - first\nBail out! no database\n";
+    struct suiteq *slow = parse_text(tap, sizeof(tap) - 1, false);
+    struct suiteq *fast = parse_text(tap, sizeof(tap) - 1, true);
+    assert_same_suites(slow, fast);
+    assert(count_tests(fast) == 4);
+    tailq_test *test = TAILQ_LAST(TAILQ_FIRST(fast)->tests, testq);
+    assert(test->name == NULL && test->status == STATUS_SKIP);
+    free_parsed(slow);
+    free_parsed(fast);
+
+    /* a huge plan does not make a test for every planned one */
+    const char huge[] = "1..2000000000\nok 1\nBail out!\n";
+    fast = parse_text(huge, sizeof(huge) - 1, true);
+    assert(count_tests(fast) == 1 + 1024);
+    free_parsed(fast);
+}
+
+int TestParseTestanything(int argc, char *argv[])
+{
+    test_parse_min();
+    test_comment_line();
+    test_fast_path();
+    test_diagnostics();
+    test_version();
+    test_numbers();
+    test_bail_out();
+
+    parse_concurrently(parse_testanything_arena, assert_same_suites, samples,
+                       2);
+
+    return 0;
 }
@@ -0,0 +1,140 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "parse_common.h"
+#include "parse_junit.h"
+#include "report_cache.h"
+
+#define TAP "TAP version 13\n1..2\nok 1 first\nnot ok 2 second\n"
+
+static void write_file(const char *path, const char *mode, const char *text)
+{
+    FILE *file = fopen(path, mode);
+    assert(file != NULL);
+    assert(fputs(text, file) >= 0);
+    assert(fclose(file) == 0);
+}
+
+static tailq_report *lookup(struct report_cache *cache, const char *path)
+{
+    struct stat sb;
+    assert(stat(path, &sb) == 0);
+
+    return cache_lookup(cache, path, &sb);
+}
+
+static int hit(struct report_cache *cache, const char *path)
+{
+    tailq_report *report = lookup(cache, path);
+    if (report == NULL) {
+        return 0;
+    }
+    assert(report->summary.n_pass == 1 && report->summary.n_fail == 1);
+    assert(strcmp((char *)report->path, path) == 0);
+    free_report(report);
+
+    return 1;
+}
+
+static void process(struct report_cache *cache, const char *path)
+{
+    tailq_report *report = cache_process_file(cache, path, 0);
+    assert(report != NULL && report->format == FORMAT_TAP13);
+    free_report(report);
+}
+
+/*
+ * An entry is found while a size and a modification time of a file are
+ * the same, entries that were not looked up are not saved.
+ */
+int TestReportCache(int argc, char *argv[])
+{
+    char dir[] = "/tmp/TestReportCacheXXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    char cache_path[64], a[64], b[64], c[64];
+    snprintf(cache_path, sizeof(cache_path), "%s/cache", dir);
+    snprintf(a, sizeof(a), "%s/a.tap", dir);
+    snprintf(b, sizeof(b), "%s/b.tap", dir);
+    snprintf(c, sizeof(c), "%s/c.tap", dir);
+    write_file(a, "w", TAP);
+    write_file(b, "w", TAP);
+    write_file(c, "w", TAP);
+
+    struct report_cache *cache = cache_open(cache_path);
+    assert(cache != NULL);
+    assert(!hit(cache, a));
+    process(cache, a);
+    process(cache, b);
+    process(cache, c);
+    assert(hit(cache, a));
+    assert(cache_save(cache) == 0);
+    cache_close(cache);
+
+    cache = cache_open(cache_path);
+    assert(cache != NULL && cache->index->count == 3);
+    assert(hit(cache, a));
+    assert(hit(cache, b));
+
+    /* the same modification time but another size */
+    struct stat sb;
+    assert(stat(a, &sb) == 0);
+    write_file(a, "a", "# more\n");
+    struct timeval times[2] = {
+        { sb.st_atime, 0 },
+        { sb.st_mtime, 0 }
+    };
+    assert(utimes(a, times) == 0);
+    assert(!hit(cache, a));
+
+    /* the same size but another modification time */
+    times[1].tv_sec = sb.st_mtime - 60;
+    assert(utimes(b, times) == 0);
+    assert(!hit(cache, b));
+
+    /* c is not looked up, so its file is taken as removed */
+    assert(cache_save(cache) == 0);
+    cache_close(cache);
+
+    cache = cache_open(cache_path);
+    assert(cache != NULL && cache->index->count == 2);
+    assert(!hit(cache, c));
+    assert(!hit(cache, a));
+    assert(!hit(cache, b));
+    /* a changed file is parsed again and the entry is replaced */
+    process(cache, b);
+    assert(hit(cache, b));
+    assert(cache_save(cache) == 0);
+    cache_close(cache);
+
+    /* reports parsed with other options of a parser are not served */
+    struct junit_opts opts = { 0, 0, 0 };
+    junit_set_opts(&opts);
+    cache = cache_open(cache_path);
+    assert(cache != NULL && cache->index->count == 0);
+    assert(!hit(cache, b));
+    process(cache, b);
+    assert(cache_save(cache) == 0);
+    cache_close(cache);
+    cache = cache_open(cache_path);
+    assert(cache != NULL && cache->index->count == 1);
+    assert(hit(cache, b));
+    cache_close(cache);
+    opts.text_limit = JUNIT_TEXT_LIMIT;
+    junit_set_opts(&opts);
+    cache = cache_open(cache_path);
+    assert(cache != NULL && cache->index->count == 0);
+    cache_close(cache);
+
+    unlink(a);
+    unlink(b);
+    unlink(c);
+    unlink(cache_path);
+    rmdir(dir);
+
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sqlite3.h>
+
+#include "parse_common.h"
+#include "parse_junit.h"
+#include "report_db.h"
+
+#define SAMPLE_FILE_JUNIT "samples/junit.xml"
+#define SAMPLE_DB "TestReportDB.db"
+
+/* texts left in a report file are stored in a database as texts */
+static void test_spans(void)
+{
+    const char xml[] = "<testsuite name=\"s\"><testcase name=\"t\">"
+        "<failure>a &lt; b, a failure longer than a limit</failure>"
+        "<system-out>output longer than a limit</system-out>"
+        "</testcase></testsuite>";
+    char path[] = "/tmp/TestReportDBXXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    assert(write(fd, xml, sizeof(xml) - 1) == (ssize_t)(sizeof(xml) - 1));
+    close(fd);
+
+    struct junit_opts opts = { 16, 1, 0 };
+    junit_set_opts(&opts);
+    struct reportq reports;
+    TAILQ_INIT(&reports);
+    tailq_report *report = process_file(path);
+    assert(report != NULL && report->suites != NULL);
+    tailq_test *test = TAILQ_FIRST(TAILQ_FIRST(report->suites)->tests);
+    assert(test->error == NULL && test->error_span.len != 0);
+    TAILQ_INSERT_TAIL(&reports, report, entries);
+
+    unlink(SAMPLE_DB);
+    assert(db_store_reports(SAMPLE_DB, &reports) == 0);
+    struct db_filter filter = { (char *)report->id, NULL, NULL, 0, 0 };
+    struct reportq *loaded = process_db_filter(SAMPLE_DB, &filter);
+    assert(loaded != NULL && !TAILQ_EMPTY(loaded));
+    test = TAILQ_FIRST(TAILQ_FIRST(TAILQ_FIRST(loaded)->suites)->tests);
+    assert(strcmp(test->error, "a < b, a failure longer than a limit") == 0);
+    assert(strcmp(test->system_out, "output longer than a limit") == 0);
+    free_reports(loaded);
+    free(loaded);
+
+    free_reports(&reports);
+    unlink(SAMPLE_DB);
+    unlink(path);
+    opts.text_limit = JUNIT_TEXT_LIMIT;
+    opts.text_spans = 0;
+    junit_set_opts(&opts);
+}
+
+/* number of reports with a test name starting with a string */
+static int count_search(const char *search)
+{
+    struct db_filter filter = { NULL, NULL, search, 0, 1 };
+    struct reportq *loaded = process_db_filter(SAMPLE_DB, &filter);
+    assert(loaded != NULL);
+    int n = 0;
+    tailq_report *report;
+    TAILQ_FOREACH(report, loaded, entries) {
+        n++;
+    }
+    free_reports(loaded);
+    free(loaded);
+
+    return n;
+}
+
+/* the same search in reports parsed from files */
+static int count_filter(const char *search)
+{
+    struct reportq reports;
+    TAILQ_INIT(&reports);
+    tailq_report *report = process_file(SAMPLE_FILE_JUNIT);
+    assert(report != NULL);
+    TAILQ_INSERT_TAIL(&reports, report, entries);
+    struct reportq *filtered = filter_reports(&reports, search);
+    assert(filtered != NULL);
+    int n = 0;
+    TAILQ_FOREACH(report, filtered, entries) {
+        n++;
+    }
+    free_reports(filtered);
+    free(filtered);
+    free_reports(&reports);
+
+    return n;
+}
+
+/* a search matches a prefix of a test name, wildcards literally */
+static void test_search(void)
+{
+    static const struct {
+        const char *search;
+        int n;
+    } searches[] = {
+        { "4 - inet deny", 1 },
+        { "(init)", 1 },
+        { "", 1 },
+        { "inet deny", 0 },
+        { "4 - inet deny unix and more", 0 },
+        { "*", 0 },
+        { "?", 0 },
+        { "[4]", 0 },
+        { "4 - inet*unix", 0 },
+    };
+    size_t i;
+    for (i = 0; i < sizeof(searches) / sizeof(searches[0]); i++) {
+        assert(count_search(searches[i].search) == searches[i].n);
+        assert(count_filter(searches[i].search) == searches[i].n);
+    }
+}
+
+static int count_reports(void)
+{
+    struct reportq *loaded = process_db(SAMPLE_DB);
+    assert(loaded != NULL);
+    int n = 0;
+    tailq_report *report;
+    TAILQ_FOREACH(report, loaded, entries) {
+        n++;
+    }
+    free_reports(loaded);
+    free(loaded);
+
+    return n;
+}
+
+/* ids of a database written before ids had a fixed length are rewritten */
+static void test_old_ids(struct reportq *reports)
+{
+    tailq_report *report = TAILQ_FIRST(reports);
+    sqlite3 *db;
+    assert(sqlite3_open(SAMPLE_DB, &db) == SQLITE_OK);
+    assert(sqlite3_exec(db, "UPDATE reports SET digest = 'b0a7f1';"
+                        "PRAGMA user_version = 0", NULL, NULL,
+                        NULL) == SQLITE_OK);
+    sqlite3_close(db);
+
+    /* a reader gets a digest from a path */
+    struct reportq *loaded = process_db(SAMPLE_DB);
+    assert(loaded != NULL && !TAILQ_EMPTY(loaded));
+    assert(strcmp((char *)TAILQ_FIRST(loaded)->id, "b0a7f1") == 0);
+    assert(memcmp(TAILQ_FIRST(loaded)->digest, report->digest,
+                  REPORT_DIGEST_LEN) == 0);
+    free_reports(loaded);
+    free(loaded);
+
+    /* a writer replaces a report instead of adding another one */
+    assert(db_store_reports(SAMPLE_DB, reports) == 0);
+    assert(count_reports() == 1);
+    struct db_filter filter = { (char *)report->id, NULL, NULL, 0, 1 };
+    loaded = process_db_filter(SAMPLE_DB, &filter);
+    assert(loaded != NULL && !TAILQ_EMPTY(loaded));
+    free_reports(loaded);
+    free(loaded);
+}
+
+int TestReportDB(int argc, char *argv[])
+{
+    struct reportq reports;
+    TAILQ_INIT(&reports);
+    tailq_report *report = process_file(SAMPLE_FILE_JUNIT);
+    assert(report != NULL);
+    TAILQ_INSERT_TAIL(&reports, report, entries);
+
+    unlink(SAMPLE_DB);
+    assert(db_store_reports(SAMPLE_DB, &reports) == 0);
+    /* a report with the same identifier is replaced */
+    assert(db_store_reports(SAMPLE_DB, &reports) == 0);
+    assert(check_sqlite(SAMPLE_DB) == 0);
+    assert(check_sqlite(SAMPLE_FILE_JUNIT) == 1);
+
+    struct reportq *loaded = process_db(SAMPLE_DB);
+    assert(loaded != NULL);
+    tailq_report *first = TAILQ_FIRST(loaded);
+    assert(first != NULL && TAILQ_NEXT(first, entries) == NULL);
+    assert(strcmp((char *)first->id, (char *)report->id) == 0);
+    assert(first->format == FORMAT_JUNIT);
+    assert(first->summary.n_pass == report->summary.n_pass);
+    assert(first->summary.n_fail == report->summary.n_fail);
+    free_reports(loaded);
+    free(loaded);
+
+    struct db_filter filter = { (char *)report->id, NULL, NULL, 0, 0 };
+    loaded = process_db_filter(SAMPLE_DB, &filter);
+    assert(loaded != NULL && !TAILQ_EMPTY(loaded));
+    assert(TAILQ_FIRST(loaded)->suites != NULL);
+    free_reports(loaded);
+    free(loaded);
+
+    filter.summary = 1;
+    loaded = process_db_filter(SAMPLE_DB, &filter);
+    assert(loaded != NULL && !TAILQ_EMPTY(loaded));
+    assert(TAILQ_FIRST(loaded)->suites == NULL);
+    assert(TAILQ_FIRST(loaded)->summary.n_pass == report->summary.n_pass);
+    free_reports(loaded);
+    free(loaded);
+
+    filter.report_id = "nonexistent";
+    loaded = process_db_filter(SAMPLE_DB, &filter);
+    assert(loaded != NULL && TAILQ_EMPTY(loaded));
+    free(loaded);
+
+    test_search();
+    test_old_ids(&reports);
+
+    free_reports(&reports);
+    unlink(SAMPLE_DB);
+
+    test_spans();
+
+    return 0;
+}
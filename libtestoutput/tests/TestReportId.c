@@ -0,0 +1,56 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "parse_common.h"
+
+#define SAMPLES_DIR "samples"
+#define SAMPLE_FILE_JUNIT "samples/junit.xml"
+
+int TestReportId(int argc, char *argv[])
+{
+    unsigned char digest[REPORT_DIGEST_LEN] = { 0x00, 0x0f, 0xa0, 0xff };
+    unsigned char str[2 * REPORT_DIGEST_LEN + 1];
+    digest_to_str(str, digest, REPORT_DIGEST_LEN);
+    assert(strlen((char *)str) == 2 * REPORT_DIGEST_LEN);
+    assert(strncmp((char *)str, "000fa0ff00", 10) == 0);
+
+    unsigned char back[REPORT_DIGEST_LEN];
+    assert(str_to_digest((char *)str, back) == 0);
+    assert(memcmp(back, digest, REPORT_DIGEST_LEN) == 0);
+    assert(str_to_digest("000FA0FF00000000000000000000000000000000", back) == 0);
+    assert(memcmp(back, digest, REPORT_DIGEST_LEN) == 0);
+    assert(str_to_digest("000fa0ff", back) == -1);
+    assert(str_to_digest("z00fa0ff00000000000000000000000000000000", back) == -1);
+    assert(str_to_digest(NULL, back) == -1);
+
+    /* ids of reports in a directory are found through a cache */
+    char cache[] = "/tmp/TestReportId.XXXXXX";
+    int fd = mkstemp(cache);
+    assert(fd != -1);
+    close(fd);
+    unlink(cache);
+    struct process_opts opts = { 1, cache, -1, NULL, 1 };
+    struct reportq *reports = process_dir_opts(SAMPLES_DIR, &opts);
+    assert(reports != NULL && !TAILQ_EMPTY(reports));
+
+    tailq_report *report_item = NULL;
+    TAILQ_FOREACH(report_item, reports, entries) {
+        assert(is_report_exists(reports, (char *)report_item->id) == report_item);
+        tailq_report *found = find_report(cache, (char *)report_item->id);
+        assert(found != NULL && found->suites != NULL);
+        assert(strcmp((char *)found->path, (char *)report_item->path) == 0);
+        free_report(found);
+    }
+    assert(is_report_exists(reports, "0000000000000000000000000000000000000000") == NULL);
+    assert(find_report(cache, "0000000000000000000000000000000000000000") == NULL);
+    assert(find_report(cache, "bad id") == NULL);
+
+    free_reports(reports);
+    free(reports);
+    unlink(cache);
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "parse_common.h"
+#include "parse_subunit_v1.h"
+#include "parse_subunit_v2.h"
+#include "stream.h"
+
+#define SAMPLE_FILE_TESTANYTHING "samples/testanything.tap"
+#define SAMPLE_FILE_SUBUNIT_V1 "samples/subunit_v1-min.subunit"
+#define SAMPLE_FILE_SUBUNIT_V2 "samples/subunit_v2-min.subunit"
+
+#define MAX_RESULTS 256
+
+extern struct suiteq *parse_testanything_arena(FILE *f, struct arena *arena);
+
+/* copies of tests passed to a callback */
+struct results {
+    size_t n;
+    char *names[MAX_RESULTS];
+    enum test_status statuses[MAX_RESULTS];
+    double durations[MAX_RESULTS];
+};
+
+static void on_test(const tailq_test *test, void *arg)
+{
+    struct results *results = arg;
+    assert(results->n < MAX_RESULTS);
+    results->names[results->n] = strdup(test->name ? test->name : "");
+    results->statuses[results->n] = test->status;
+    results->durations[results->n] = test->duration;
+    results->n++;
+}
+
+static void free_results(struct results *results)
+{
+    size_t i;
+    for (i = 0; i < results->n; i++) {
+        free(results->names[i]);
+    }
+    results->n = 0;
+}
+
+static char *read_sample(const char *path, size_t *len)
+{
+    FILE *file = fopen(path, "rb");
+    assert(file != NULL);
+    fseek(file, 0, SEEK_END);
+    *len = ftell(file);
+    rewind(file);
+    char *data = malloc(*len);
+    assert(data != NULL);
+    assert(fread(data, 1, *len, file) == *len);
+    fclose(file);
+
+    return data;
+}
+
+static struct suiteq *parse_sample(const char *path, enum test_format format,
+                                   struct arena *arena)
+{
+    FILE *file = fopen(path, "rb");
+    assert(file != NULL);
+    struct suiteq *suites = NULL;
+    switch (format) {
+    case FORMAT_TAP13:
+        suites = parse_testanything_arena(file, arena);
+        break;
+    case FORMAT_SUBUNIT_V1:
+        suites = parse_subunit_v1_arena(file, arena);
+        break;
+    case FORMAT_SUBUNIT_V2:
+        suites = parse_subunit_v2_arena(file, arena);
+        break;
+    case FORMAT_JUNIT:
+    case FORMAT_UNKNOWN:
+        break;
+    }
+    fclose(file);
+    assert(suites != NULL);
+
+    return suites;
+}
+
+/* a sample fed byte by byte gives the same tests as a parse of a file */
+static void test_sample(const char *path, enum test_format format)
+{
+    size_t len;
+    char *data = read_sample(path, &len);
+    struct results results = { 0 };
+    struct test_stream *s = stream_new(on_test, &results);
+    assert(s != NULL);
+    size_t i;
+    for (i = 0; i < len; i++) {
+        assert(stream_feed(s, data + i, 1) == 0);
+    }
+    assert(stream_finish(s) == 0);
+    assert(stream_format(s) == format);
+    stream_free(s);
+    free(data);
+
+    struct arena *arena = arena_new();
+    struct suiteq *suites = parse_sample(path, format, arena);
+    size_t n = 0;
+    tailq_suite *suite;
+    TAILQ_FOREACH(suite, suites, entries) {
+        tailq_test *test;
+        TAILQ_FOREACH(test, suite->tests, entries) {
+            assert(n < results.n);
+            assert(strcmp(test->name ? test->name : "", results.names[n]) == 0);
+            assert(test->status == results.statuses[n]);
+            n++;
+        }
+    }
+    assert(n == results.n);
+    assert(n > 0);
+    arena_free(arena);
+    free_results(&results);
+}
+
+/* a TAP test waits for its YAML block till the next line or an idle time */
+static void test_tap_pending()
+{
+    static const char text[] =
+        "TAP version 13\n"
+        "1..3\n"
+        "ok 1 - first\n"
+        "  ---\n"
+        "  duration_ms: 250\n"
+        "  ...\n"
+        "not ok 2 - second\n";
+    struct results results = { 0 };
+    struct test_stream *s = stream_new(on_test, &results);
+    assert(stream_feed(s, text, sizeof(text) - 1) == 0);
+    assert(results.n == 1);
+    assert(strcmp(results.names[0], "first") == 0);
+    assert(results.durations[0] > 0.24 && results.durations[0] < 0.26);
+
+    stream_idle(s);
+    assert(results.n == 2);
+    assert(results.statuses[1] == STATUS_FAILED);
+    assert(stream_feed(s, "ok 3 - third\n", 13) == 0);
+    assert(results.n == 2);
+    assert(stream_finish(s) == 0);
+    assert(results.n == 3);
+    assert(strcmp(results.names[2], "third") == 0);
+    stream_free(s);
+    free_results(&results);
+}
+
+static void test_unknown()
+{
+    char junk[SNIFF_SIZE];
+    memset(junk, 'x', sizeof(junk));
+    struct results results = { 0 };
+    struct test_stream *s = stream_new(on_test, &results);
+    assert(stream_feed(s, junk, sizeof(junk) / 2) == 0);
+    assert(stream_format(s) == FORMAT_UNKNOWN);
+    assert(stream_feed(s, junk, sizeof(junk) / 2) == -1);
+    stream_free(s);
+
+    /* nothing at all is not an error */
+    s = stream_new(on_test, &results);
+    assert(stream_finish(s) == 0);
+    stream_free(s);
+    assert(results.n == 0);
+}
+
+int TestStream(int argc, char *argv[])
+{
+    test_sample(SAMPLE_FILE_TESTANYTHING, FORMAT_TAP13);
+    test_sample(SAMPLE_FILE_SUBUNIT_V1, FORMAT_SUBUNIT_V1);
+    test_sample(SAMPLE_FILE_SUBUNIT_V2, FORMAT_SUBUNIT_V2);
+    test_tap_pending();
+    test_unknown();
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parse_common.h"
+#include "report_cache.h"
+
+#define SAMPLE_FILE_JUNIT "samples/junit.xml"
+
+int TestSummary(int argc, char *argv[])
+{
+    tailq_report *report = process_file(SAMPLE_FILE_JUNIT);
+    assert(report != NULL);
+
+    struct report_summary expected;
+    memset(&expected, 0, sizeof(expected));
+    tailq_suite *suite_item = NULL;
+    TAILQ_FOREACH(suite_item, report->suites, entries) {
+        tailq_test *test_item = NULL;
+        TAILQ_FOREACH(test_item, suite_item->tests, entries) {
+            expected.n_total++;
+            expected.total_time += test_item->duration;
+            if (class_by_status(test_item->status) == STATUS_CLASS_FAIL &&
+                test_item->duration > expected.slowest_time) {
+                expected.slowest_time = test_item->duration;
+                expected.slowest = test_item->name;
+            }
+        }
+    }
+    struct report_summary *s = &report->summary;
+    assert(s->n_total == expected.n_total);
+    assert(s->n_pass + s->n_fail + s->n_skip == s->n_total);
+    assert(s->total_time > 0 && s->total_time - expected.total_time < 1e-6 &&
+           expected.total_time - s->total_time < 1e-6);
+    assert(s->slowest != NULL && s->slowest == expected.slowest);
+
+    /* a summary is read back without suites */
+    size_t len = 0;
+    unsigned char *data = serialize_report(report, &len);
+    assert(data != NULL);
+    tailq_report *loaded = deserialize_report(data, len, 1);
+    assert(loaded != NULL && loaded->suites == NULL);
+    assert(loaded->summary.n_pass == s->n_pass);
+    assert(loaded->summary.n_fail == s->n_fail);
+    assert(loaded->summary.n_skip == s->n_skip);
+    assert(loaded->summary.n_total == s->n_total);
+    assert(loaded->summary.slowest == s->slowest);
+
+    free_report(loaded);
+    free(data);
+    free_report(report);
+
+    return 0;
+}
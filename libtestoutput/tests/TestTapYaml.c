@@ -0,0 +1,76 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap_yaml.h"
+
+static const char block[] =
+    "  # a comment\n"
+    "  message: 'it''s broken'\n"
+    "  severity: fail\n"
+    "  duration_ms: \"12.5\"\n"
+    "  got: \"a\\tb\"\n"
+    "  data:\n"
+    "    got:\n"
+    "      - 1\n"
+    "    expect: 2\n"
+    "  output: |\n"
+    "    first\n"
+    "\n"
+    "      second\n"
+    "  folded: >\n"
+    "    one\n"
+    "    two\n"
+    "  last: end\n";
+
+static void test_duration()
+{
+    double ms = 0;
+    assert(tap_yaml_duration(block, &ms) == 0);
+    assert(ms > 12.4 && ms < 12.6);
+    assert(tap_yaml_duration("  duration_ms: 3\n", &ms) == 0);
+    assert(ms > 2.9 && ms < 3.1);
+    /* only keys of the top level count */
+    assert(tap_yaml_duration("  data:\n    duration_ms: 3\n", &ms) == -1);
+    assert(tap_yaml_duration("  duration_ms: soon\n", &ms) == -1);
+    assert(tap_yaml_duration("  duration_msec: 3\n", &ms) == -1);
+    assert(tap_yaml_duration("  duration_ms: 1.5e3\n", &ms) == 0);
+    assert(ms > 1499.9 && ms < 1500.1);
+    assert(tap_yaml_duration("  duration_ms: 12ms\n", &ms) == -1);
+    assert(tap_yaml_duration("  duration_ms: 12,5\n", &ms) == -1);
+    assert(tap_yaml_duration("  duration_ms: 1e\n", &ms) == -1);
+    assert(tap_yaml_duration("  duration_ms: -1\n", &ms) == -1);
+    assert(tap_yaml_duration("", &ms) == -1);
+}
+
+static void test_parse()
+{
+    size_t n;
+    struct tap_yaml_item *items = tap_yaml_parse(block, &n);
+    assert(n == 8);
+    assert(strcmp(items[0].key, "message") == 0);
+    assert(strcmp(items[0].value, "it's broken") == 0);
+    assert(strcmp(items[1].value, "fail") == 0);
+    assert(strcmp(items[2].value, "12.5") == 0);
+    assert(strcmp(items[3].value, "a\tb") == 0);
+    assert(strcmp(items[4].key, "data") == 0);
+    assert(strcmp(items[4].value, "got:\n  - 1\nexpect: 2") == 0);
+    assert(strcmp(items[5].value, "first\n\n  second") == 0);
+    assert(strcmp(items[6].value, "one two") == 0);
+    assert(strcmp(items[7].key, "last") == 0);
+    assert(strcmp(items[7].value, "end") == 0);
+    tap_yaml_free(items, n);
+
+    items = tap_yaml_parse("", &n);
+    assert(n == 0);
+    tap_yaml_free(items, n);
+}
+
+int TestTapYaml(int argc, char *argv[])
+{
+    test_duration();
+    test_parse();
+
+    return 0;
+}
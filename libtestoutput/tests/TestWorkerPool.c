@@ -0,0 +1,95 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parse_common.h"
+#include "test_common.h"
+
+#define SAMPLES_DIR "samples"
+
+static int same_time(double a, double b)
+{
+    return a - b < 1e-9 && b - a < 1e-9;
+}
+
+static void same_tests(struct testq *a, struct testq *b)
+{
+    tailq_test *ta = TAILQ_FIRST(a);
+    tailq_test *tb = TAILQ_FIRST(b);
+    for (; ta != NULL && tb != NULL;
+         ta = TAILQ_NEXT(ta, entries), tb = TAILQ_NEXT(tb, entries)) {
+        assert(same_str(ta->name, tb->name));
+        assert(ta->status == tb->status);
+        assert(same_time(ta->duration, tb->duration));
+    }
+    assert(ta == NULL && tb == NULL);
+}
+
+static void same_suites(struct suiteq *a, struct suiteq *b)
+{
+    assert((a == NULL) == (b == NULL));
+    if (a == NULL) {
+        return;
+    }
+    tailq_suite *sa = TAILQ_FIRST(a);
+    tailq_suite *sb = TAILQ_FIRST(b);
+    for (; sa != NULL && sb != NULL;
+         sa = TAILQ_NEXT(sa, entries), sb = TAILQ_NEXT(sb, entries)) {
+        assert(same_str(sa->name, sb->name));
+        assert(sa->n_failures == sb->n_failures);
+        assert(sa->n_errors == sb->n_errors);
+        same_tests(sa->tests, sb->tests);
+    }
+    assert(sa == NULL && sb == NULL);
+}
+
+/* the same reports in the same order */
+static void same_reports(struct reportq *a, struct reportq *b)
+{
+    tailq_report *ra = TAILQ_FIRST(a);
+    tailq_report *rb = TAILQ_FIRST(b);
+    for (; ra != NULL && rb != NULL;
+         ra = TAILQ_NEXT(ra, entries), rb = TAILQ_NEXT(rb, entries)) {
+        assert(strcmp((char *)ra->path, (char *)rb->path) == 0);
+        assert(strcmp((char *)ra->id, (char *)rb->id) == 0);
+        assert(ra->format == rb->format);
+        assert(ra->summary.n_pass == rb->summary.n_pass);
+        assert(ra->summary.n_fail == rb->summary.n_fail);
+        assert(ra->summary.n_skip == rb->summary.n_skip);
+        assert(ra->summary.n_total == rb->summary.n_total);
+        assert(same_time(ra->summary.total_time, rb->summary.total_time));
+        assert(same_str(ra->summary.slowest, rb->summary.slowest));
+        same_suites(ra->suites, rb->suites);
+    }
+    assert(ra == NULL && rb == NULL);
+}
+
+static struct reportq *process_samples(int jobs, int summary)
+{
+    struct process_opts opts = { jobs, NULL, -1, NULL, summary };
+    struct reportq *reports = process_dir_opts(SAMPLES_DIR, &opts);
+    assert(reports != NULL);
+
+    return reports;
+}
+
+/* parser threads give the same reports as a sequential walk */
+int TestWorkerPool(int argc, char *argv[])
+{
+    static const int jobs[] = { 2, 4, 8, 0 };
+    int summary, i;
+    for (summary = 0; summary <= 1; summary++) {
+        struct reportq *expected = process_samples(1, summary);
+        assert(!TAILQ_EMPTY(expected));
+        for (i = 0; i < (int)(sizeof(jobs) / sizeof(jobs[0])); i++) {
+            struct reportq *reports = process_samples(jobs[i], summary);
+            same_reports(expected, reports);
+            free_reports(reports);
+            free(reports);
+        }
+        free_reports(expected);
+        free(expected);
+    }
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_common.h"
+
+#define N_THREADS 8
+#define N_ROUNDS 5
+#define MAX_SAMPLES 4
+
+struct job {
+    parse_file_fn parse;
+    same_suites_fn same;
+    const char *const *samples;
+    struct suiteq **expected;
+    int n_samples;
+    int first;
+};
+
+int same_str(const char *a, const char *b)
+{
+    return a == b || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+struct suiteq *parse_path(parse_file_fn parse, const char *path,
+                          struct arena *arena)
+{
+    FILE *file = fopen(path, "r");
+    assert(file != NULL);
+    struct suiteq *suites = parse(file, arena);
+    fclose(file);
+
+    return suites;
+}
+
+void free_parsed(struct suiteq *suites)
+{
+    free_suites(suites);
+    free(suites);
+}
+
+/* a thread parses samples in turn, nothing is left from a previous parse */
+static void *parse_job(void *arg)
+{
+    struct job *job = arg;
+    int i;
+    for (i = 0; i < N_ROUNDS * job->n_samples; i++) {
+        int n = (job->first + i) % job->n_samples;
+        struct arena *arena = arena_new();
+        assert(arena != NULL);
+        struct suiteq *suites = parse_path(job->parse, job->samples[n],
+                                           arena);
+        assert(suites != NULL && !TAILQ_EMPTY(suites));
+        job->same(suites, job->expected[n]);
+        arena_free(arena);
+    }
+
+    return NULL;
+}
+
+/* reports parsed at once are the same as parsed one by one */
+void parse_concurrently(parse_file_fn parse, same_suites_fn same,
+                        const char *const samples[], int n_samples)
+{
+    struct suiteq *expected[MAX_SAMPLES];
+    struct job jobs[N_THREADS];
+    pthread_t threads[N_THREADS];
+    int i;
+
+    assert(n_samples > 0 && n_samples <= MAX_SAMPLES);
+    for (i = 0; i < n_samples; i++) {
+        expected[i] = parse_path(parse, samples[i], NULL);
+        assert(expected[i] != NULL);
+    }
+    for (i = 0; i < N_THREADS; i++) {
+        jobs[i].parse = parse;
+        jobs[i].same = same;
+        jobs[i].samples = samples;
+        jobs[i].expected = expected;
+        jobs[i].n_samples = n_samples;
+        jobs[i].first = i % n_samples;
+        int rc = pthread_create(&threads[i], NULL, parse_job, &jobs[i]);
+        assert(rc == 0);
+    }
+    for (i = 0; i < N_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (i = 0; i < n_samples; i++) {
+        free_parsed(expected[i]);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <stdio.h>
+
+#include "arena.h"
+#include "parse_common.h"
+
+/* a parser of a report file, a NULL arena is the heap */
+typedef struct suiteq *(*parse_file_fn)(FILE *f, struct arena *arena);
+
+/* asserts that two reports are the same */
+typedef void (*same_suites_fn)(struct suiteq *a, struct suiteq *b);
+
+int same_str(const char *a, const char *b);
+struct suiteq *parse_path(parse_file_fn parse, const char *path,
+                          struct arena *arena);
+void free_parsed(struct suiteq *suites);
+void parse_concurrently(parse_file_fn parse, same_suites_fn same,
+                        const char *const samples[], int n_samples);
+
+#endif /* TEST_COMMON_H */
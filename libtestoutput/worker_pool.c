@@ -0,0 +1,282 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "worker_pool.h"
+
+/*
+ * Reports are parsed by a fixed number of threads. Paths are handed over
+ * through a bounded ring of fixed-size slots, so a producer that walks a
+ * directory is throttled by parsers and never keeps more than
+ * QUEUE_PER_JOB * jobs paths in flight. Every path gets a sequence number
+ * and pool_finish() merges parsed reports back in the order of submission.
+ */
+
+#define QUEUE_PER_JOB	4
+
+struct job {
+	size_t seq;
+	char path[PATH_MAX];
+};
+
+struct worker_pool {
+	int jobs;
+	pthread_t *threads;
+	struct report_cache *cache;
+	int summary;		/* drop suites of parsed reports */
+
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	struct job *queue;
+	size_t queue_size;
+	size_t head;		/* slot of the oldest queued job */
+	size_t count;		/* number of queued jobs */
+	int done;
+
+	size_t seq;		/* number of submitted paths */
+	tailq_report **results;
+	size_t results_size;
+
+	struct reportq *reports;
+};
+
+static void
+append_report(struct reportq *reports, tailq_report *report)
+{
+	if (report == NULL) {
+		return;
+	}
+	if (report->format == FORMAT_UNKNOWN) {
+		free_report(report);
+		return;
+	}
+	TAILQ_INSERT_TAIL(reports, report, entries);
+}
+
+static tailq_report *
+parse(struct worker_pool *pool, char *path)
+{
+	if (pool->cache != NULL) {
+		return cache_process_file(pool->cache, path, pool->summary);
+	}
+
+	tailq_report *report = process_file(path);
+	if (report != NULL && pool->summary) {
+		free_report_suites(report);
+	}
+
+	return report;
+}
+
+static void *
+worker(void *arg)
+{
+	struct worker_pool *pool = arg;
+	char path[PATH_MAX];
+	size_t seq;
+
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+		while (pool->count == 0 && !pool->done) {
+			pthread_cond_wait(&pool->not_empty, &pool->lock);
+		}
+		if (pool->count == 0) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		struct job *job = &pool->queue[pool->head];
+		seq = job->seq;
+		strcpy(path, job->path);
+		pool->head = (pool->head + 1) % pool->queue_size;
+		pool->count--;
+		pthread_cond_signal(&pool->not_full);
+		pthread_mutex_unlock(&pool->lock);
+
+		tailq_report *report = parse(pool, path);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->results[seq] = report;
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	return NULL;
+}
+
+int
+pool_default_jobs(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1) {
+		return 1;
+	}
+
+	return (int)n;
+}
+
+struct worker_pool *
+pool_create(int jobs, struct report_cache *cache, int summary)
+{
+	struct worker_pool *pool;
+	pool = calloc(1, sizeof(struct worker_pool));
+	if (pool == NULL) {
+		perror("malloc failed");
+		return NULL;
+	}
+	pool->reports = calloc(1, sizeof(struct reportq));
+	if (pool->reports == NULL) {
+		perror("malloc failed");
+		free(pool);
+		return NULL;
+	}
+	TAILQ_INIT(pool->reports);
+	pool->cache = cache;
+	pool->summary = summary;
+
+	if (jobs <= 0) {
+		jobs = pool_default_jobs();
+	}
+	if (jobs == 1) {
+		/* parse in the caller's thread */
+		pool->jobs = 1;
+		return pool;
+	}
+
+	pool->queue_size = QUEUE_PER_JOB * jobs;
+	pool->queue = calloc(pool->queue_size, sizeof(struct job));
+	pool->threads = calloc(jobs, sizeof(pthread_t));
+	if (pool->queue == NULL || pool->threads == NULL) {
+		perror("malloc failed");
+		free(pool->queue);
+		free(pool->threads);
+		pool->queue = NULL;
+		pool->threads = NULL;
+		pool->jobs = 1;
+		return pool;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->not_empty, NULL);
+	pthread_cond_init(&pool->not_full, NULL);
+
+	int i;
+	for (i = 0; i < jobs; i++) {
+		if (pthread_create(&pool->threads[i], NULL, worker, pool) != 0) {
+			perror("pthread_create");
+			break;
+		}
+	}
+	pool->jobs = i;
+	if (pool->jobs == 0) {
+		/* no threads at all, fall back to a sequential mode */
+		pool->jobs = 1;
+		free(pool->threads);
+		pool->threads = NULL;
+	}
+
+	return pool;
+}
+
+int
+pool_submit(struct worker_pool *pool, const char *path)
+{
+	if (strlen(path) >= PATH_MAX) {
+		fprintf(stderr, "path is too long %s\n", path);
+		return -1;
+	}
+	if (pool->threads == NULL) {
+		append_report(pool->reports, parse(pool, (char *)path));
+		return 0;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->seq == pool->results_size) {
+		size_t size = pool->results_size ? pool->results_size * 2 : 64;
+		tailq_report **results;
+		results = realloc(pool->results, size * sizeof(tailq_report *));
+		if (results == NULL) {
+			perror("malloc failed");
+			pthread_mutex_unlock(&pool->lock);
+			return -1;
+		}
+		memset(results + pool->results_size, 0,
+		    (size - pool->results_size) * sizeof(tailq_report *));
+		pool->results = results;
+		pool->results_size = size;
+	}
+	while (pool->count == pool->queue_size) {
+		pthread_cond_wait(&pool->not_full, &pool->lock);
+	}
+	struct job *job;
+	job = &pool->queue[(pool->head + pool->count) % pool->queue_size];
+	job->seq = pool->seq++;
+	strcpy(job->path, path);
+	pool->count++;
+	pthread_cond_signal(&pool->not_empty);
+	pthread_mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+struct reportq *
+pool_finish(struct worker_pool *pool)
+{
+	struct reportq *reports = pool->reports;
+
+	if (pool->threads != NULL) {
+		pthread_mutex_lock(&pool->lock);
+		pool->done = 1;
+		pthread_cond_broadcast(&pool->not_empty);
+		pthread_mutex_unlock(&pool->lock);
+
+		int i;
+		for (i = 0; i < pool->jobs; i++) {
+			pthread_join(pool->threads[i], NULL);
+		}
+
+		size_t n;
+		for (n = 0; n < pool->seq; n++) {
+			append_report(reports, pool->results[n]);
+		}
+
+		pthread_cond_destroy(&pool->not_full);
+		pthread_cond_destroy(&pool->not_empty);
+		pthread_mutex_destroy(&pool->lock);
+		free(pool->threads);
+	}
+	free(pool->results);
+	free(pool->queue);
+	free(pool);
+
+	return reports;
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <parse_common.h>
+#include <stream.h>
+
+#include "live.h"
+#include "testres.h"
+#include "ui_common.h"
+
+/*
+ * Follow a report that is still being written to standard input or to a
+ * named pipe. Counters are updated with every test and shown in a single
+ * progress line, failed tests are printed as they come. Tests are not
+ * kept, so a run of any length takes the same memory.
+ *
+ * On a terminal a progress line is redrawn in place at most every
+ * REDRAW_INTERVAL seconds, otherwise a new line is printed at most once
+ * in PRINT_INTERVAL seconds, so that a log is not flooded.
+ */
+
+#define READ_SIZE	(64 * 1024)
+#define IDLE_TIMEOUT	500	/* ms */
+#define REDRAW_INTERVAL	0.1
+#define PRINT_INTERVAL	1.0
+
+struct live {
+	int tty;
+	int shown;		/* a progress line is on a terminal */
+	int changed;		/* tests came after a progress line */
+	double printed;		/* when a progress line was printed */
+	unsigned long n_pass;
+	unsigned long n_fail;
+	unsigned long n_skip;
+	double time;
+	char *slowest;		/* the slowest failed test */
+	size_t slowest_size;
+	double slowest_time;
+};
+
+static volatile sig_atomic_t stop = 0;
+
+static void
+on_signal(int sig)
+{
+	stop = 1;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* a progress line is removed before anything else is printed */
+static void
+clear_progress(struct live *l)
+{
+	if (l->shown) {
+		printf("\r\033[K");
+		l->shown = 0;
+	}
+}
+
+static void
+print_progress(struct live *l, int force)
+{
+	double t = now();
+	if (!force && t - l->printed < (l->tty ? REDRAW_INTERVAL :
+					  PRINT_INTERVAL)) {
+		return;
+	}
+	l->printed = t;
+	l->changed = 0;
+
+	clear_progress(l);
+	printf("%lu tests, %lu passed, %lu failed, %lu skipped, %.3f sec",
+	       l->n_pass + l->n_fail + l->n_skip, l->n_pass, l->n_fail,
+	       l->n_skip, l->time);
+	if (l->slowest != NULL) {
+		printf(", slowest %s %.3f sec", l->slowest, l->slowest_time);
+	}
+	if (l->tty) {
+		l->shown = 1;
+	} else {
+		printf("\n");
+	}
+	fflush(stdout);
+}
+
+static void
+note_slowest(struct live *l, const tailq_test *test)
+{
+	const char *name = test->name ? test->name : "";
+	size_t len = strlen(name) + 1;
+	if (len > l->slowest_size) {
+		char *s = realloc(l->slowest, len);
+		if (s == NULL) {
+			perror("malloc failed");
+			return;
+		}
+		l->slowest = s;
+		l->slowest_size = len;
+	}
+	memcpy(l->slowest, name, len);
+	l->slowest_time = test->duration;
+}
+
+static void
+on_test(const tailq_test *test, void *arg)
+{
+	struct live *l = arg;
+	switch (class_by_status(test->status)) {
+	case STATUS_CLASS_PASS:
+		l->n_pass++;
+		break;
+	case STATUS_CLASS_FAIL:
+		l->n_fail++;
+		clear_progress(l);
+		printf("%5s %s\n", format_status(test->status),
+		       test->name ? test->name : "");
+		/* as in a summary, only a slow failed test is the slowest */
+		if (test->duration > SLOWEST_THRESHOLD &&
+		    test->duration > l->slowest_time) {
+			note_slowest(l, test);
+		}
+		break;
+	case STATUS_CLASS_SKIP:
+		l->n_skip++;
+		break;
+	}
+	l->changed = 1;
+	l->time += test->duration;
+	print_progress(l, 0);
+}
+
+int
+live_report(const char *path)
+{
+	int fd = STDIN_FILENO;
+	if (strcmp(path, "-") != 0 && (fd = open(path, O_RDONLY)) == -1) {
+		perror("open");
+		return 1;
+	}
+	char *buf = malloc(READ_SIZE);
+	struct live l;
+	memset(&l, 0, sizeof(l));
+	l.tty = isatty(STDOUT_FILENO);
+	struct test_stream *s = stream_new(on_test, &l);
+	if (buf == NULL || s == NULL) {
+		if (buf == NULL) {
+			perror("malloc failed");
+		}
+		free(buf);
+		stream_free(s);
+		if (fd != STDIN_FILENO) {
+			close(fd);
+		}
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	int rc = 0;
+	while (rc == 0 && !stop) {
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		int n = poll(&pfd, 1, IDLE_TIMEOUT);
+		if (n == -1) {
+			if (errno != EINTR) {
+				perror("poll");
+				rc = 1;
+			}
+			continue;
+		}
+		if (n == 0) {
+			/* a writer is quiet, show what is known by now */
+			stream_idle(s);
+			if (l.changed) {
+				print_progress(&l, 1);
+			}
+			continue;
+		}
+		ssize_t len = read(fd, buf, READ_SIZE);
+		if (len == -1) {
+			if (errno != EINTR && errno != EAGAIN) {
+				perror("read");
+				rc = 1;
+			}
+			continue;
+		}
+		if (len == 0) {
+			break;
+		}
+		if (stream_feed(s, buf, len) != 0) {
+			rc = 1;
+		}
+	}
+	if (rc == 0 && stream_finish(s) != 0) {
+		rc = 1;
+	}
+	if (rc == 0 || l.changed) {
+		print_progress(&l, 1);
+	}
+	if (l.shown) {
+		printf("\n");
+	}
+
+	stream_free(s);
+	free(l.slowest);
+	free(buf);
+	if (fd != STDIN_FILENO) {
+		close(fd);
+	}
+
+	return rc;
+}
@@ -27,26 +27,23 @@
  */
 
 #include <math.h>
+#include <columns.h>
+#include <intern.h>
 #include <parse_common.h>
 
 #include "metrics.h"
 #include "testres.h"
 
-/* FIXME: passed, failed and skipped calculated twice */
 double metric_pass_rate(struct tailq_report *report) {
 
-    int passed = num_by_status_class(report, STATUS_CLASS_PASS);
-    int failed = num_by_status_class(report, STATUS_CLASS_FAIL);
-    int skipped = num_by_status_class(report, STATUS_CLASS_SKIP);
-    if (!report || (passed + failed + skipped == 0))
+    if (!report)
+       return 0;
+    struct report_summary *s = &report->summary;
+    int total = s->n_pass + s->n_fail + s->n_skip;
+    if (total == 0)
        return 0;
 
-    double num = 0;
-    if (report->suites != NULL) {
-       num = (double)passed / (double)(passed + failed + skipped) * 100;
-    } else {
-       num = 0;
-    }
+    double num = (double)s->n_pass / (double)total * 100;
 
     return round(num);
 }
@@ -55,20 +52,23 @@ double metric_tc_avg_time(struct reportq *reports, char *tc_name) {
    int total_num = 0;
    double total_time = 0;
 
+   /* names of tests are interned, a name seen nowhere is in no report */
+   uint32_t name_id = intern_id(intern_find(tc_name));
+   if (name_id == 0) {
+      return 0;
+   }
+
    tailq_report *report_item = NULL;
    TAILQ_FOREACH(report_item, reports, entries) {
-      if (report_item->suites != NULL) {
-         tailq_suite *suite_item = NULL;
-         TAILQ_FOREACH(suite_item, report_item->suites, entries) {
-            if (!TAILQ_EMPTY(suite_item->tests)) {
-               tailq_test *test_item = NULL;
-               TAILQ_FOREACH(test_item, suite_item->tests, entries) {
-                  if (strcmp(test_item->name, tc_name) == 0) {
-			total_time += atof(test_item->time);
-			total_num++;
-		  }
-               }
-            }
+      struct test_columns *cols = report_columns(report_item);
+      if (cols == NULL) {
+         continue;
+      }
+      size_t i;
+      for (i = 0; i < cols->n; i++) {
+         if (cols->name_id[i] == name_id) {
+            total_time += cols->duration[i];
+            total_num++;
          }
       }
    }
@@ -85,24 +85,24 @@ int metric_apfd(struct reportq *reports, char *tc_name) {
 
    int total_num = 0;
    int failed_num = 0;
-   double total_time = 0;
+
+   uint32_t name_id = intern_id(intern_find(tc_name));
+   if (name_id == 0) {
+      return 0;
+   }
 
    tailq_report *report_item = NULL;
    TAILQ_FOREACH(report_item, reports, entries) {
-      if (report_item->suites != NULL) {
-         tailq_suite *suite_item = NULL;
-         TAILQ_FOREACH(suite_item, report_item->suites, entries) {
-            if (!TAILQ_EMPTY(suite_item->tests)) {
-               tailq_test *test_item = NULL;
-               TAILQ_FOREACH(test_item, suite_item->tests, entries) {
-                  if (strcmp(test_item->name, tc_name) == 0) {
-					 total_time += atof(test_item->time);
-					 total_num++;
-					 if (class_by_status(test_item->status) == STATUS_CLASS_FAIL) {
-						failed_num++;
-					 }
-			      }
-               }
+      struct test_columns *cols = report_columns(report_item);
+      if (cols == NULL) {
+         continue;
+      }
+      size_t i;
+      for (i = 0; i < cols->n; i++) {
+         if (cols->name_id[i] == name_id) {
+            total_num++;
+            if (class_by_status(cols->status[i]) == STATUS_CLASS_FAIL) {
+               failed_num++;
             }
          }
       }
@@ -116,49 +116,18 @@ int metric_apfd(struct reportq *reports, char *tc_name) {
 
 char *metric_slowest_testcase(struct tailq_report *report) {
 
-	if ((!report) || (!report->suites)) {
+	if ((!report) || (report->summary.slowest_time <= SLOWEST_THRESHOLD)) {
 	  return NULL;
-        }
-
-	char *slowest = NULL;
-	double time = 0;
-	tailq_suite *suite_item = NULL;
-	TAILQ_FOREACH(suite_item, report->suites, entries) {
-		if (!TAILQ_EMPTY(suite_item->tests)) {
-			tailq_test *test_item = NULL;
-			TAILQ_FOREACH(test_item, suite_item->tests, entries) {
-				if ((class_by_status(test_item->status) == STATUS_CLASS_FAIL) &&
-					(test_item->time)) {
-					double t = atof(test_item->time);
-					if ((t > time) && (t > SLOWEST_THRESHOLD)) {
-						time = t;
-						slowest = (char*)test_item->name;
-					}
-				}
-			}
-		}
 	}
 
-	return slowest;
+	return (char *)report->summary.slowest;
 }
 
 double metric_total_time(struct tailq_report *report) {
 
-	if ((!report) || (!report->suites)) {
+	if (!report) {
 	  return 0;
-        }
-
-	double time = 0;
-	tailq_suite *suite_item = NULL;
-	TAILQ_FOREACH(suite_item, report->suites, entries) {
-		if (!TAILQ_EMPTY(suite_item->tests)) {
-			tailq_test *test_item = NULL;
-			TAILQ_FOREACH(test_item, suite_item->tests, entries) {
-				if (test_item->time)
-				  time += atof(test_item->time);
-			}
-		}
 	}
 
-	return time;
+	return report->summary.total_time;
 }
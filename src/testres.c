@@ -36,17 +36,22 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <parse_common.h>
+#include <parse_junit.h>
+#include <parse_subunit_v2.h>
+#include <report_db.h>
 
+#include "live.h"
 #include "metrics.h"
 #include "testres.h"
 #include "ui_console.h"
 #include "ui_http.h"
+#include "watch.h"
 
 void
 usage(char *path)
 {
 	char *progname = basename(path);
-	fprintf(stderr, "Usage: %s [-s file | -h | -v]\n", progname);
+	fprintf(stderr, "Usage: %s [-s file [-j jobs] | -s - | -s dir [-w] [-j jobs] [-c cache] [-d depth] [-p pattern] | -s db] [-t limit [-l]] [-o db] [-h | -v]\n", progname);
 }
 
 int
@@ -54,8 +59,15 @@ main(int argc, char *argv[])
 {
 	char *path = NULL;
 	int opt = 0;
+	int watch = 0;
+	char *db = NULL;
+	struct process_opts opts = {
+		.jobs = 0, .cache = NULL, .depth = -1, .pattern = NULL,
+		.summary = 1
+	};
+	struct junit_opts junit = { JUNIT_TEXT_LIMIT, 0, 0 };
 
-	while ((opt = getopt(argc, argv, "vhs:")) != -1) {
+	while ((opt = getopt(argc, argv, "vhws:j:c:d:p:t:lo:")) != -1) {
 		switch (opt) {
 		case 'h':
 			usage(argv[0]);
@@ -64,7 +76,37 @@ main(int argc, char *argv[])
 			printf("%s\n", VERSION);
 			return 0;
 		case 's':
-			path = realpath(optarg, path);
+			/* "-" is standard input */
+			path = strcmp(optarg, "-") == 0 ? strdup(optarg) :
+			       realpath(optarg, path);
+			break;
+		case 'w':
+			watch = 1;
+			break;
+		case 'j':
+			opts.jobs = atoi(optarg);
+			if (opts.jobs < 0) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'c':
+			opts.cache = optarg;
+			break;
+		case 'd':
+			opts.depth = atoi(optarg);
+			break;
+		case 'p':
+			opts.pattern = optarg;
+			break;
+		case 't':
+			junit.text_limit = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			junit.text_spans = 1;
+			break;
+		case 'o':
+			db = optarg;
 			break;
 		default:	/* '?' */
 			usage(argv[0]);
@@ -72,11 +114,24 @@ main(int argc, char *argv[])
 		}
 	}
 
-	if (argc == 1) {
+	junit_set_opts(&junit);
+
+	if (db != NULL) {
+		/* a database keeps suites and tests */
+		opts.summary = 0;
+	}
+
+	if (argc == 1 || path == NULL) {
 		usage(argv[0]);
 		return 1;
 	}
 
+	if (strcmp(path, "-") == 0) {
+		int rc = live_report(path);
+		free(path);
+		return rc;
+	}
+
 	struct stat path_st;
 	if (stat(path, &path_st) == -1) {
 	   perror("stat");
@@ -84,13 +139,58 @@ main(int argc, char *argv[])
 	   return 1;
 	}
 
-	struct tailq_report *report = NULL;
-	if (S_ISREG(path_st.st_mode) && (report = process_file(path))) {
-		print_report(report);
-		free_report(report);
+	if (S_ISFIFO(path_st.st_mode)) {
+		int rc = live_report(path);
 		free(path);
-	} else {
+		return rc;
+	}
+
+	if (watch && S_ISDIR(path_st.st_mode)) {
+		int rc = watch_dir(path, &opts);
+		free(path);
+		return rc;
+	}
+
+	struct tailq_report *report = NULL;
+	struct reportq *reports = NULL;
+	if (S_ISREG(path_st.st_mode)) {
+		/* threads decode a single large report */
+		subunit_v2_set_jobs(opts.jobs);
+	}
+	if (S_ISREG(path_st.st_mode) && check_sqlite(path) == 0) {
+		reports = process_db(path);
+	} else if (S_ISREG(path_st.st_mode) && (report = process_file(path))) {
+		if (db == NULL) {
+			print_report(report);
+			free_report(report);
+			free(path);
+			return 0;
+		}
+		reports = calloc(1, sizeof(struct reportq));
+		if (reports == NULL) {
+			perror("malloc failed");
+			free_report(report);
+			free(path);
+			return 1;
+		}
+		TAILQ_INIT(reports);
+		TAILQ_INSERT_TAIL(reports, report, entries);
+	} else if (S_ISDIR(path_st.st_mode)) {
+		reports = process_dir_opts(path, &opts);
+	}
+	free(path);
+	if (reports == NULL) {
 		fprintf(stderr, "Unsupported file format");
+		return 1;
+	}
+
+	int rc = 0;
+	if (db != NULL) {
+		rc = db_store_reports(db, reports) == 0 ? 0 : 1;
+	} else {
+		print_reports(reports);
 	}
-	return 0;
+	free_reports(reports);
+	free(reports);
+	return rc;
 }
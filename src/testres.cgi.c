@@ -28,10 +28,16 @@
 
 #include <string.h>
 #include <parse_common.h>
+#include <report_db.h>
 
 #include "ui_http.h"
 
 #define REPORTS_DIR "./reports"
+#define REPORTS_JOBS 0		/* parser threads, 0 - one per online CPU */
+#define REPORTS_CACHE "./reports.cache"
+#define REPORTS_DEPTH -1		/* depth of subdirectories, -1 - no limit */
+#define REPORTS_PATTERN NULL	/* fnmatch(3) pattern for report names */
+#define REPORTS_DB "./reports.db"	/* used instead of REPORTS_DIR if exists */
 
 struct config {
 	char *cgi_action;
@@ -41,6 +47,7 @@ struct config {
 typedef struct config config;
 
 void  cgi_parse(char *query_string, struct config *conf);
+int main_db(struct config *conf);
 
 void cgi_parse(char *query_string, struct config *conf) {
 	conf->cgi_action = NULL;
@@ -50,6 +57,43 @@ void cgi_parse(char *query_string, struct config *conf) {
 		conf->cgi_args = strtok(NULL, "=");
 }
 
+/*
+ * Answer a request with indexed queries to a database, so only reports
+ * that are shown are loaded into memory.
+ */
+int main_db(struct config *conf) {
+	struct db_filter filter = { NULL, NULL, NULL, 0, 1 };
+	if (conf->cgi_action && conf->cgi_args) {
+		if (!strcmp(conf->cgi_action, "show"))
+			filter.report_id = conf->cgi_args;
+		else if (!strcmp(conf->cgi_action, "q"))
+			filter.search = conf->cgi_args;
+	}
+	/* only a shown report needs suites */
+	filter.summary = filter.report_id == NULL;
+
+	struct reportq *reports = process_db_filter(REPORTS_DB, &filter);
+	if (!reports) {
+		print_html_headers();
+		printf("no reports found\n");
+		print_html_footer();
+		return 1;
+	}
+
+	print_html_headers();
+	tailq_report *report = TAILQ_FIRST(reports);
+	if (filter.report_id) {
+		if (report)
+			print_html_report(report);
+	} else {
+		print_html_reports(reports);
+	}
+	print_html_footer();
+	free_reports(reports);
+	free(reports);
+	return 0;
+}
+
 int main(void) {
 	config *conf = calloc(1, sizeof(config));
 	if (!conf) {
@@ -59,7 +103,40 @@ int main(void) {
 		return 1;
 	}
 
-	struct reportq *reports = process_dir(REPORTS_DIR);
+	char *query_string = getenv("QUERY_STRING");
+	cgi_parse(query_string, conf);
+
+	if (check_sqlite(REPORTS_DB) == 0) {
+		int rc = main_db(conf);
+		free(conf);
+		return rc;
+	}
+
+	/* a cache knows a file of a report, a directory is not walked */
+	if (conf->cgi_action && conf->cgi_args &&
+	    !strcmp(conf->cgi_action, "show")) {
+		tailq_report *report = find_report(REPORTS_CACHE, conf->cgi_args);
+		if (report != NULL) {
+			print_html_headers();
+			print_html_report(report);
+			print_html_footer();
+			free_report(report);
+			free(conf);
+			return 0;
+		}
+	}
+
+	/* a search looks at tests, other pages need summaries only */
+	int search = conf->cgi_action && conf->cgi_args &&
+		     !strcmp(conf->cgi_action, "q");
+	struct process_opts opts = {
+		.jobs = REPORTS_JOBS,
+		.cache = REPORTS_CACHE,
+		.depth = REPORTS_DEPTH,
+		.pattern = REPORTS_PATTERN,
+		.summary = !search
+	};
+	struct reportq *reports = process_dir_opts(REPORTS_DIR, &opts);
 	if (!reports) {
 		print_html_headers();
 		printf("no reports found\n");
@@ -67,24 +144,24 @@ int main(void) {
 		return 1;
 	}
 
-	char *query_string = getenv("QUERY_STRING");
-	cgi_parse(query_string, conf);
-
 	print_html_headers();
 	if (!(conf->cgi_action && conf->cgi_args)) {
 		print_html_reports(reports);
 	} else {
 		if (!strcmp(conf->cgi_action, "show")) {
 			tailq_report *report;
-			if ((report = is_report_exists(reports, conf->cgi_args))) {
+			if ((report = is_report_exists(reports, conf->cgi_args)) &&
+			    load_suites(report, REPORTS_CACHE) == 0) {
 				print_html_report(report);
-				free_report(report);
 			}
 		} else if (!strcmp(conf->cgi_action, "q")) {
 			struct reportq *filtered = NULL;
 			filtered = filter_reports(reports, conf->cgi_args);
-			print_html_reports(filtered);
-			free_reports(filtered);
+			if (filtered != NULL) {
+				print_html_reports(filtered);
+				free_reports(filtered);
+				free(filtered);
+			}
 		} else {
 			print_html_reports(reports);
 		}
@@ -92,5 +169,6 @@ int main(void) {
 	print_html_footer();
 	free(conf);
 	free_reports(reports);
+	free(reports);
 	return 0;
 }
@@ -26,9 +26,15 @@
  *
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "metrics.h"
 #include "testres.h"
 #include "parse_common.h"
+#include "parse_junit.h"
+#include "tap_yaml.h"
 #include "ui_console.h"
 #include "ui_common.h"
 
@@ -36,7 +42,7 @@ void
 print_report(struct tailq_report *report) {
     if (report->suites) {
 	if (!TAILQ_EMPTY(report->suites)) {
-	    print_suites(report->suites);
+	    print_suites(report->suites, (const char *)report->path);
 	} else {
 	    printf("None suites.\n");
 	}
@@ -82,7 +88,7 @@ print_reports(struct reportq *reports)
 }
 
 void
-print_suites(struct suiteq * suites)
+print_suites(struct suiteq * suites, const char *path)
 {
 	tailq_suite *suite_item = NULL;
 	TAILQ_FOREACH(suite_item, suites, entries) {
@@ -92,15 +98,53 @@ print_suites(struct suiteq * suites)
 		}
 		printf("\nSuite: %s\n", name);
 		if (!TAILQ_EMPTY(suite_item->tests)) {
-			print_tests(suite_item->tests);
+			print_tests(suite_item->tests, path);
 		} else {
 			printf("None tests.\n");
 		}
 	}
 }
 
+/* diagnostics of a failed TAP test are parsed when it is shown */
+static void
+print_diagnostics(const char *yaml)
+{
+	size_t n, i;
+	struct tap_yaml_item *items = tap_yaml_parse(yaml, &n);
+	for (i = 0; i < n; i++) {
+		const char *value = items[i].value;
+		printf("%12s%s:", "", items[i].key);
+		if (strchr(value, '\n') == NULL) {
+			printf(" %s\n", value);
+			continue;
+		}
+		while (*value != '\0') {
+			size_t len = strcspn(value, "\n");
+			printf("\n%14s%.*s", "", (int)len, value);
+			value += len + (value[len] == '\n');
+		}
+		printf("\n");
+	}
+	tap_yaml_free(items, n);
+}
+
+/* a failure of a test, it is read from a report file when left there */
+static void
+print_error(const char *path, const tailq_test *test)
+{
+	char *copy;
+	const char *text = junit_text(path, test->error, &test->error_span,
+				      &copy);
+	while (text != NULL && *text != '\0') {
+		size_t len = strcspn(text, "\n");
+		printf("%12s%.*s\n", "", (int)len, text);
+		text += len + (text[len] == '\n');
+	}
+	free(copy);
+}
+
 void
-print_tests(struct testq * tests)
+print_tests(struct testq * tests, const char *path)
 {
 	static int n = 1;
 	const int name_width = 53;
@@ -115,6 +159,12 @@ print_tests(struct testq * tests)
 		if (test_item->time != NULL)
 		    printf("%3.4s sec", test_item->time);
 		printf("\n");
+		if (class_by_status(test_item->status) == STATUS_CLASS_FAIL) {
+			if (test_item->diagnostics != NULL) {
+				print_diagnostics(test_item->diagnostics);
+			}
+			print_error(path, test_item);
+		}
 		n++;
 	}
 }
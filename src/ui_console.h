@@ -32,7 +32,7 @@
 void print_report_summary(struct tailq_report * report);
 void print_reports(struct reportq *reports_head);
 void print_report(struct tailq_report *report);
-void print_suites(struct suiteq *suites_head);
-void print_tests(struct testq *tests_head);
+void print_suites(struct suiteq *suites_head, const char *path);
+void print_tests(struct testq *tests_head, const char *path);
 
 #endif				/* UI_CONSOLE_H */
@@ -27,18 +27,78 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include <sys/types.h>
 
 #include "metrics.h"
 #include "parse_common.h"
+#include "parse_junit.h"
+#include "tap_yaml.h"
 #include "testres.h"
 #include "ui_common.h"
 #include "ui_http.h"
 
 extern char **environ;
 
+static void
+print_escaped(const char *s)
+{
+	for (; *s != '\0'; s++) {
+		switch (*s) {
+		case '<':
+			printf("&lt;");
+			break;
+		case '>':
+			printf("&gt;");
+			break;
+		case '&':
+			printf("&amp;");
+			break;
+		default:
+			putchar(*s);
+		}
+	}
+}
+
+/* diagnostics of a failed TAP test are parsed when it is shown */
+static void
+print_html_diagnostics(const char *yaml)
+{
+	size_t n, i;
+	struct tap_yaml_item *items = tap_yaml_parse(yaml, &n);
+	if (n == 0) {
+		tap_yaml_free(items, n);
+		return;
+	}
+	printf("<tr><td colspan=\"4\"><pre>\n");
+	for (i = 0; i < n; i++) {
+		print_escaped(items[i].key);
+		printf(":%s", strchr(items[i].value, '\n') != NULL ? "\n" : " ");
+		print_escaped(items[i].value);
+		printf("\n");
+	}
+	printf("</pre></td></tr>\n");
+	tap_yaml_free(items, n);
+}
+
+/* a failure of a test, it is read from a report file when left there */
+static void
+print_html_error(const char *path, const tailq_test *test)
+{
+	char *copy;
+	const char *text = junit_text(path, test->error, &test->error_span,
+				      &copy);
+	if (text != NULL && *text != '\0') {
+		printf("<tr><td colspan=\"4\"><pre>\n");
+		print_escaped(text);
+		printf("\n</pre></td></tr>\n");
+	}
+	free(copy);
+}
+
 void print_html_headers() {
     printf("Content-Type: text/html;charset=utf-8\n\n");
     printf("<!DOCTYPE html>\n");
@@ -95,13 +155,12 @@ print_html_reports(struct reportq * reports) {
 	    } else {
 	       printf("<td><span class=\"label fail\">%0.0f</span></td>\n", perc);
 	    }
+	    /* a row needs a summary only, suites are not loaded */
+	    struct report_summary *summary = &report_item->summary;
 	    printf("<td>\n");
-	    printf("<span class=\"label pass\">%d</span>\n",
-			num_by_status_class(report_item, STATUS_CLASS_PASS));
-	    printf("<span class=\"label fail\">%d</span>\n",
-			num_by_status_class(report_item, STATUS_CLASS_FAIL));
-	    printf("<span class=\"label skip\">%d</span>\n",
-			num_by_status_class(report_item, STATUS_CLASS_SKIP));
+	    printf("<span class=\"label pass\">%d</span>\n", summary->n_pass);
+	    printf("<span class=\"label fail\">%d</span>\n", summary->n_fail);
+	    printf("<span class=\"label skip\">%d</span>\n", summary->n_skip);
 	    printf("</td>\n");
 
         struct tm *date = localtime(&report_item->time);
@@ -134,12 +193,12 @@ print_html_report(struct tailq_report * report) {
     printf("</table>\n");
     printf("<br>\n");	/* FIXME */
     if (!TAILQ_EMPTY(report->suites)) {
-       print_html_suites(report->suites);
+       print_html_suites(report->suites, (const char *)report->path);
     }
 }
 
 void
-print_html_suites(struct suiteq * suites) {
+print_html_suites(struct suiteq * suites, const char *path) {
     tailq_suite *suite_item = NULL;
     printf("<table>\n");
     printf("<tr>\n");
@@ -150,14 +209,14 @@ print_html_suites(struct suiteq * suites) {
     printf("</tr>\n");
     TAILQ_FOREACH(suite_item, suites, entries) {
 	if (!TAILQ_EMPTY(suite_item->tests)) {
-		print_html_tests(suite_item->tests);
+		print_html_tests(suite_item->tests, path);
 	}
     }
     printf("</table>\n");
 }
 
 void
-print_html_tests(struct testq * tests) {
+print_html_tests(struct testq * tests, const char *path) {
     tailq_test *test_item = NULL;
     TAILQ_FOREACH(test_item, tests, entries) {
 	printf("<tr>\n");
@@ -172,6 +231,12 @@ print_html_tests(struct testq * tests) {
 	printf("<td>%3.4s</td>\n", test_item->time);
 	printf("<td></td>\n");
 	printf("</tr>\n");
+	if (class_by_status(test_item->status) == STATUS_CLASS_FAIL) {
+		if (test_item->diagnostics != NULL) {
+			print_html_diagnostics(test_item->diagnostics);
+		}
+		print_html_error(path, test_item);
+	}
     }
 }
 
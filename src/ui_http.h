@@ -33,8 +33,8 @@ void print_html_headers();
 void print_html_footer();
 void print_html_reports(struct reportq * reports);
 void print_html_report(struct tailq_report *report);
-void print_html_suites(struct suiteq * suites);
-void print_html_tests(struct testq * tests);
+void print_html_suites(struct suiteq * suites, const char *path);
+void print_html_tests(struct testq * tests, const char *path);
 void print_html_env();
 void print_plot(struct reportq *reports);
 
@@ -0,0 +1,468 @@
+/*
+ * Copyright © 2020 Sergey Bronnikov
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdio.h>
+#include <parse_common.h>
+
+#include "watch.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include <columns.h>
+#include <dir_walk.h>
+#include <hashmap.h>
+#include <input.h>
+#include <intern.h>
+#include <report_cache.h>
+
+#include "ui_console.h"
+
+/*
+ * Keep an up-to-date list of reports in a directory tree. Every directory
+ * has an inotify watch, a file is parsed again when it is closed after
+ * writing or moved into a tree and dropped when it is removed, so a cost
+ * of an update depends on a changed file only. A cache, if any, is written
+ * at most once in SAVE_INTERVAL seconds.
+ *
+ * Names of tests are interned while a report is parsed, but only names of
+ * the slowest tests stay in summaries. Interned strings are compacted when
+ * their number has doubled since the last time, so a table of them is
+ * bounded by twice the strings that summaries use plus INTERN_SLACK.
+ */
+
+#define WATCH_EVENTS	(IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | \
+			 IN_DELETE | IN_CREATE | IN_DELETE_SELF)
+#define SAVE_INTERVAL	5
+#define INTERN_SLACK	4096
+
+struct watch {
+	int wd;
+	char *path;
+};
+
+struct watcher {
+	int fd;
+	const char *root;
+	struct process_opts *opts;
+	struct report_cache *cache;
+	struct reportq *reports;
+	struct hashmap *by_path;	/* path -> tailq_report */
+	struct hashmap *by_wd;		/* wd -> struct watch */
+	int dirty;
+	time_t saved;
+	size_t interned;	/* strings kept by the last compaction */
+};
+
+static volatile sig_atomic_t stop = 0;
+
+static void
+on_signal(int sig)
+{
+	stop = 1;
+}
+
+static int
+depth_of(struct watcher *w, const char *path)
+{
+	int depth = 0;
+	const char *p;
+	for (p = path + strlen(w->root); *p; p++) {
+		if (*p == '/') {
+			depth++;
+		}
+	}
+
+	return depth;
+}
+
+static int
+forget_file(struct watcher *w, const char *path)
+{
+	tailq_report *report = hashmap_remove(w->by_path, path, strlen(path));
+	if (report == NULL) {
+		return 0;
+	}
+	TAILQ_REMOVE(w->reports, report, entries);
+	free_report(report);
+
+	return 1;
+}
+
+static void
+drop_file(struct watcher *w, const char *path)
+{
+	if (!forget_file(w, path)) {
+		return;
+	}
+	printf("- %s\n", path);
+	if (w->cache != NULL) {
+		cache_remove(w->cache, path);
+		w->dirty = 1;
+	}
+}
+
+/* a directory moved out of a tree does not report its files */
+static void
+drop_tree(struct watcher *w, const char *path)
+{
+	size_t len = strlen(path);
+	tailq_report *report, *next;
+	for (report = TAILQ_FIRST(w->reports); report != NULL; report = next) {
+		next = TAILQ_NEXT(report, entries);
+		const char *p = (char *)report->path;
+		if (strncmp(p, path, len) == 0 && p[len] == '/') {
+			char *copy = strdup(p);
+			if (copy != NULL) {
+				drop_file(w, copy);
+				free(copy);
+			}
+		}
+	}
+
+	struct hashmap_entry *e;
+	hashmap_foreach(w->by_wd, e) {
+		struct watch *watch = e->value;
+		if (strncmp(watch->path, path, len) == 0 &&
+		    (watch->path[len] == '/' || watch->path[len] == '\0')) {
+			/* IN_IGNORED frees a watch */
+			inotify_rm_watch(w->fd, watch->wd);
+		}
+	}
+}
+
+static int
+ingest_file(const char *path, void *arg)
+{
+	struct watcher *w = arg;
+	tailq_report *report;
+
+	if (w->cache != NULL) {
+		report = cache_process_file(w->cache, (char *)path, 1);
+		w->dirty = 1;
+	} else if ((report = process_file((char *)path)) != NULL) {
+		/* only a summary is printed */
+		free_report_suites(report);
+	}
+	int existed = forget_file(w, path);
+	if (report == NULL || report->format == FORMAT_UNKNOWN) {
+		if (report != NULL) {
+			free_report(report);
+		}
+		if (existed) {
+			printf("- %s\n", path);
+		}
+		return 0;
+	}
+	TAILQ_INSERT_TAIL(w->reports, report, entries);
+	hashmap_put(w->by_path, report->path, strlen((char *)report->path), report);
+	printf("%c ", existed ? '~' : '+');
+	print_report_summary(report);
+
+	return 0;
+}
+
+static int
+add_watch(const char *path, void *arg)
+{
+	struct watcher *w = arg;
+	struct watch *watch;
+
+	int wd = inotify_add_watch(w->fd, path, WATCH_EVENTS | IN_ONLYDIR);
+	if (wd == -1) {
+		perror(path);
+		return 0;
+	}
+	if (hashmap_get(w->by_wd, &wd, sizeof(wd)) != NULL) {
+		return 0;
+	}
+	watch = calloc(1, sizeof(struct watch));
+	if (watch == NULL || (watch->path = strdup(path)) == NULL) {
+		perror("malloc failed");
+		free(watch);
+		return 0;
+	}
+	watch->wd = wd;
+	hashmap_put(w->by_wd, &watch->wd, sizeof(watch->wd), watch);
+
+	return 0;
+}
+
+static int
+skip_file(const char *path, void *arg)
+{
+	return 0;
+}
+
+/* watches go first, so files created during a scan are not lost */
+static void
+add_tree(struct watcher *w, const char *path, int is_root)
+{
+	int depth = w->opts->depth;
+	if (!is_root && depth >= 0) {
+		depth -= depth_of(w, path);
+		if (depth < 0) {
+			return;
+		}
+	}
+	struct walk_opts walk_opts = { depth, w->opts->pattern, add_watch };
+	walk_dir(path, &walk_opts, skip_file, w);
+	if (is_root) {
+		return;
+	}
+	walk_opts.dir_cb = NULL;
+	walk_dir(path, &walk_opts, ingest_file, w);
+}
+
+static void
+free_reports_index(struct watcher *w)
+{
+	if (w->reports != NULL) {
+		free_reports(w->reports);
+		free(w->reports);
+		w->reports = NULL;
+	}
+	hashmap_free(w->by_path);
+	w->by_path = NULL;
+}
+
+/* strings of reports are moved to a new generation, see intern_compact() */
+static void
+keep_interned(void *arg)
+{
+	struct watcher *w = arg;
+	tailq_report *report;
+	TAILQ_FOREACH(report, w->reports, entries) {
+		report->summary.slowest = intern(report->summary.slowest);
+		/* ids of names are given anew, columns are built on demand */
+		columns_free(report->columns);
+		report->columns = NULL;
+		if (report->suites == NULL) {
+			continue;
+		}
+		tailq_suite *suite;
+		TAILQ_FOREACH(suite, report->suites, entries) {
+			suite->name = intern(suite->name);
+			suite->hostname = intern(suite->hostname);
+			tailq_test *test;
+			TAILQ_FOREACH(test, suite->tests, entries) {
+				test->name = intern(test->name);
+			}
+		}
+	}
+}
+
+static void
+compact_interned(struct watcher *w)
+{
+	if (w->reports == NULL ||
+	    intern_count() <= w->interned * 2 + INTERN_SLACK) {
+		return;
+	}
+	intern_compact(keep_interned, w);
+	w->interned = intern_count();
+}
+
+static int
+scan(struct watcher *w)
+{
+	free_reports_index(w);
+	w->reports = process_dir_cache(w->root, w->opts, w->cache);
+	if (w->reports == NULL) {
+		return -1;
+	}
+	w->by_path = hashmap_new(0);
+	if (w->by_path == NULL) {
+		return -1;
+	}
+	tailq_report *report;
+	TAILQ_FOREACH(report, w->reports, entries) {
+		hashmap_put(w->by_path, report->path,
+			    strlen((char *)report->path), report);
+	}
+	print_reports(w->reports);
+	w->dirty = 1;
+	compact_interned(w);
+
+	return 0;
+}
+
+static void
+handle_event(struct watcher *w, struct inotify_event *ev)
+{
+	struct watch *watch = hashmap_get(w->by_wd, &ev->wd, sizeof(ev->wd));
+	if (watch == NULL) {
+		return;
+	}
+	if (ev->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+		hashmap_remove(w->by_wd, &ev->wd, sizeof(ev->wd));
+		free(watch->path);
+		free(watch);
+		return;
+	}
+	if (ev->len == 0 || ev->name[0] == '.') {
+		return;
+	}
+
+	char path[PATH_MAX];
+	if (snprintf(path, sizeof(path), "%s/%s", watch->path, ev->name) >=
+	    (int)sizeof(path)) {
+		return;
+	}
+	if (ev->mask & IN_ISDIR) {
+		if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+			add_tree(w, path, 0);
+		} else if (ev->mask & IN_MOVED_FROM) {
+			drop_tree(w, path);
+		}
+		return;
+	}
+	if (w->opts->pattern != NULL && fnmatch(w->opts->pattern, ev->name, 0) != 0) {
+		return;
+	}
+	if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+		ingest_file(path, w);
+	} else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+		drop_file(w, path);
+	}
+}
+
+static int
+read_events(struct watcher *w)
+{
+	char buf[64 * (sizeof(struct inotify_event) + NAME_MAX + 1)]
+		__attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	ssize_t len = read(w->fd, buf, sizeof(buf));
+	if (len == -1) {
+		return errno == EINTR || errno == EAGAIN ? 0 : -1;
+	}
+
+	char *p;
+	struct inotify_event *ev;
+	for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + ev->len) {
+		ev = (struct inotify_event *)p;
+		if (ev->mask & IN_Q_OVERFLOW) {
+			fprintf(stderr, "event queue overflow, rescan\n");
+			scan(w);
+			continue;
+		}
+		handle_event(w, ev);
+	}
+	compact_interned(w);
+	fflush(stdout);
+
+	return 0;
+}
+
+int
+watch_dir(const char *path, struct process_opts *opts)
+{
+	struct watcher w;
+	memset(&w, 0, sizeof(w));
+	w.root = path;
+	w.opts = opts;
+
+	w.fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if (w.fd == -1) {
+		perror("inotify_init1");
+		return 1;
+	}
+	w.by_wd = hashmap_new(0);
+	if (w.by_wd == NULL) {
+		close(w.fd);
+		return 1;
+	}
+	if (opts->cache != NULL) {
+		w.cache = cache_open(opts->cache);
+	}
+
+	/* CI writers may truncate a file while it is parsed */
+	input_set_mmap(0);
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	add_tree(&w, path, 1);
+	int rc = scan(&w) == 0 ? 0 : 1;
+	fflush(stdout);
+
+	while (rc == 0 && !stop) {
+		struct pollfd pfd = { w.fd, POLLIN, 0 };
+		int timeout = w.cache && w.dirty ? SAVE_INTERVAL * 1000 : -1;
+		int n = poll(&pfd, 1, timeout);
+		if (n == -1 && errno != EINTR) {
+			perror("poll");
+			rc = 1;
+		} else if (n > 0 && read_events(&w) == -1) {
+			perror("read");
+			rc = 1;
+		}
+		if (w.cache && w.dirty && time(NULL) - w.saved >= SAVE_INTERVAL) {
+			cache_save(w.cache);
+			w.saved = time(NULL);
+			w.dirty = 0;
+		}
+	}
+
+	if (w.cache != NULL) {
+		cache_save(w.cache);
+		cache_close(w.cache);
+	}
+	struct hashmap_entry *e;
+	hashmap_foreach(w.by_wd, e) {
+		struct watch *watch = e->value;
+		free(watch->path);
+		free(watch);
+	}
+	hashmap_free(w.by_wd);
+	free_reports_index(&w);
+	close(w.fd);
+
+	return rc;
+}
+
+#else	/* __linux__ */
+
+int
+watch_dir(const char *path, struct process_opts *opts)
+{
+	fprintf(stderr, "watching a directory is not supported\n");
+	return 1;
+}
+
+#endif	/* __linux__ */